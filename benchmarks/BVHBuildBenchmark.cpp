@@ -0,0 +1,95 @@
+// standard lib
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+// project
+#include "core/ThreadPool.h"
+#include "core/raytrace/BVH.h"
+#include "core/raytrace/SphereSet.h"
+
+namespace {
+    /** Scatter spheres like the RayTraceScene spheres over a cube, with the same Sphere layout */
+    SphereSet makeSpheres(std::size_t count) {
+        std::mt19937 rng(1234);
+        const float extent = std::cbrt(static_cast<float>(count)) * 2.0f;
+        std::uniform_real_distribution<float> position(-extent, extent);
+        std::uniform_real_distribution<float> radius(0.2f, 1.2f);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        SphereSet spheres;
+        for (std::size_t i = 0; i < count; ++i) {
+            spheres.add({
+                {position(rng), position(rng), position(rng)},
+                radius(rng),
+                {unit(rng), unit(rng), unit(rng)},
+                unit(rng)
+            });
+        }
+        return spheres;
+    }
+
+    /** Best of a few builds in milliseconds */
+    double timeBuild(const std::vector<BoundingBox>& primBounds, ThreadPool* pThreadPool, BVH& bvh) {
+        double bestMs = 1e30;
+        for (int run = 0; run < 3; ++run) {
+            const auto start = std::chrono::steady_clock::now();
+            bvh.build(primBounds, pThreadPool);
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            bestMs = std::min(bestMs, elapsed.count());
+        }
+        return bestMs;
+    }
+
+    /** Nudge every sphere like one animation frame and refit, returns the refit time in milliseconds */
+    double timeRefit(SphereSet& spheres, ThreadPool* pThreadPool, BVH& bvh) {
+        std::mt19937 rng(5678);
+        std::uniform_real_distribution<float> offset(-0.5f, 0.5f);
+        for (std::size_t i = 0; i < spheres.size(); ++i) {
+            spheres.setCenter(i, spheres.getCenter(i) + glm::vec3(offset(rng), offset(rng), offset(rng)));
+        }
+        std::vector<BoundingBox> primBounds;
+        BVH::computeSphereBounds(spheres, primBounds);
+
+        const auto start = std::chrono::steady_clock::now();
+        bvh.refit(primBounds, pThreadPool);
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    }
+}
+
+/**
+ * Time BVH construction over sphere sets of increasing size, single threaded and on the thread pool, and a
+ * refit of the parallel tree after moving every sphere
+ * Usage: BVHBuildBenchmark [maxSphereCount]
+ */
+int main(int argc, char** argv) {
+    const std::size_t maxCount = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 4000000;
+
+    ThreadPool threadPool;
+    std::cout << "Threads: " << threadPool.getThreadCount() << std::endl;
+    std::cout << "spheres\tserial ms\tparallel ms\tspeedup\tnodes\tSAH serial\tSAH parallel\trefit ms\trefit quality" << std::endl;
+
+    for (const std::size_t count : {10000ull, 100000ull, 1000000ull, 4000000ull}) {
+        if (count > maxCount) {
+            break;
+        }
+        SphereSet spheres = makeSpheres(count);
+        std::vector<BoundingBox> primBounds;
+        BVH::computeSphereBounds(spheres, primBounds);
+
+        BVH serialBVH;
+        BVH parallelBVH;
+        const double serialMs = timeBuild(primBounds, nullptr, serialBVH);
+        const double parallelMs = timeBuild(primBounds, &threadPool, parallelBVH);
+        const float parallelSAH = parallelBVH.computeSAHCost();
+        const double refitMs = timeRefit(spheres, &threadPool, parallelBVH);
+
+        std::cout << count << "\t" << serialMs << "\t" << parallelMs << "\t" << serialMs / parallelMs << "\t"
+            << parallelBVH.getNodes().size() << "\t" << serialBVH.computeSAHCost() << "\t"
+            << parallelSAH << "\t" << refitMs << "\t" << parallelBVH.getQualityRatio() << std::endl;
+    }
+
+    return 0;
+}
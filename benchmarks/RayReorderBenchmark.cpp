@@ -0,0 +1,251 @@
+// standard lib
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+// third party
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GL/gl.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+// project
+#include "core/application/Resources.h"
+#include "core/graphics/FrameUniformBuffer.h"
+#include "core/raytrace/AccelerationStructure.h"
+#include "core/raytrace/BVH.h"
+#include "core/raytrace/SphereSet.h"
+#include "core/raytrace/TriangleMesh.h"
+#include "core/raytrace/WavefrontPathTracer.h"
+
+namespace {
+    constexpr int kTileSize = 16;
+
+    /** Spheres over a mirror floor, reflectivity sets how many rays survive each bounce */
+    struct BenchmarkScene {
+        SphereSet spheres;
+        BVH bvh;
+        AccelerationStructure meshes;
+    };
+
+    BenchmarkScene makeScene(float reflectivity) {
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        BenchmarkScene scene;
+        for (int i = 0; i < 200; ++i) {
+            scene.spheres.add({
+                {position(rng) * 10.0f, position(rng) * 3.0f, -14.0f + position(rng) * 8.0f},
+                0.3f + 0.9f * unit(rng),
+                {unit(rng), unit(rng), unit(rng)},
+                reflectivity
+            });
+        }
+        scene.bvh.build(scene.spheres);
+
+        const std::vector<glm::vec3> floorPositions = {
+            {-40.0f, 0.0f, -40.0f}, {40.0f, 0.0f, -40.0f}, {40.0f, 0.0f, 40.0f}, {-40.0f, 0.0f, 40.0f}
+        };
+        TriangleMesh floor;
+        floor.addTriangles(floorPositions, {0, 2, 1, 0, 3, 2}, {{0.6f, 0.6f, 0.6f}, reflectivity});
+        scene.meshes.addInstance(scene.meshes.addMesh(floor), glm::translate(glm::mat4(1.0f), {0.0f, -4.0f, 0.0f}));
+        scene.meshes.buildTopLevel();
+        return scene;
+    }
+
+    template <typename T>
+    GLuint createSSBO(const std::vector<T>& data, GLuint binding) {
+        GLuint ssbo;
+        glGenBuffers(1, &ssbo);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+        // Empty arrays still need a buffer the shaders can bind
+        glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<std::size_t>(data.size() * sizeof(T), 16), data.data(), GL_STATIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, ssbo);
+        return ssbo;
+    }
+
+    GLuint createImage(const glm::ivec2& size, GLenum format, GLuint unit) {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, format, size.x, size.y);
+        glBindImageTexture(unit, texture, 0, GL_FALSE, 0, GL_READ_WRITE, format);
+        return texture;
+    }
+
+    /** Upload the scene to the bindings RayTraceScene uses, returns the buffers to delete */
+    std::vector<GLuint> uploadScene(const BenchmarkScene& scene) {
+        std::vector<glm::vec4> sphereGeometry;
+        std::vector<glm::vec4> sphereMaterials;
+        scene.spheres.packGeometry(sphereGeometry);
+        scene.spheres.packMaterials(sphereMaterials);
+
+        std::vector<glm::vec4> triangles;
+        std::vector<glm::vec4> triangleMaterials;
+        std::vector<BVHNode> meshNodes;
+        std::vector<uint32_t> meshPrimIndices;
+        std::vector<GpuMeshInstance> instances;
+        scene.meshes.packMeshes(triangles, triangleMaterials, meshNodes, meshPrimIndices);
+        scene.meshes.packInstances(instances);
+
+        return {
+            createSSBO(sphereGeometry, 1),
+            createSSBO(sphereMaterials, 2),
+            createSSBO(scene.bvh.getNodes(), 3),
+            createSSBO(scene.bvh.getPrimIndices(), 4),
+            createSSBO(triangles, 5),
+            createSSBO(triangleMaterials, 6),
+            createSSBO(meshNodes, 7),
+            createSSBO(meshPrimIndices, 8),
+            createSSBO(instances, 9),
+            createSSBO(scene.meshes.getTopLevel().getNodes(), 10),
+            createSSBO(scene.meshes.getTopLevel().getPrimIndices(), 11)
+        };
+    }
+
+    /** Bounds the reflection rays start in, the roots of the two hierarchies */
+    BoundingBox computeSceneBounds(const BenchmarkScene& scene) {
+        BoundingBox bounds;
+        bounds.grow(scene.bvh.getNodes()[0].boundsMin);
+        bounds.grow(scene.bvh.getNodes()[0].boundsMax);
+        bounds.grow(scene.meshes.getTopLevel().getNodes()[0].boundsMin);
+        bounds.grow(scene.meshes.getTopLevel().getNodes()[0].boundsMax);
+        return bounds;
+    }
+
+    void loadPrograms(Resources& resources) {
+        const std::string shaderPath = std::string(RESOURCE_PATH) + "/Shaders/";
+        for (const char* stage : {"Generate", "Extend", "Shade", "Compact", "Reorder"}) {
+            std::string fileName = stage;
+            fileName[0] = static_cast<char>(std::tolower(fileName[0]));
+            resources.loadResource<ShaderProgram>(
+                {{ shaderPath + "ray_wavefront_" + fileName + ".glsl:COMPUTE"}},
+                std::string("RayWavefront") + stage
+            );
+        }
+        for (const char* pass : {"Histogram", "Scan", "Scatter"}) {
+            std::string fileName = pass;
+            fileName[0] = static_cast<char>(std::tolower(fileName[0]));
+            resources.loadResource<ShaderProgram>(
+                {{ shaderPath + "radix_sort_" + fileName + ".glsl:COMPUTE"}},
+                std::string("RadixSort") + pass
+            );
+        }
+    }
+}
+
+/**
+ * Time the wavefront path tracer with and without ray reordering on a scene of reflective spheres over a floor,
+ * at a low and a high reflectivity. Shows the sort cost of every frame against what it saves in the extend stage
+ * Usage: RayReorderBenchmark [width height]
+ */
+int main(int argc, char** argv) {
+    const glm::ivec2 size = (argc > 2) ? glm::ivec2(std::atoi(argv[1]), std::atoi(argv[2])) : glm::ivec2(1280, 720);
+
+    if (!glfwInit()) {
+        throw std::runtime_error("GLFW Init error");
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* pWindow = glfwCreateWindow(64, 64, "RayReorderBenchmark", nullptr, nullptr);
+    if (pWindow == nullptr) {
+        throw std::runtime_error("Could not create a GL 4.3 context");
+    }
+    glfwMakeContextCurrent(pWindow);
+    glewExperimental = true;
+    if (glewInit() != GLEW_OK) {
+        throw std::runtime_error("GLEW Init error");
+    }
+
+    Resources resources;
+    loadPrograms(resources);
+    WavefrontPathTracer wavefront(resources, size);
+    FrameUniformBuffer frameUniforms;
+
+    const glm::ivec2 numTiles((size.x + kTileSize - 1) / kTileSize, (size.y + kTileSize - 1) / kTileSize);
+    const GLuint tileCount = static_cast<GLuint>(numTiles.x * numTiles.y);
+    const std::vector<GLuint> convergence(2, 0);
+    const std::vector<GLuint> tileData(2 * tileCount, 0);
+    const std::vector<GLuint> frameBuffers = {
+        createSSBO(convergence, 12), createSSBO(tileData, 13), createSSBO(tileData, 14)
+    };
+    const std::vector<GLuint> images = {
+        createImage(size, GL_RGBA32F, 0), createImage(size, GL_RGBA32F, 1),
+        createImage(size, GL_R32F, 2), createImage(size, GL_RGBA32F, 3)
+    };
+
+    const glm::mat4 projection = glm::perspective(glm::radians(60.0f), static_cast<float>(size.x) / size.y, 0.1f, 200.0f);
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 6.0f), glm::vec3(0.0f, -1.0f, -12.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    using Stage = WavefrontPathTracer::Stage;
+    std::cout << size.x << "x" << size.y << std::endl;
+    std::cout << "reflectivity\treorder\textend ms\tshade ms\tcompact ms\treorder ms\ttotal ms" << std::endl;
+    for (const float reflectivity : {0.3f, 0.9f}) {
+        const BenchmarkScene scene = makeScene(reflectivity);
+        const std::vector<GLuint> sceneBuffers = uploadScene(scene);
+        const BoundingBox sceneBounds = computeSceneBounds(scene);
+        const GLsizei numSpheres = static_cast<GLsizei>(scene.spheres.size());
+        const GLsizei numInstances = static_cast<GLsizei>(scene.meshes.getInstanceCount());
+
+        for (const bool reorder : {false, true}) {
+            wavefront.setRayReordering(reorder, sceneBounds);
+            int sampleIndex = 0;
+            const auto setUniforms = [&](const ShaderProgram& program) {
+                program.setInt("numSpheres", numSpheres);
+                program.setInt("numInstances", numInstances);
+                program.setInt("sampleIndex", sampleIndex);
+                program.setIVec2("renderSize", size);
+                program.setFloat("convergenceThreshold", 0.0f);
+                program.setInt("adaptiveSampling", 0);
+                program.setInt("numTilesX", numTiles.x);
+                program.setInt("reuseReprojection", 0);
+                program.setInt("checkerboard", 0);
+            };
+
+            // The first trace compiles and warms up, the rest are averaged
+            constexpr int kFrames = 4;
+            float stageMs[WavefrontPathTracer::kStageCount] = {};
+            for (int frame = 0; frame <= kFrames; ++frame) {
+                frameUniforms.beginFrame(static_cast<float>(frame));
+                frameUniforms.setCamera(view, projection);
+                wavefront.trace(size, numTiles, 0, setUniforms);
+                frameUniforms.endFrame();
+                glFinish();
+                wavefront.updateTimers();
+                ++sampleIndex;
+                if (frame == 0) {
+                    continue;
+                }
+                // The reorder timers keep their last reading while reordering is off
+                const int stageCount = reorder ? WavefrontPathTracer::kStageCount : WavefrontPathTracer::kStageCount - 1;
+                for (int stage = 0; stage < stageCount; ++stage) {
+                    stageMs[stage] += wavefront.getStageMilliseconds(static_cast<Stage>(stage)) / kFrames;
+                }
+            }
+
+            float totalMs = 0.0f;
+            for (const float ms : stageMs) {
+                totalMs += ms;
+            }
+            std::cout << reflectivity << "\t" << (reorder ? "on" : "off") << "\t"
+                << stageMs[static_cast<int>(Stage::EXTEND)] << "\t" << stageMs[static_cast<int>(Stage::SHADE)] << "\t"
+                << stageMs[static_cast<int>(Stage::COMPACT)] << "\t" << stageMs[static_cast<int>(Stage::REORDER)] << "\t"
+                << totalMs << std::endl;
+        }
+        glDeleteBuffers(static_cast<GLsizei>(sceneBuffers.size()), sceneBuffers.data());
+    }
+
+    glDeleteBuffers(static_cast<GLsizei>(frameBuffers.size()), frameBuffers.data());
+    glDeleteTextures(static_cast<GLsizei>(images.size()), images.data());
+    glfwDestroyWindow(pWindow);
+    glfwTerminate();
+    return 0;
+}
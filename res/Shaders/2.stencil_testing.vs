@@ -1,15 +1,15 @@
-#version 330 core
+#version 420 core
+#include "frame_uniforms.glsl"
+
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main()
 {
     TexCoords = aTexCoords;    
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
+    gl_Position = viewProjMatrix * model * vec4(aPos, 1.0f);
 }
\ No newline at end of file
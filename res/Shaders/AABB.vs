@@ -1,4 +1,6 @@
 #version 460
+#include "frame_uniforms.glsl"
+
 layout(location = 0) in vec3 localPosition;  // Cube vertex positions
 
 struct AABB {
@@ -10,14 +12,11 @@ layout(std430, binding = 0) buffer AABBBuffer {
     AABB aabbs[];
 };
 
-uniform mat4 view;
-uniform mat4 projection;
-
 void main() {
     AABB box = aabbs[gl_InstanceID];
 
     // Convert unit cube to AABB size
     vec3 worldPos = mix(box.min, box.max, localPosition);
 
-    gl_Position = projection * view * vec4(worldPos, 1.0);
+    gl_Position = viewProjMatrix * vec4(worldPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,14 @@
+// Camera and time of the frame, shared by every program. Written once per frame by FrameUniformBuffer, the layout
+// matches FrameUniformData. Included after the #version line, needs GLSL 4.20 for the binding
+
+layout(std140, binding = 0) uniform FrameUniforms {
+    mat4 viewMatrix;
+    mat4 projMatrix;
+    mat4 invViewMatrix;
+    mat4 invProjMatrix;
+    mat4 viewProjMatrix;
+    vec3 cameraPosition;
+    uint frameIndex;
+    // Seconds since the application started
+    float time;
+};
@@ -0,0 +1,84 @@
+#version 430
+
+// Karras 2012 hierarchy over the sorted Morton codes, one invocation per inner node. Inner node i keeps its
+// children in the node slots 1 + 2i and 2 + 2i, so the tree lands in the same layout as the CPU BVH
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 5) readonly buffer MortonCodeBuffer {
+    uint mortonCodes[];
+};
+
+// Per node slot in the node buffer and parent inner node. Inner nodes first, then the leaves
+layout(std430, binding = 10) writeonly buffer NodeLinkBuffer {
+    uvec2 nodeLinks[];
+};
+
+// Arrival counters for the bottom-up bounds pass, cleared here
+layout(std430, binding = 11) writeonly buffer VisitCountBuffer {
+    uint visitCounts[];
+};
+
+uniform uint numSpheres;
+
+const uint NO_PARENT = 0xFFFFFFFFu;
+
+// Length of the common prefix of the codes at i and j, ties broken by the index so every code is unique
+int commonPrefix(int i, int j) {
+    if (j < 0 || j >= int(numSpheres)) {
+        return -1;
+    }
+    uint codeI = mortonCodes[i];
+    uint codeJ = mortonCodes[j];
+    if (codeI == codeJ) {
+        return 32 + (31 - findMSB(uint(i ^ j)));
+    }
+    return 31 - findMSB(codeI ^ codeJ);
+}
+
+void main() {
+    int i = int(gl_GlobalInvocationID.x);
+    if (i >= int(numSpheres) - 1) {
+        return;
+    }
+
+    // Direction of the range covered by this node and an upper bound of its length
+    int direction = (commonPrefix(i, i + 1) - commonPrefix(i, i - 1)) >= 0 ? 1 : -1;
+    int minPrefix = commonPrefix(i, i - direction);
+    int maxLength = 2;
+    while (commonPrefix(i, i + maxLength * direction) > minPrefix) {
+        maxLength *= 2;
+    }
+
+    // Binary search the other end of the range
+    int length = 0;
+    for (int step = maxLength / 2; step >= 1; step /= 2) {
+        if (commonPrefix(i, i + (length + step) * direction) > minPrefix) {
+            length += step;
+        }
+    }
+    int j = i + length * direction;
+
+    // Binary search the split, the last position sharing more than the prefix of the whole range
+    int nodePrefix = commonPrefix(i, j);
+    int split = 0;
+    for (int divisor = 2; ; divisor *= 2) {
+        int step = (length + divisor - 1) / divisor;
+        if (commonPrefix(i, i + (split + step) * direction) > nodePrefix) {
+            split += step;
+        }
+        if (step <= 1) {
+            break;
+        }
+    }
+    int gamma = i + split * direction + min(direction, 0);
+
+    uint leftSlot = 1u + 2u * uint(i);
+    uint leftLink = (min(i, j) == gamma) ? numSpheres - 1u + uint(gamma) : uint(gamma);
+    uint rightLink = (max(i, j) == gamma + 1) ? numSpheres - 1u + uint(gamma + 1) : uint(gamma + 1);
+    nodeLinks[leftLink] = uvec2(leftSlot, uint(i));
+    nodeLinks[rightLink] = uvec2(leftSlot + 1u, uint(i));
+    if (i == 0) {
+        nodeLinks[0] = uvec2(0u, NO_PARENT);
+    }
+    visitCounts[i] = 0u;
+}
@@ -0,0 +1,51 @@
+#version 430
+
+// 30 bit Morton code of every sphere center within the scene bounds
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 1) readonly buffer SphereGeometryBuffer {
+    vec4 sphereGeometry[];
+};
+
+layout(std430, binding = 4) writeonly buffer PrimIndexBuffer {
+    uint primIndices[];
+};
+
+layout(std430, binding = 5) writeonly buffer MortonCodeBuffer {
+    uint mortonCodes[];
+};
+
+layout(std430, binding = 12) readonly buffer SceneBoundsBuffer {
+    uint sceneBounds[6];
+};
+
+uniform uint numSpheres;
+
+float orderedUintToFloat(uint value) {
+    return uintBitsToFloat(((value & 0x80000000u) != 0u) ? (value & 0x7FFFFFFFu) : ~value);
+}
+
+// Spreads the lower 10 bits so there are two zero bits between each of them
+uint expandBits(uint value) {
+    value = (value * 0x00010001u) & 0xFF0000FFu;
+    value = (value * 0x00000101u) & 0x0F00F00Fu;
+    value = (value * 0x00000011u) & 0xC30C30C3u;
+    value = (value * 0x00000005u) & 0x49249249u;
+    return value;
+}
+
+void main() {
+    uint sphereIdx = gl_GlobalInvocationID.x;
+    if (sphereIdx >= numSpheres) {
+        return;
+    }
+
+    vec3 boundsMin = vec3(orderedUintToFloat(sceneBounds[0]), orderedUintToFloat(sceneBounds[1]), orderedUintToFloat(sceneBounds[2]));
+    vec3 boundsMax = vec3(orderedUintToFloat(sceneBounds[3]), orderedUintToFloat(sceneBounds[4]), orderedUintToFloat(sceneBounds[5]));
+    vec3 extent = max(boundsMax - boundsMin, vec3(1e-6));
+
+    vec3 cell = clamp((sphereGeometry[sphereIdx].xyz - boundsMin) / extent * 1024.0, vec3(0.0), vec3(1023.0));
+    uvec3 quantized = uvec3(cell);
+    mortonCodes[sphereIdx] = (expandBits(quantized.x) << 2) | (expandBits(quantized.y) << 1) | expandBits(quantized.z);
+    primIndices[sphereIdx] = sphereIdx;
+}
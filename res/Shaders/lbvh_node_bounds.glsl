@@ -0,0 +1,68 @@
+#version 430
+
+// Writes the leaves and walks up to the root, one invocation per leaf. The second child to reach an inner node
+// merges both child bounds, so every inner node is written exactly once after both of its children
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 1) readonly buffer SphereGeometryBuffer {
+    vec4 sphereGeometry[];
+};
+
+struct BVHNode {
+    vec3 boundsMin;
+    int leftFirst;
+    vec3 boundsMax;
+    int count;
+};
+
+layout(std430, binding = 3) coherent buffer BVHNodeBuffer {
+    BVHNode bvhNodes[];
+};
+
+layout(std430, binding = 4) readonly buffer PrimIndexBuffer {
+    uint primIndices[];
+};
+
+layout(std430, binding = 10) readonly buffer NodeLinkBuffer {
+    uvec2 nodeLinks[];
+};
+
+layout(std430, binding = 11) coherent buffer VisitCountBuffer {
+    uint visitCounts[];
+};
+
+uniform uint numSpheres;
+
+const uint NO_PARENT = 0xFFFFFFFFu;
+
+void main() {
+    uint leafIdx = gl_GlobalInvocationID.x;
+    if (leafIdx >= numSpheres) {
+        return;
+    }
+
+    // A single sphere is a leaf root without any links
+    uvec2 link = (numSpheres == 1u) ? uvec2(0u, NO_PARENT) : nodeLinks[numSpheres - 1u + leafIdx];
+
+    vec4 sphere = sphereGeometry[primIndices[leafIdx]];
+    bvhNodes[link.x] = BVHNode(sphere.xyz - vec3(sphere.w), int(leafIdx), sphere.xyz + vec3(sphere.w), 1);
+    memoryBarrierBuffer();
+
+    uint nodeIdx = link.y;
+    while (nodeIdx != NO_PARENT) {
+        // The first child to arrive leaves the node to its sibling
+        if (atomicAdd(visitCounts[nodeIdx], 1u) == 0u) {
+            return;
+        }
+        memoryBarrierBuffer();
+
+        uint leftSlot = 1u + 2u * nodeIdx;
+        BVHNode left = bvhNodes[leftSlot];
+        BVHNode right = bvhNodes[leftSlot + 1u];
+        link = nodeLinks[nodeIdx];
+        bvhNodes[link.x] = BVHNode(min(left.boundsMin, right.boundsMin), int(leftSlot), max(left.boundsMax, right.boundsMax), 0);
+        memoryBarrierBuffer();
+
+        nodeIdx = link.y;
+    }
+}
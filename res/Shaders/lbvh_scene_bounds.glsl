@@ -0,0 +1,47 @@
+#version 430
+
+// Bounds of the sphere centers, reduced per workgroup then merged with atomics on order preserving uints
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 1) readonly buffer SphereGeometryBuffer {
+    vec4 sphereGeometry[];
+};
+
+// xyz min then xyz max, as floatToOrderedUint
+layout(std430, binding = 12) buffer SceneBoundsBuffer {
+    uint sceneBounds[6];
+};
+
+uniform uint numSpheres;
+
+shared vec3 sharedMin[256];
+shared vec3 sharedMax[256];
+
+// Maps floats to uints with the same ordering so atomicMin/atomicMax can be used
+uint floatToOrderedUint(float value) {
+    uint bits = floatBitsToUint(value);
+    return ((bits & 0x80000000u) != 0u) ? ~bits : (bits | 0x80000000u);
+}
+
+void main() {
+    uint localIdx = gl_LocalInvocationID.x;
+    uint globalIdx = gl_GlobalInvocationID.x;
+
+    vec3 center = sphereGeometry[min(globalIdx, numSpheres - 1u)].xyz;
+    sharedMin[localIdx] = center;
+    sharedMax[localIdx] = center;
+    barrier();
+
+    for (uint stride = 128u; stride > 0u; stride >>= 1u) {
+        if (localIdx < stride) {
+            sharedMin[localIdx] = min(sharedMin[localIdx], sharedMin[localIdx + stride]);
+            sharedMax[localIdx] = max(sharedMax[localIdx], sharedMax[localIdx + stride]);
+        }
+        barrier();
+    }
+
+    if (localIdx < 3u) {
+        atomicMin(sceneBounds[localIdx], floatToOrderedUint(sharedMin[0][localIdx]));
+        atomicMax(sceneBounds[3u + localIdx], floatToOrderedUint(sharedMax[0][localIdx]));
+    }
+}
@@ -2,7 +2,11 @@
 out vec4 FragColor;
 in vec2 TexCoords;
 uniform sampler2D screenTexture;
+// Part of the texture holding the image, the rest is left over from larger frames
+uniform vec2 uvScale = vec2(1.0);
 
 void main() {
-    FragColor = texture(screenTexture, TexCoords);
-}
\ No newline at end of file
+    // Keep the bilinear footprint inside the image so its edges don't blend with stale texels
+    vec2 maxUV = uvScale - 0.5 / vec2(textureSize(screenTexture, 0));
+    FragColor = texture(screenTexture, min(TexCoords * uvScale, maxUV));
+}
@@ -0,0 +1,48 @@
+#version 430
+
+// Counts the 4 bit digits of the keys of every block of 256 elements
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 24) readonly buffer KeysInBuffer {
+    uint keysIn[];
+};
+
+// Digit counts stored digit-major (digit * numBlocks + block) so a single scan gives the scatter offsets
+layout(std430, binding = 28) writeonly buffer BlockSumsBuffer {
+    uint blockSums[];
+};
+
+// Number of pairs at elementCounts[countIndex], written by the caller or left by an earlier pass on the GPU
+layout(std430, binding = 29) readonly buffer ElementCountBuffer {
+    uint elementCounts[];
+};
+
+uniform uint countIndex;
+uniform uint numBlocks;
+uniform uint bitOffset;
+
+shared uint digitCounts[16];
+
+void main() {
+    uint localIdx = gl_LocalInvocationID.x;
+    uint globalIdx = gl_GlobalInvocationID.x;
+    uint numElements = elementCounts[countIndex];
+    // Blocks past a count only known on the GPU are skipped by the scan, the whole workgroup leaves together
+    if (gl_WorkGroupID.x * 256u >= numElements) {
+        return;
+    }
+
+    if (localIdx < 16u) {
+        digitCounts[localIdx] = 0u;
+    }
+    barrier();
+
+    if (globalIdx < numElements) {
+        atomicAdd(digitCounts[(keysIn[globalIdx] >> bitOffset) & 15u], 1u);
+    }
+    barrier();
+
+    if (localIdx < 16u) {
+        blockSums[localIdx * numBlocks + gl_WorkGroupID.x] = digitCounts[localIdx];
+    }
+}
@@ -0,0 +1,49 @@
+#version 430
+
+// Exclusive prefix sum of the block digit counts in place, run as a single workgroup
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 28) buffer BlockSumsBuffer {
+    uint blockSums[];
+};
+
+layout(std430, binding = 29) readonly buffer ElementCountBuffer {
+    uint elementCounts[];
+};
+
+uniform uint countIndex;
+uniform uint numBlocks;
+
+shared uint scan[256];
+
+void main() {
+    uint localIdx = gl_LocalInvocationID.x;
+    // Blocks past the count have no digits and are never scattered, so every digit row is only scanned up to
+    // the last block holding elements
+    uint activeBlocks = min((elementCounts[countIndex] + 255u) / 256u, numBlocks);
+    uint carry = 0u;
+
+    for (uint digit = 0u; digit < 16u; ++digit) {
+        for (uint base = 0u; base < activeBlocks; base += 256u) {
+            uint block = base + localIdx;
+            uint idx = digit * numBlocks + block;
+            uint value = (block < activeBlocks) ? blockSums[idx] : 0u;
+            scan[localIdx] = value;
+            barrier();
+
+            // Inclusive Hillis-Steele scan of the chunk
+            for (uint offset = 1u; offset < 256u; offset <<= 1u) {
+                uint addend = (localIdx >= offset) ? scan[localIdx - offset] : 0u;
+                barrier();
+                scan[localIdx] += addend;
+                barrier();
+            }
+
+            if (block < activeBlocks) {
+                blockSums[idx] = carry + scan[localIdx] - value;
+            }
+            carry += scan[255];
+            barrier();
+        }
+    }
+}
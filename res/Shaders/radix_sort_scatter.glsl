@@ -0,0 +1,96 @@
+#version 430
+
+// Stable scatter of key/value pairs by a 4 bit digit. Every block is first sorted locally by the digit with
+// four 1 bit splits, which makes the writes of a digit contiguous, then moved to the scanned block offsets
+layout(local_size_x = 256) in;
+
+layout(std430, binding = 24) readonly buffer KeysInBuffer {
+    uint keysIn[];
+};
+
+layout(std430, binding = 25) readonly buffer ValuesInBuffer {
+    uint valuesIn[];
+};
+
+layout(std430, binding = 26) writeonly buffer KeysOutBuffer {
+    uint keysOut[];
+};
+
+layout(std430, binding = 27) writeonly buffer ValuesOutBuffer {
+    uint valuesOut[];
+};
+
+layout(std430, binding = 28) readonly buffer BlockOffsetsBuffer {
+    uint blockOffsets[];
+};
+
+layout(std430, binding = 29) readonly buffer ElementCountBuffer {
+    uint elementCounts[];
+};
+
+uniform uint countIndex;
+uniform uint numBlocks;
+uniform uint bitOffset;
+
+shared uint sharedKeys[256];
+shared uint sharedValues[256];
+shared uint scan[256];
+shared uint digitStart[16];
+shared uint digitOffset[16];
+
+void main() {
+    uint localIdx = gl_LocalInvocationID.x;
+    uint globalIdx = gl_GlobalInvocationID.x;
+    uint blockStart = gl_WorkGroupID.x * 256u;
+    uint numElements = elementCounts[countIndex];
+    // Blocks past a count only known on the GPU have nothing to move, the whole workgroup leaves together
+    if (blockStart >= numElements) {
+        return;
+    }
+    uint validCount = min(256u, numElements - blockStart);
+
+    // Padding uses the largest key so it stays behind every valid element of the block
+    uint key = (globalIdx < numElements) ? keysIn[globalIdx] : 0xFFFFFFFFu;
+    uint value = (globalIdx < numElements) ? valuesIn[globalIdx] : 0u;
+
+    for (uint bit = 0u; bit < 4u; ++bit) {
+        uint isZero = 1u - ((key >> (bitOffset + bit)) & 1u);
+        scan[localIdx] = isZero;
+        barrier();
+        for (uint offset = 1u; offset < 256u; offset <<= 1u) {
+            uint addend = (localIdx >= offset) ? scan[localIdx - offset] : 0u;
+            barrier();
+            scan[localIdx] += addend;
+            barrier();
+        }
+        uint zerosBefore = scan[localIdx] - isZero;
+        uint totalZeros = scan[255];
+        uint newIdx = (isZero == 1u) ? zerosBefore : totalZeros + localIdx - zerosBefore;
+        barrier();
+
+        sharedKeys[newIdx] = key;
+        sharedValues[newIdx] = value;
+        barrier();
+        key = sharedKeys[localIdx];
+        value = sharedValues[localIdx];
+        barrier();
+    }
+
+    // First local position of every digit, and where the digit of this block starts in the output
+    uint digit = (key >> bitOffset) & 15u;
+    if (localIdx < 16u) {
+        digitStart[localIdx] = 256u;
+        digitOffset[localIdx] = blockOffsets[localIdx * numBlocks + gl_WorkGroupID.x];
+    }
+    barrier();
+    if (localIdx < validCount) {
+        atomicMin(digitStart[digit], localIdx);
+    }
+    barrier();
+
+    if (localIdx < validCount) {
+        uint outIdx = digitOffset[digit] + localIdx - digitStart[digit];
+        keysOut[outIdx] = key;
+        valuesOut[outIdx] = value;
+    }
+}
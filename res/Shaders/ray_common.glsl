@@ -0,0 +1,22 @@
+// Constants and helpers shared by the ray trace shaders. Included after the #version and layout lines
+
+const float BVH_MISS = 1e30;
+
+// Color of rays that leave the scene
+const vec3 BACKGROUND_COLOR = vec3(0.1, 0.1, 0.2);
+// Reflections followed after the primary hit. Variants can define fewer so the bounce loop is unrolled
+#ifndef MAX_BOUNCES
+#define MAX_BOUNCES 8
+#endif
+
+// Integer hash (PCG) for per pixel sample jitter
+uint hashPCG(uint v) {
+    uint state = v * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// Computes Fresnel reflection factor using Schlick’s approximation
+float fresnelSchlick(float cosTheta, float F0) {
+    return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
+}
@@ -0,0 +1,166 @@
+// Frame images and the sampling state of the ray trace shaders: which pixels are traced with which sample, and
+// how a finished sample is accumulated. Included after the #version and layout lines
+
+#include "ray_common.glsl"
+#include "frame_uniforms.glsl"
+
+layout (rgba32f, binding = 0) uniform image2D img;
+// Running mean of the samples (rgb) and the sum of squared luminance deviations from it (a)
+layout (rgba32f, binding = 1) uniform image2D accumulationImg;
+// Distance to the surface hit by the primary ray, BVH_MISS for the background
+layout (r32f, binding = 2) writeonly uniform image2D hitDistanceImg;
+// Last frame's shading moved into this view by ray_trace_reproject.glsl (rgb = color, a = hit distance, negative
+// where the surface was disoccluded)
+layout (rgba32f, binding = 3) readonly uniform image2D reprojectedImg;
+
+// Number of samples already in accumulationImg, 0 starts over with an unjittered sample
+uniform int sampleIndex;
+
+// Pixels traced, the top left corner of the images. Smaller than the images while the resolution is scaled down
+uniform ivec2 renderSize;
+
+// Pixels whose mean has a luminance standard error above this are counted as not converged
+uniform float convergenceThreshold;
+
+layout(std430, binding = 12) buffer ConvergenceBuffer {
+    uint unconvergedPixels;
+    // Pixels traced while reprojected shading was available
+    uint tracedPixels;
+};
+
+// Reuse reprojected shading for the first sample instead of tracing. A rotating subset of one in refreshInterval
+// pixels is traced anyway so view dependent reflections catch up
+uniform bool reuseReprojection;
+uniform int refreshInterval;
+uniform int refreshPhase;
+
+// Checkerboard frames trace the pixels where (x + y + checkerboardPhase) is even, one invocation per traced pixel.
+// ray_trace_checkerboard.glsl fills in the others
+uniform bool checkerboard;
+uniform int checkerboardPhase;
+
+// Adaptive sampling traces one workgroup per noisy tile listed by ray_trace_tile_compact.glsl, every tile keeps
+// its own sample count and the largest standard error of its pixels (float bits)
+uniform bool adaptiveSampling;
+uniform int numTilesX;
+const int TILE_SIZE = 16;
+
+struct TileState {
+    uint noiseBits;
+    uint sampleCount;
+};
+
+layout(std430, binding = 13) buffer TileStateBuffer {
+    TileState tileStates[];
+};
+
+layout(std430, binding = 14) readonly buffer ActiveTileBuffer {
+    uint activeTiles[];
+};
+
+// Random offset within the pixel, the first sample is taken at the pixel corner like a non progressive frame
+vec2 getSampleJitter(ivec2 pixelCoords, int pixelSampleIndex) {
+    if (pixelSampleIndex == 0) {
+        return vec2(0.0);
+    }
+    uint seed = hashPCG(uint(pixelCoords.x) ^ hashPCG(uint(pixelCoords.y) ^ hashPCG(uint(pixelSampleIndex))));
+    return vec2(seed & 0xffffu, seed >> 16u) / 65536.0;
+}
+
+// Sample index of a pixel, and its tile with adaptive sampling
+int getPixelSampleIndex(ivec2 pixelCoords, out uint tileIdx) {
+    tileIdx = 0u;
+    if (!adaptiveSampling) {
+        return sampleIndex;
+    }
+    // The compaction pass already counted the sample being traced
+    ivec2 tile = pixelCoords / TILE_SIZE;
+    tileIdx = uint(tile.y * numTilesX + tile.x);
+    return int(tileStates[tileIdx].sampleCount) - 1;
+}
+
+// Pick the pixel sampled by an invocation of a TILE_SIZE x TILE_SIZE workgroup of the pixel dispatch, see
+// selectPixelSample. Kernels with another workgroup shape pass the ids the invocation would have had
+bool selectPixelSampleAt(uvec2 workGroupID, uvec2 localInvocationID, out ivec2 pixelCoords, out int pixelSampleIndex, out uint tileIdx) {
+    pixelCoords = ivec2(workGroupID * uint(TILE_SIZE) + localInvocationID);
+    if (adaptiveSampling) {
+        uint activeTileIdx = activeTiles[workGroupID.x];
+        pixelCoords = ivec2(int(activeTileIdx) % numTilesX, int(activeTileIdx) / numTilesX) * TILE_SIZE + ivec2(localInvocationID);
+    } else if (checkerboard) {
+        pixelCoords.x = pixelCoords.x * 2 + ((pixelCoords.y + checkerboardPhase) & 1);
+    }
+    pixelSampleIndex = getPixelSampleIndex(pixelCoords, tileIdx);
+
+    if (pixelCoords.x >= renderSize.x || pixelCoords.y >= renderSize.y) return false;
+
+    if (reuseReprojection && pixelSampleIndex == 0) {
+        vec4 reprojected = imageLoad(reprojectedImg, pixelCoords);
+        bool refresh = ((pixelCoords.x * 7 + pixelCoords.y * 3 + refreshPhase) % refreshInterval) == 0;
+        if (reprojected.a >= 0.0 && !refresh) {
+            // Taken as the first sample of the new view, later samples average it out
+            imageStore(accumulationImg, pixelCoords, vec4(reprojected.rgb, 0.0));
+            imageStore(hitDistanceImg, pixelCoords, vec4(reprojected.a));
+            imageStore(img, pixelCoords, vec4(reprojected.rgb, 1.0));
+            atomicAdd(unconvergedPixels, 1u);
+            return false;
+        }
+        atomicAdd(tracedPixels, 1u);
+    }
+    return true;
+}
+
+// Pick the pixel the invocation samples for the sampling mode. Needs TILE_SIZE x TILE_SIZE workgroups. Pixels that
+// take their reprojected shading are written here. Returns false if there is nothing to trace
+bool selectPixelSample(out ivec2 pixelCoords, out int pixelSampleIndex, out uint tileIdx) {
+    return selectPixelSampleAt(gl_WorkGroupID.xy, gl_LocalInvocationID.xy, pixelCoords, pixelSampleIndex, tileIdx);
+}
+
+// Camera ray through the jittered sample position of a pixel
+void getPrimaryRay(ivec2 pixelCoords, int pixelSampleIndex, out vec3 rayOrigin, out vec3 rayDir) {
+    // Convert pixel coordinates to normalized device coordinates (NDC: -1 to 1)
+    vec2 uv = ((vec2(pixelCoords) + getSampleJitter(pixelCoords, pixelSampleIndex)) / vec2(renderSize)) * 2.0 - 1.0;
+
+    // Transform NDC to clip space
+    vec4 clipSpacePos = vec4(uv, -1.0, 1.0);
+
+    // Convert clip space to view space using precomputed inverse projection
+    vec4 viewSpacePos = invProjMatrix * clipSpacePos;
+    viewSpacePos /= viewSpacePos.w; // Perspective divide
+
+    // Compute ray origin (camera position in world space)
+    rayOrigin = vec3(invViewMatrix[3]);
+
+    // Compute ray direction using precomputed inverse view matrix
+    rayDir = normalize((invViewMatrix * viewSpacePos).xyz - rayOrigin);
+}
+
+// Add a finished sample to the pixel's running mean and noise estimate and show the mean
+void storePixelSample(ivec2 pixelCoords, int pixelSampleIndex, uint tileIdx, vec3 color, float primaryHitDistance) {
+    // Welford update of the running mean and the luminance deviations
+    vec4 accumulation = vec4(color, 0.0);
+    // A single sample says nothing about the noise
+    float standardError = BVH_MISS;
+    if (pixelSampleIndex > 0) {
+        vec4 previous = imageLoad(accumulationImg, pixelCoords);
+        const vec3 lumaWeights = vec3(0.2126, 0.7152, 0.0722);
+        float sampleCount = float(pixelSampleIndex + 1);
+        float delta = dot(color - previous.rgb, lumaWeights);
+        accumulation.rgb = previous.rgb + (color - previous.rgb) / sampleCount;
+        accumulation.a = previous.a + delta * dot(color - accumulation.rgb, lumaWeights);
+
+        // Variance of the mean shrinks with the sample count
+        standardError = sqrt(accumulation.a / (sampleCount * (sampleCount - 1.0)));
+    }
+    if (standardError > convergenceThreshold) {
+        atomicAdd(unconvergedPixels, 1u);
+    }
+    if (adaptiveSampling) {
+        // Positive floats order the same as their bits
+        atomicMax(tileStates[tileIdx].noiseBits, floatBitsToUint(standardError));
+    }
+    imageStore(accumulationImg, pixelCoords, accumulation);
+    imageStore(hitDistanceImg, pixelCoords, vec4(primaryHitDistance));
+
+    // Store the final color in the framebuffer
+    imageStore(img, pixelCoords, vec4(accumulation.rgb, 1.0));
+}
@@ -0,0 +1,85 @@
+// Scene geometry and materials read when shading a hit. Included after the #version and layout lines
+
+#include "ray_common.glsl"
+
+// Sphere geometry read by every intersection test (xyz = center, w = radius)
+layout(std430, binding = 1) readonly buffer SphereGeometryBuffer {
+    vec4 sphereGeometry[];
+};
+
+// Sphere materials only read on a hit (rgb = color, a = reflectivity)
+layout(std430, binding = 2) readonly buffer SphereMaterialBuffer {
+    vec4 sphereMaterials[];
+};
+
+// Position only triangles of all meshes in object space, three vec4 each (xyz = corner, w of the first = material
+// index bits)
+layout(std430, binding = 5) readonly buffer TriangleBuffer {
+    vec4 triangleVertices[];
+};
+
+// Triangle materials (rgb = color, a = reflectivity)
+layout(std430, binding = 6) readonly buffer TriangleMaterialBuffer {
+    vec4 triangleMaterials[];
+};
+
+// Placement of a mesh, info.x is the root of its BVH in meshBVHNodes
+struct MeshInstance {
+    mat4 worldToObject;
+    uvec4 info;
+};
+
+layout(std430, binding = 9) readonly buffer MeshInstanceBuffer {
+    MeshInstance meshInstances[];
+};
+
+// Shade a hit and continue the path along its reflection. color gathers what the path has seen so far, attenuation
+// weighs what the next ray finds and drops to 0 once nothing further can show
+void shadeHit(inout vec3 rayOrigin, inout vec3 rayDir, float hitT, int sphereIdx, int triangleIdx, int instanceIdx,
+              inout vec3 color, inout float attenuation) {
+    // Compute intersection point and normal
+    vec3 hitPoint = rayOrigin + hitT * rayDir;
+    vec3 normal;
+    vec4 hitMaterial;
+    if (triangleIdx != -1) {
+        // A triangle is only found when it is closer than the sphere, shade the side facing the ray
+        vec4 v0 = triangleVertices[triangleIdx * 3];
+        vec3 v1 = triangleVertices[triangleIdx * 3 + 1].xyz;
+        vec3 v2 = triangleVertices[triangleIdx * 3 + 2].xyz;
+        // Object space normal to world space with the inverse transpose
+        vec3 objectNormal = cross(v1 - v0.xyz, v2 - v0.xyz);
+        normal = normalize(transpose(mat3(meshInstances[instanceIdx].worldToObject)) * objectNormal);
+        if (dot(normal, rayDir) > 0.0) {
+            normal = -normal;
+        }
+        hitMaterial = triangleMaterials[floatBitsToUint(v0.w)];
+    } else {
+        normal = normalize(hitPoint - sphereGeometry[sphereIdx].xyz);
+        hitMaterial = sphereMaterials[sphereIdx];
+    }
+
+    // Simple lighting (light at (1,1,0))
+    vec3 lightDir = normalize(vec3(1.0, 1.0, 0.0));
+    float brightness = max(dot(normal, lightDir), 0.0);
+    vec3 baseColor = hitMaterial.rgb * brightness;
+
+    // Fresnel reflection factor (based on view angle)
+    float viewDotNormal = max(dot(-rayDir, normal), 0.0);
+    float reflectFactor = fresnelSchlick(viewDotNormal, hitMaterial.a);
+
+    // Adjust reflection direction based on sphere curvature
+    vec3 reflectDir = normalize(reflect(rayDir, normal));
+
+    // Slightly distort the reflection direction based on normal
+    reflectDir = normalize(mix(reflectDir, normal, 0.2)); // 20% blend with normal for curvature
+
+    // Update the ray direction and origin for the next bounce
+    rayOrigin = hitPoint + reflectDir * 0.001; // Offset to avoid self-intersection
+    rayDir = reflectDir;
+
+    // Accumulate color with reflection factor
+    color += attenuation * mix(baseColor, color, reflectFactor);
+
+    // Reduce color strength for next bounce
+    attenuation *= hitMaterial.a;
+}
@@ -0,0 +1,45 @@
+#version 430
+
+// Fills the pixels a checkerboard frame did not trace. Their four direct neighbors were all traced this frame; the
+// pixel still holds what was traced there last frame, which is kept where it fits in between the neighbors and
+// clamped to their range where the view changed
+layout (local_size_x = 16, local_size_y = 16, local_size_z = 1) in;
+
+layout (rgba32f, binding = 0) uniform image2D img;
+
+// Phase of the traced pixels, (x + y + checkerboardPhase) is even on them
+uniform int checkerboardPhase;
+// The untraced pixels hold last frame's shading of the same scene
+uniform bool hasHistory;
+// Pixels traced, the top left corner of the image
+uniform ivec2 renderSize;
+
+void main() {
+    // One invocation per untraced pixel, every row holds half a row of them
+    ivec2 pixelCoords = ivec2(gl_GlobalInvocationID.x * 2u, gl_GlobalInvocationID.y);
+    pixelCoords.x += 1 - ((pixelCoords.y + checkerboardPhase) & 1);
+    ivec2 imgSize = renderSize;
+
+    if (pixelCoords.x >= imgSize.x || pixelCoords.y >= imgSize.y) return;
+
+    const ivec2 offsets[4] = ivec2[4](ivec2(-1, 0), ivec2(1, 0), ivec2(0, -1), ivec2(0, 1));
+    vec3 neighborSum = vec3(0.0);
+    vec3 neighborMin = vec3(1e30);
+    vec3 neighborMax = vec3(-1e30);
+    float neighborCount = 0.0;
+    for (int i = 0; i < 4; ++i) {
+        ivec2 neighborCoords = pixelCoords + offsets[i];
+        if (any(lessThan(neighborCoords, ivec2(0))) || any(greaterThanEqual(neighborCoords, imgSize))) continue;
+        vec3 neighbor = imageLoad(img, neighborCoords).rgb;
+        neighborSum += neighbor;
+        neighborMin = min(neighborMin, neighbor);
+        neighborMax = max(neighborMax, neighbor);
+        neighborCount += 1.0;
+    }
+
+    vec3 color = neighborSum / neighborCount;
+    if (hasHistory) {
+        color = clamp(imageLoad(img, pixelCoords).rgb, neighborMin, neighborMax);
+    }
+    imageStore(img, pixelCoords, vec4(color, 1.0));
+}
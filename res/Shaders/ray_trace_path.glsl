@@ -0,0 +1,39 @@
+// Whole path of one pixel sample in a single invocation, shared by the megakernel and the persistent threads
+// kernel. Included after the #version and layout lines
+
+#include "ray_traverse.glsl"
+#include "ray_sample.glsl"
+
+// Trace the scene with reflections (without recursion) and store the sample
+void tracePixelSample(ivec2 pixelCoords, int pixelSampleIndex, uint tileIdx) {
+    vec3 rayOrigin;
+    vec3 rayDir;
+    getPrimaryRay(pixelCoords, pixelSampleIndex, rayOrigin, rayDir);
+
+    vec3 accumulatedColor = vec3(0.0);
+    float currentAttenuation = 1.0; // How much color carries through reflections
+    float primaryHitDistance = BVH_MISS;
+
+    // Iterative ray tracing instead of recursion
+    for (int bounce = 0; bounce <= MAX_BOUNCES; ++bounce) {
+        // Find the closest intersection
+        float minT;
+        int closestSphereIndex;
+        int closestTriangleIndex;
+        int closestInstanceIndex;
+
+        // If no intersection, blend with background color
+        if (!findClosestHit(rayOrigin, rayDir, minT, closestSphereIndex, closestTriangleIndex, closestInstanceIndex)) {
+            accumulatedColor += currentAttenuation * BACKGROUND_COLOR;
+            break;
+        }
+        if (bounce == 0) {
+            primaryHitDistance = minT;
+        }
+
+        shadeHit(rayOrigin, rayDir, minT, closestSphereIndex, closestTriangleIndex, closestInstanceIndex,
+                 accumulatedColor, currentAttenuation);
+    }
+
+    storePixelSample(pixelCoords, pixelSampleIndex, tileIdx, accumulatedColor, primaryHitDistance);
+}
@@ -0,0 +1,52 @@
+#version 430
+
+// Persistent threads: only enough workgroups to fill the device are launched and every invocation keeps pulling
+// the next batch of pixels from a global counter until the frame runs out. Invocations that finish their cheap
+// paths start the next batch right away instead of idling until the expensive paths of their workgroup are done
+layout (local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+#include "ray_trace_path.glsl"
+
+// Work of the frame as the pixel dispatch of the megakernel would see it: its workgroup counts (copied from the
+// indirect dispatch arguments with adaptive sampling), and the next of its invocations to run, reset to 0
+layout(std430, binding = 20) buffer PersistentWorkBuffer {
+    uint numGroupsX;
+    uint numGroupsY;
+    uint numGroupsZ;
+    uint nextItem;
+};
+
+// Consecutive pixels pulled with one atomic, so the counter is hit a fraction as often. Small enough that the
+// invocations of a subgroup still trace neighboring pixels of a tile
+const uint PIXEL_BATCH = 4u;
+
+// Pixels an invocation pulls at most, a multiple of PIXEL_BATCH. Only set below the pixel count on llvmpipe, which cuts off the loops of an
+// invocation after a fixed total iteration count, so the launch there has to cover the frame with this many pixels
+// per invocation
+uniform uint maxPixelsPerInvocation;
+
+void main() {
+    const uint TILE_PIXELS = uint(TILE_SIZE * TILE_SIZE);
+    uint itemCount = numGroupsX * numGroupsY * TILE_PIXELS;
+
+    for (uint pulled = 0u; pulled < maxPixelsPerInvocation; pulled += PIXEL_BATCH) {
+        uint firstItem = atomicAdd(nextItem, PIXEL_BATCH);
+        if (firstItem >= itemCount) return;
+        uint endItem = min(firstItem + PIXEL_BATCH, itemCount);
+
+        for (uint item = firstItem; item < endItem; ++item) {
+            // Consecutive items walk a tile row by row so the invocations of a workgroup trace neighboring pixels
+            uint groupIdx = item / TILE_PIXELS;
+            uint localIdx = item % TILE_PIXELS;
+            uvec2 workGroupID = uvec2(groupIdx % numGroupsX, groupIdx / numGroupsX);
+            uvec2 localInvocationID = uvec2(localIdx % uint(TILE_SIZE), localIdx / uint(TILE_SIZE));
+
+            ivec2 pixelCoords;
+            int pixelSampleIndex;
+            uint tileIdx;
+            if (selectPixelSampleAt(workGroupID, localInvocationID, pixelCoords, pixelSampleIndex, tileIdx)) {
+                tracePixelSample(pixelCoords, pixelSampleIndex, tileIdx);
+            }
+        }
+    }
+}
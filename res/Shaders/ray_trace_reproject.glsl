@@ -0,0 +1,68 @@
+#version 430
+
+// Scatters last frame's shading into the current view. Every pixel of the last frame is moved to the world position
+// its primary ray hit and projected with the current camera. Run twice: pass 0 finds the nearest surface landing on
+// every pixel with atomicMin, pass 1 writes the color of that surface. Pixels nothing lands on are disoccluded and
+// keep a negative hit distance, the ray trace shader traces them again
+layout (local_size_x = 16, local_size_y = 16, local_size_z = 1) in;
+
+#include "frame_uniforms.glsl"
+
+// Last frame's color and primary hit distance
+layout (rgba32f, binding = 0) readonly uniform image2D img;
+layout (r32f, binding = 2) readonly uniform image2D hitDistanceImg;
+// Reprojected color (rgb) and hit distance in the current view (a), negative where nothing landed
+layout (rgba32f, binding = 3) uniform image2D reprojectedImg;
+
+// Hit distance bits of the nearest surface landing on every pixel, cleared to 0xFFFFFFFF before pass 0
+layout(std430, binding = 15) buffer ReprojectionDepthBuffer {
+    uint reprojectionDepth[];
+};
+
+uniform mat4 prevInvViewMatrix;
+uniform mat4 prevInvProjMatrix;
+uniform int reprojectPass;
+// Pixels traced, the top left corner of the images. The last frame was traced at the same size
+uniform ivec2 renderSize;
+
+const float BVH_MISS = 1e30;
+
+void main() {
+    ivec2 pixelCoords = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 imgSize = renderSize;
+
+    if (pixelCoords.x >= imgSize.x || pixelCoords.y >= imgSize.y) return;
+
+    if (reprojectPass == 0) {
+        // Every pixel is visited once per pass, so pass 0 also clears the output
+        imageStore(reprojectedImg, pixelCoords, vec4(0.0, 0.0, 0.0, -1.0));
+    }
+
+    // Rays that missed show the background, which is cheaper to trace again than to reproject
+    float hitDistance = imageLoad(hitDistanceImg, pixelCoords).r;
+    if (hitDistance >= BVH_MISS) return;
+
+    // Same primary ray as the unjittered sample of the ray trace shader
+    vec2 uv = (vec2(pixelCoords) / vec2(imgSize)) * 2.0 - 1.0;
+    vec4 viewSpacePos = prevInvProjMatrix * vec4(uv, -1.0, 1.0);
+    viewSpacePos /= viewSpacePos.w;
+    vec3 prevRayOrigin = vec3(prevInvViewMatrix[3]);
+    vec3 prevRayDir = normalize((prevInvViewMatrix * viewSpacePos).xyz - prevRayOrigin);
+    vec3 worldPos = prevRayOrigin + prevRayDir * hitDistance;
+
+    vec4 clipPos = viewProjMatrix * vec4(worldPos, 1.0);
+    if (clipPos.w <= 0.0) return;
+    vec2 ndc = clipPos.xy / clipPos.w;
+    // Pixel rays pass through the pixel corner, so round to the nearest corner
+    ivec2 target = ivec2(floor((ndc * 0.5 + 0.5) * vec2(imgSize) + 0.5));
+    if (any(lessThan(target, ivec2(0))) || any(greaterThanEqual(target, imgSize))) return;
+
+    float newHitDistance = length(worldPos - cameraPosition);
+    uint targetIdx = uint(target.y * imgSize.x + target.x);
+    if (reprojectPass == 0) {
+        // Positive floats order the same as their bits
+        atomicMin(reprojectionDepth[targetIdx], floatBitsToUint(newHitDistance));
+    } else if (reprojectionDepth[targetIdx] == floatBitsToUint(newHitDistance)) {
+        imageStore(reprojectedImg, target, vec4(imageLoad(img, pixelCoords).rgb, newHitDistance));
+    }
+}
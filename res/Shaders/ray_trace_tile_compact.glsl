@@ -0,0 +1,48 @@
+#version 430
+
+// Collects the tiles that still need samples into a list and counts them into the indirect dispatch arguments of
+// the adaptive ray trace. One thread per 16x16 pixel tile
+layout (local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+// Largest luminance standard error of the tile's pixels (float bits) and the samples it has been given
+struct TileState {
+    uint noiseBits;
+    uint sampleCount;
+};
+
+layout(std430, binding = 13) buffer TileStateBuffer {
+    TileState tileStates[];
+};
+
+layout(std430, binding = 14) writeonly buffer ActiveTileBuffer {
+    uint activeTiles[];
+};
+
+// glDispatchComputeIndirect arguments, numGroupsX is reset to 0 before this pass
+layout(std430, binding = 15) buffer DispatchArgsBuffer {
+    uint numGroupsX;
+    uint numGroupsY;
+    uint numGroupsZ;
+};
+
+uniform uint numTiles;
+uniform float noiseThreshold;
+// Every tile is traced until it has minSamples, the noise estimate is not trusted before that
+uniform uint minSamples;
+uniform uint maxSamples;
+
+void main() {
+    uint tileIdx = gl_GlobalInvocationID.x;
+    if (tileIdx >= numTiles) return;
+
+    TileState tile = tileStates[tileIdx];
+    bool noisy = tile.sampleCount < minSamples ||
+        (uintBitsToFloat(tile.noiseBits) > noiseThreshold && tile.sampleCount < maxSamples);
+    if (!noisy) return;
+
+    activeTiles[atomicAdd(numGroupsX, 1u)] = tileIdx;
+
+    // The trace grows the noise again from the new sample with atomicMax
+    tileStates[tileIdx].noiseBits = 0u;
+    tileStates[tileIdx].sampleCount = tile.sampleCount + 1u;
+}
@@ -0,0 +1,297 @@
+// Acceleration structures over the scene and the closest hit search. Included after the #version and layout lines
+
+#include "ray_scene.glsl"
+
+// Variants built for a fixed scene define the sphere count, the checks on it are then folded away
+#ifdef NUM_SPHERES
+const int numSpheres = NUM_SPHERES;
+#else
+uniform int numSpheres;
+#endif
+uniform int numInstances;
+
+const int BVH_STACK_SIZE = 64;
+
+// Flattened BVH over the spheres. Inner nodes have count 0 and children at leftFirst and leftFirst + 1,
+// leaves reference bvhPrimIndices[leftFirst .. leftFirst + count)
+struct BVHNode {
+    vec3 boundsMin;
+    int leftFirst;
+    vec3 boundsMax;
+    int count;
+};
+
+layout(std430, binding = 3) readonly buffer BVHNodeBuffer {
+    BVHNode bvhNodes[];
+};
+
+layout(std430, binding = 4) readonly buffer BVHPrimBuffer {
+    uint bvhPrimIndices[];
+};
+
+// Bottom level BVHs of all meshes back to back, same layout as the sphere BVH with global indices
+layout(std430, binding = 7) readonly buffer MeshBVHNodeBuffer {
+    BVHNode meshBVHNodes[];
+};
+
+layout(std430, binding = 8) readonly buffer MeshBVHPrimBuffer {
+    uint meshBVHPrimIndices[];
+};
+
+// Top level BVH over the world bounds of the instances, the leaves reference meshInstances
+layout(std430, binding = 10) readonly buffer TopLevelNodeBuffer {
+    BVHNode topLevelNodes[];
+};
+
+layout(std430, binding = 11) readonly buffer TopLevelPrimBuffer {
+    uint topLevelPrimIndices[];
+};
+
+// Ray-Sphere Intersection Function
+bool intersectSphere(vec3 rayOrigin, vec3 rayDir, vec4 sphere, out float t) {
+    vec3 oc = rayOrigin - sphere.xyz;
+    float a = dot(rayDir, rayDir);
+    float b = 2.0 * dot(oc, rayDir);
+    float c = dot(oc, oc) - sphere.w * sphere.w;
+    float discriminant = b * b - 4.0 * a * c;
+
+    if (discriminant < 0.0) return false; // No intersection
+
+    float sqrtD = sqrt(discriminant);
+    float t0 = (-b - sqrtD) / (2.0 * a);
+    float t1 = (-b + sqrtD) / (2.0 * a);
+
+    t = (t0 > 0.0) ? t0 : t1;
+    return t > 0.0;
+}
+
+// Slab test, returns the entry distance or BVH_MISS
+float intersectNode(vec3 rayOrigin, vec3 invRayDir, BVHNode node, float maxT) {
+    vec3 t0 = (node.boundsMin - rayOrigin) * invRayDir;
+    vec3 t1 = (node.boundsMax - rayOrigin) * invRayDir;
+    vec3 tNear = min(t0, t1);
+    vec3 tFar = max(t0, t1);
+    float tEnter = max(max(tNear.x, tNear.y), tNear.z);
+    float tExit = min(min(tFar.x, tFar.y), tFar.z);
+    return (tExit >= tEnter && tExit > 0.0 && tEnter < maxT) ? tEnter : BVH_MISS;
+}
+
+// Watertight ray/triangle test (Woop, Benthin, Wald 2013). The ray is sheared to point down its dominant axis
+// (kz) so edges shared by two triangles are never missed. Both faces are hit
+bool intersectTriangle(vec3 rayOrigin, ivec3 axes, vec3 shear, vec3 v0, vec3 v1, vec3 v2, out float t) {
+    vec3 a = v0 - rayOrigin;
+    vec3 b = v1 - rayOrigin;
+    vec3 c = v2 - rayOrigin;
+    float ax = a[axes.x] - shear.x * a[axes.z];
+    float ay = a[axes.y] - shear.y * a[axes.z];
+    float bx = b[axes.x] - shear.x * b[axes.z];
+    float by = b[axes.y] - shear.y * b[axes.z];
+    float cx = c[axes.x] - shear.x * c[axes.z];
+    float cy = c[axes.y] - shear.y * c[axes.z];
+
+    // Scaled barycentrics, recomputed in double precision when the ray runs exactly along an edge
+    float u = cx * by - cy * bx;
+    float v = ax * cy - ay * cx;
+    float w = bx * ay - by * ax;
+    if (u == 0.0 || v == 0.0 || w == 0.0) {
+        u = float(double(cx) * double(by) - double(cy) * double(bx));
+        v = float(double(ax) * double(cy) - double(ay) * double(cx));
+        w = float(double(bx) * double(ay) - double(by) * double(ax));
+    }
+    if ((u < 0.0 || v < 0.0 || w < 0.0) && (u > 0.0 || v > 0.0 || w > 0.0)) {
+        return false;
+    }
+    float det = u + v + w;
+    if (det == 0.0) {
+        return false;
+    }
+
+    t = (u * shear.z * a[axes.z] + v * shear.z * b[axes.z] + w * shear.z * c[axes.z]) / det;
+    return t > 0.0;
+}
+
+// Same traversal as findClosestSphere over the BVH of one mesh starting at rootNode. The ray is in the object space
+// of the mesh. Only hits closer than minT are returned
+int findClosestTriangle(vec3 rayOrigin, vec3 rayDir, int rootNode, inout float minT) {
+    int closestTriangleIndex = -1;
+
+    vec3 invRayDir = 1.0 / rayDir;
+    if (intersectNode(rayOrigin, invRayDir, meshBVHNodes[rootNode], minT) == BVH_MISS) {
+        return -1;
+    }
+
+    // Per ray shear of the watertight test
+    vec3 absDir = abs(rayDir);
+    int kz = (absDir.x > absDir.y) ? ((absDir.x > absDir.z) ? 0 : 2) : ((absDir.y > absDir.z) ? 1 : 2);
+    int kx = (kz + 1) % 3;
+    int ky = (kx + 1) % 3;
+    if (rayDir[kz] < 0.0) {
+        int tmpAxis = kx; kx = ky; ky = tmpAxis;
+    }
+    ivec3 axes = ivec3(kx, ky, kz);
+    vec3 shear = vec3(rayDir[kx] / rayDir[kz], rayDir[ky] / rayDir[kz], 1.0 / rayDir[kz]);
+
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    int nodeIdx = rootNode;
+
+    while (true) {
+        BVHNode node = meshBVHNodes[nodeIdx];
+        if (node.count > 0) {
+            for (int i = 0; i < node.count; ++i) {
+                int triangleIdx = int(meshBVHPrimIndices[node.leftFirst + i]);
+                float t;
+                if (intersectTriangle(rayOrigin, axes, shear, triangleVertices[triangleIdx * 3].xyz,
+                        triangleVertices[triangleIdx * 3 + 1].xyz, triangleVertices[triangleIdx * 3 + 2].xyz, t) && t < minT) {
+                    minT = t;
+                    closestTriangleIndex = triangleIdx;
+                }
+            }
+        } else {
+            int nearIdx = node.leftFirst;
+            int farIdx = node.leftFirst + 1;
+            float nearT = intersectNode(rayOrigin, invRayDir, meshBVHNodes[nearIdx], minT);
+            float farT = intersectNode(rayOrigin, invRayDir, meshBVHNodes[farIdx], minT);
+            if (nearT > farT) {
+                int tmpIdx = nearIdx; nearIdx = farIdx; farIdx = tmpIdx;
+                float tmpT = nearT; nearT = farT; farT = tmpT;
+            }
+            if (nearT != BVH_MISS) {
+                if (farT != BVH_MISS) {
+                    stack[stackSize++] = farIdx;
+                }
+                nodeIdx = nearIdx;
+                continue;
+            }
+        }
+
+        if (stackSize == 0) {
+            break;
+        }
+        nodeIdx = stack[--stackSize];
+    }
+
+    return closestTriangleIndex;
+}
+
+// Traverse the top level BVH in world space and the mesh of every instance reached in its object space. The object
+// space direction is not normalized so hit distances stay world space ones. Returns the closest triangle index closer
+// than minT or -1
+int findClosestMeshHit(vec3 rayOrigin, vec3 rayDir, inout float minT, out int hitInstance) {
+    int closestTriangleIndex = -1;
+    hitInstance = -1;
+    if (numInstances == 0) {
+        return -1;
+    }
+
+    vec3 invRayDir = 1.0 / rayDir;
+    if (intersectNode(rayOrigin, invRayDir, topLevelNodes[0], minT) == BVH_MISS) {
+        return -1;
+    }
+
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    int nodeIdx = 0;
+
+    while (true) {
+        BVHNode node = topLevelNodes[nodeIdx];
+        if (node.count > 0) {
+            for (int i = 0; i < node.count; ++i) {
+                int instanceIdx = int(topLevelPrimIndices[node.leftFirst + i]);
+                mat4 worldToObject = meshInstances[instanceIdx].worldToObject;
+                vec3 objectOrigin = (worldToObject * vec4(rayOrigin, 1.0)).xyz;
+                vec3 objectDir = (worldToObject * vec4(rayDir, 0.0)).xyz;
+                int triangleIdx = findClosestTriangle(objectOrigin, objectDir, int(meshInstances[instanceIdx].info.x), minT);
+                if (triangleIdx != -1) {
+                    closestTriangleIndex = triangleIdx;
+                    hitInstance = instanceIdx;
+                }
+            }
+        } else {
+            int nearIdx = node.leftFirst;
+            int farIdx = node.leftFirst + 1;
+            float nearT = intersectNode(rayOrigin, invRayDir, topLevelNodes[nearIdx], minT);
+            float farT = intersectNode(rayOrigin, invRayDir, topLevelNodes[farIdx], minT);
+            if (nearT > farT) {
+                int tmpIdx = nearIdx; nearIdx = farIdx; farIdx = tmpIdx;
+                float tmpT = nearT; nearT = farT; farT = tmpT;
+            }
+            if (nearT != BVH_MISS) {
+                if (farT != BVH_MISS) {
+                    stack[stackSize++] = farIdx;
+                }
+                nodeIdx = nearIdx;
+                continue;
+            }
+        }
+
+        if (stackSize == 0) {
+            break;
+        }
+        nodeIdx = stack[--stackSize];
+    }
+
+    return closestTriangleIndex;
+}
+
+// Stack based BVH traversal visiting the nearer child first. Returns the closest sphere index or -1
+int findClosestSphere(vec3 rayOrigin, vec3 rayDir, out float minT) {
+    minT = 1e20;
+    int closestSphereIndex = -1;
+    if (numSpheres == 0) {
+        return -1;
+    }
+
+    vec3 invRayDir = 1.0 / rayDir;
+    if (intersectNode(rayOrigin, invRayDir, bvhNodes[0], minT) == BVH_MISS) {
+        return -1;
+    }
+
+    int stack[BVH_STACK_SIZE];
+    int stackSize = 0;
+    int nodeIdx = 0;
+
+    while (true) {
+        BVHNode node = bvhNodes[nodeIdx];
+        if (node.count > 0) {
+            for (int i = 0; i < node.count; ++i) {
+                int sphereIdx = int(bvhPrimIndices[node.leftFirst + i]);
+                float t;
+                if (intersectSphere(rayOrigin, rayDir, sphereGeometry[sphereIdx], t) && t < minT) {
+                    minT = t;
+                    closestSphereIndex = sphereIdx;
+                }
+            }
+        } else {
+            int nearIdx = node.leftFirst;
+            int farIdx = node.leftFirst + 1;
+            float nearT = intersectNode(rayOrigin, invRayDir, bvhNodes[nearIdx], minT);
+            float farT = intersectNode(rayOrigin, invRayDir, bvhNodes[farIdx], minT);
+            if (nearT > farT) {
+                int tmpIdx = nearIdx; nearIdx = farIdx; farIdx = tmpIdx;
+                float tmpT = nearT; nearT = farT; farT = tmpT;
+            }
+            if (nearT != BVH_MISS) {
+                if (farT != BVH_MISS) {
+                    stack[stackSize++] = farIdx;
+                }
+                nodeIdx = nearIdx;
+                continue;
+            }
+        }
+
+        if (stackSize == 0) {
+            break;
+        }
+        nodeIdx = stack[--stackSize];
+    }
+
+    return closestSphereIndex;
+}
+
+// Closest sphere or triangle along a ray. Returns false if the ray leaves the scene
+bool findClosestHit(vec3 rayOrigin, vec3 rayDir, out float minT, out int sphereIdx, out int triangleIdx, out int instanceIdx) {
+    sphereIdx = findClosestSphere(rayOrigin, rayDir, minT);
+    triangleIdx = findClosestMeshHit(rayOrigin, rayDir, minT, instanceIdx);
+    return sphereIdx != -1 || triangleIdx != -1;
+}
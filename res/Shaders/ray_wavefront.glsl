@@ -0,0 +1,60 @@
+// Path state and ray queues of the wavefront stages (ray_wavefront_*.glsl). A path is kept per pixel and the queues
+// list the paths still alive, so every stage only runs on rays that can still add color. Included after the
+// #version and layout lines
+
+// Local size of the queue stages, every WAVEFRONT_GROUP_SIZE queued paths add a workgroup to the dispatch
+const uint WAVEFRONT_GROUP_SIZE = 64u;
+
+struct Path {
+    // xyz = ray origin, w = primary hit distance
+    vec4 origin;
+    // xyz = ray direction, w = attenuation of what the ray finds, 0 once the path is finished
+    vec4 direction;
+    // rgb = color gathered so far
+    vec4 color;
+};
+
+// Paths indexed by pixel, y * renderSize.x + x
+layout(std430, binding = 16) buffer PathBuffer {
+    Path paths[];
+};
+
+// Closest hit found by the extend stage, indexed like the paths
+struct PathHit {
+    float t;
+    int sphereIdx;
+    int triangleIdx;
+    int instanceIdx;
+};
+
+layout(std430, binding = 17) buffer PathHitBuffer {
+    PathHit pathHits[];
+};
+
+// Paths the stage runs on. The header doubles as the indirect dispatch arguments of the stage
+layout(std430, binding = 18) buffer InputPathQueue {
+    uint numGroupsX;
+    uint numGroupsY;
+    uint numGroupsZ;
+    uint count;
+    uint pathIndices[];
+} inputQueue;
+
+// Paths handed to the next bounce, the header is cleared to (0, 1, 1, 0) before the stage
+layout(std430, binding = 19) buffer OutputPathQueue {
+    uint numGroupsX;
+    uint numGroupsY;
+    uint numGroupsZ;
+    uint count;
+    uint pathIndices[];
+} outputQueue;
+
+// Append a path to the output queue
+void enqueuePath(uint pathIdx) {
+    uint slot = atomicAdd(outputQueue.count, 1u);
+    outputQueue.pathIndices[slot] = pathIdx;
+    // The first path of every group of WAVEFRONT_GROUP_SIZE adds its workgroup
+    if (slot % WAVEFRONT_GROUP_SIZE == 0u) {
+        atomicAdd(outputQueue.numGroupsX, 1u);
+    }
+}
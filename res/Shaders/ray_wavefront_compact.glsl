@@ -0,0 +1,16 @@
+#version 430
+
+// Wavefront stage 4: queue the paths still alive for the next bounce. Finished paths drop out, so the next stages
+// only launch workgroups for rays that are still traced
+layout (local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+#include "ray_wavefront.glsl"
+
+void main() {
+    if (gl_GlobalInvocationID.x >= inputQueue.count) return;
+    uint pathIdx = inputQueue.pathIndices[gl_GlobalInvocationID.x];
+
+    if (paths[pathIdx].direction.w > 0.0) {
+        enqueuePath(pathIdx);
+    }
+}
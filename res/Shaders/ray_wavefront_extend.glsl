@@ -0,0 +1,19 @@
+#version 430
+
+// Wavefront stage 2: find the closest hit of every queued path. Only traversal runs here, so neighboring
+// invocations stay in the same loops
+layout (local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+#include "ray_traverse.glsl"
+#include "ray_wavefront.glsl"
+
+void main() {
+    if (gl_GlobalInvocationID.x >= inputQueue.count) return;
+    uint pathIdx = inputQueue.pathIndices[gl_GlobalInvocationID.x];
+
+    PathHit hit;
+    if (!findClosestHit(paths[pathIdx].origin.xyz, paths[pathIdx].direction.xyz, hit.t, hit.sphereIdx, hit.triangleIdx, hit.instanceIdx)) {
+        hit.t = BVH_MISS;
+    }
+    pathHits[pathIdx] = hit;
+}
@@ -0,0 +1,22 @@
+#version 430
+
+// Wavefront stage 1: start a path at every pixel the sampling mode selects and queue it for the first extend
+layout (local_size_x = 16, local_size_y = 16, local_size_z = 1) in;
+
+#include "ray_sample.glsl"
+#include "ray_wavefront.glsl"
+
+void main() {
+    ivec2 pixelCoords;
+    int pixelSampleIndex;
+    uint tileIdx;
+    if (!selectPixelSample(pixelCoords, pixelSampleIndex, tileIdx)) return;
+
+    vec3 rayOrigin;
+    vec3 rayDir;
+    getPrimaryRay(pixelCoords, pixelSampleIndex, rayOrigin, rayDir);
+
+    uint pathIdx = uint(pixelCoords.y * renderSize.x + pixelCoords.x);
+    paths[pathIdx] = Path(vec4(rayOrigin, BVH_MISS), vec4(rayDir, 1.0), vec4(0.0));
+    enqueuePath(pathIdx);
+}
@@ -0,0 +1,60 @@
+#version 430
+
+// Wavefront ray reordering before a secondary bounce. Reflection rays leave the surfaces in every direction, so
+// neighboring queue slots would traverse unrelated parts of the scene. Pass 0 writes a sort key per queued path,
+// GpuRadixSort sorts the paths by it and pass 1 writes them back into the queue in key order, so the next extend
+// runs rays that start close together and head the same way next to each other
+layout (local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+#include "ray_wavefront.glsl"
+
+// Key of every queued path, indexed like the queue
+layout(std430, binding = 21) buffer SortKeyBuffer {
+    uint sortKeys[];
+};
+
+// Path indices sorted along with the keys
+layout(std430, binding = 22) buffer SortedPathBuffer {
+    uint sortedPaths[];
+};
+
+uniform int reorderPass;
+// Bounds the ray origins are quantized in, origins outside are clamped to the border cells
+uniform vec3 sceneBoundsMin;
+uniform vec3 sceneBoundsMax;
+
+// Grid cells per axis of the origin part of the key, 2^ORIGIN_CELL_BITS
+const uint ORIGIN_CELL_BITS = 4u;
+
+// Spreads the lower 10 bits so there are two zero bits between each of them
+uint expandBits(uint value) {
+    value = (value * 0x00010001u) & 0xFF0000FFu;
+    value = (value * 0x00000101u) & 0x0F00F00Fu;
+    value = (value * 0x00000011u) & 0xC30C30C3u;
+    value = (value * 0x00000005u) & 0x49249249u;
+    return value;
+}
+
+// Morton code of the origin cell above the direction octant, 3 * ORIGIN_CELL_BITS + 3 bits
+uint getSortKey(vec3 origin, vec3 direction) {
+    float cellsPerAxis = float(1u << ORIGIN_CELL_BITS);
+    vec3 extent = max(sceneBoundsMax - sceneBoundsMin, vec3(1e-6));
+    uvec3 cell = uvec3(clamp((origin - sceneBoundsMin) / extent * cellsPerAxis, vec3(0.0), vec3(cellsPerAxis - 1.0)));
+    uint cellCode = (expandBits(cell.x) << 2) | (expandBits(cell.y) << 1) | expandBits(cell.z);
+    uvec3 negative = uvec3(lessThan(direction, vec3(0.0)));
+    uint octant = (negative.x << 2) | (negative.y << 1) | negative.z;
+    return (cellCode << 3) | octant;
+}
+
+void main() {
+    uint slot = gl_GlobalInvocationID.x;
+    if (slot >= inputQueue.count) return;
+
+    if (reorderPass == 0) {
+        uint pathIdx = inputQueue.pathIndices[slot];
+        sortKeys[slot] = getSortKey(paths[pathIdx].origin.xyz, paths[pathIdx].direction.xyz);
+        sortedPaths[slot] = pathIdx;
+    } else {
+        inputQueue.pathIndices[slot] = sortedPaths[slot];
+    }
+}
@@ -0,0 +1,50 @@
+#version 430
+
+// Wavefront stage 3: shade the hits of the queued paths and set up their reflection rays. Paths that leave the
+// scene, can't add any more color or ran out of bounces store their sample
+layout (local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+#include "ray_scene.glsl"
+#include "ray_sample.glsl"
+#include "ray_wavefront.glsl"
+
+// Bounce of the queued paths, 0 for the primary rays
+uniform int bounce;
+
+void main() {
+    if (gl_GlobalInvocationID.x >= inputQueue.count) return;
+    uint pathIdx = inputQueue.pathIndices[gl_GlobalInvocationID.x];
+
+    Path path = paths[pathIdx];
+    PathHit hit = pathHits[pathIdx];
+    vec3 color = path.color.rgb;
+    float attenuation = path.direction.w;
+
+    if (hit.t == BVH_MISS) {
+        color += attenuation * BACKGROUND_COLOR;
+        attenuation = 0.0;
+    } else {
+        if (bounce == 0) {
+            path.origin.w = hit.t;
+        }
+        vec3 rayOrigin = path.origin.xyz;
+        vec3 rayDir = path.direction.xyz;
+        shadeHit(rayOrigin, rayDir, hit.t, hit.sphereIdx, hit.triangleIdx, hit.instanceIdx, color, attenuation);
+        path.origin.xyz = rayOrigin;
+        path.direction.xyz = rayDir;
+        if (bounce == MAX_BOUNCES) {
+            attenuation = 0.0;
+        }
+    }
+
+    if (attenuation == 0.0) {
+        ivec2 pixelCoords = ivec2(int(pathIdx) % renderSize.x, int(pathIdx) / renderSize.x);
+        uint tileIdx;
+        int pixelSampleIndex = getPixelSampleIndex(pixelCoords, tileIdx);
+        storePixelSample(pixelCoords, pixelSampleIndex, tileIdx, color, path.origin.w);
+    }
+
+    path.color.rgb = color;
+    path.direction.w = attenuation;
+    paths[pathIdx] = path;
+}
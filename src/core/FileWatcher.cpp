@@ -0,0 +1,97 @@
+// standard lib
+#include <algorithm>
+#include <system_error>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+// project
+#include "core/FileWatcher.h"
+
+
+FileWatcher::FileWatcher(const std::string& directory) : mDirectory_(directory) {
+#ifdef __linux__
+    mInotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    // Editors either write the file in place or write a new file and move it over the old one
+    const uint32_t events = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+    if (mInotifyFd_ >= 0 && inotify_add_watch(mInotifyFd_, mDirectory_.c_str(), events) < 0) {
+        close(mInotifyFd_);
+        mInotifyFd_ = -1;
+    }
+#endif
+    if (mInotifyFd_ < 0) {
+        // The first scan only records the current write times
+        pollWriteTimes();
+    }
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+    if (mInotifyFd_ >= 0) {
+        close(mInotifyFd_);
+    }
+#endif
+}
+
+std::vector<std::string> FileWatcher::pollChanges() {
+    std::vector<std::string> changedFiles;
+#ifdef __linux__
+    if (mInotifyFd_ >= 0) {
+        // Aligned for the inotify_event records read into it
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = read(mInotifyFd_, buffer, sizeof(buffer))) > 0) {
+            for (ssize_t offset = 0; offset < length;) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                if (event->len > 0 && (event->mask & IN_ISDIR) == 0) {
+                    const std::string filePath = getFilePath(event->name);
+                    if (std::find(changedFiles.begin(), changedFiles.end(), filePath) == changedFiles.end()) {
+                        changedFiles.push_back(filePath);
+                    }
+                }
+                offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            }
+        }
+        return changedFiles;
+    }
+#endif
+    const auto now = std::chrono::steady_clock::now();
+    if (now - mLastPollTime_ < kPollInterval) {
+        return changedFiles;
+    }
+    return pollWriteTimes();
+}
+
+std::vector<std::string> FileWatcher::pollWriteTimes() {
+    mLastPollTime_ = std::chrono::steady_clock::now();
+
+    std::vector<std::string> changedFiles;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(mDirectory_, error)) {
+        if (!entry.is_regular_file(error)) {
+            continue;
+        }
+        const std::filesystem::file_time_type writeTime = entry.last_write_time(error);
+        if (error) {
+            continue;
+        }
+        const std::string filePath = getFilePath(entry.path().filename().string());
+        auto it = mWriteTimes_.find(filePath);
+        if (it == mWriteTimes_.end()) {
+            // Files seen on the first scan are not changes
+            if (mScanned_) {
+                changedFiles.push_back(filePath);
+            }
+            mWriteTimes_[filePath] = writeTime;
+        } else if (it->second != writeTime) {
+            it->second = writeTime;
+            changedFiles.push_back(filePath);
+        }
+    }
+    mScanned_ = true;
+    return changedFiles;
+}
+
+std::string FileWatcher::getFilePath(const std::string& fileName) const {
+    return std::filesystem::path(mDirectory_ + "/" + fileName).lexically_normal().string();
+}
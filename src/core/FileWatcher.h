@@ -0,0 +1,54 @@
+#pragma once
+// standard lib
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Reports files written in a directory, without blocking. Uses inotify on Linux and otherwise compares the last
+ * write times of the files every kPollInterval
+ */
+class FileWatcher {
+public:
+    /**
+     * Constructor
+     * @param directory Directory to watch, subdirectories are not watched
+     */
+    explicit FileWatcher(const std::string& directory);
+
+    /** Destructor */
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    /**
+     * Get the files written, created or moved into the directory since the last call
+     * @return Paths of the changed files as directory + "/" + file name, lexically normalized. Every file once
+     */
+    std::vector<std::string> pollChanges();
+
+    /** Time between two scans of the directory when polling */
+    static constexpr std::chrono::milliseconds kPollInterval{500};
+
+private:
+    /** Scan the directory and report the files whose write time changed */
+    std::vector<std::string> pollWriteTimes();
+
+    std::string getFilePath(const std::string& fileName) const;
+
+    std::string mDirectory_;
+
+    /** inotify instance, -1 when polling */
+    int mInotifyFd_ = -1;
+
+    /** Last write time of every file, only kept when polling */
+    std::map<std::string, std::filesystem::file_time_type> mWriteTimes_;
+
+    /** If the directory was scanned before, new files on the first scan are not changes */
+    bool mScanned_ = false;
+
+    std::chrono::steady_clock::time_point mLastPollTime_;
+};
@@ -0,0 +1,204 @@
+// standard lib
+#include <stdexcept>
+// project
+#include "core/ThreadPool.h"
+
+namespace {
+    /** Pool the current thread works for, used to route nested submits to the local deque */
+    thread_local const ThreadPool* tOwnerPool = nullptr;
+    thread_local unsigned int tWorkerIdx = 0;
+    /** Pool whose task the current thread is running, workers and threads helping in wait alike */
+    thread_local const ThreadPool* tTaskPool = nullptr;
+}
+
+ThreadPool::ThreadPool(unsigned int threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned int i = 0; i < threadCount; ++i) {
+        mQueues_.emplace_back(std::make_unique<WorkQueue>());
+    }
+    for (unsigned int i = 0; i < threadCount; ++i) {
+        mWorkers_.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex_);
+        mStopping_ = true;
+    }
+    mWakeCondition_.notify_all();
+
+    for (auto& worker : mWorkers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(Task task) {
+    unsigned int queueIdx = currentWorkerIdx();
+    if (queueIdx == mQueues_.size()) {
+        queueIdx = mNextQueue_.fetch_add(1, std::memory_order_relaxed) % mQueues_.size();
+    }
+
+    mPendingCount_.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(mQueues_[queueIdx]->mutex);
+        mQueues_[queueIdx]->tasks.push_back(std::move(task));
+    }
+    {
+        // Lock so a worker about to sleep cannot miss the new task
+        std::lock_guard<std::mutex> lock(mSleepMutex_);
+        mQueuedCount_.fetch_add(1);
+    }
+    mWakeCondition_.notify_one();
+}
+
+void ThreadPool::wait() {
+    // The calling task is pending itself, the count would never reach zero
+    if (tTaskPool == this) {
+        throw std::runtime_error("ThreadPool::wait called from one of its own tasks, use a TaskGroup");
+    }
+    const unsigned int workerIdx = currentWorkerIdx();
+
+    while (mPendingCount_.load() > 0) {
+        Task task;
+        if (popTask(workerIdx, task)) {
+            runTask(task);
+            continue;
+        }
+
+        // Nothing left to steal, wait for the running tasks to complete
+        std::unique_lock<std::mutex> lock(mSleepMutex_);
+        mDoneCondition_.wait(lock, [this]() {
+            return mPendingCount_.load() == 0 || mQueuedCount_.load() > 0;
+        });
+    }
+}
+
+unsigned int ThreadPool::getThreadCount() const {
+    return static_cast<unsigned int>(mWorkers_.size());
+}
+
+void ThreadPool::parallelFor(std::size_t begin, std::size_t end, std::size_t grainSize, const std::function<void(std::size_t, std::size_t)>& fn) {
+    if (end <= begin) {
+        return;
+    }
+
+    // A few chunks per worker so stealing can even out uneven chunks
+    const std::size_t count = end - begin;
+    const std::size_t chunkCount = std::max<std::size_t>(1, std::min(count / std::max<std::size_t>(grainSize, 1), mWorkers_.size() * 4));
+    const std::size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+    TaskGroup group(*this);
+    for (std::size_t chunkBegin = begin + chunkSize; chunkBegin < end; chunkBegin += chunkSize) {
+        const std::size_t chunkEnd = std::min(chunkBegin + chunkSize, end);
+        group.run([&fn, chunkBegin, chunkEnd]() {
+            fn(chunkBegin, chunkEnd);
+        });
+    }
+    // The calling thread takes the first chunk itself
+    fn(begin, std::min(begin + chunkSize, end));
+    group.wait();
+}
+
+void ThreadPool::workerLoop(unsigned int workerIdx) {
+    tOwnerPool = this;
+    tWorkerIdx = workerIdx;
+
+    while (true) {
+        Task task;
+        if (popTask(workerIdx, task)) {
+            runTask(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mSleepMutex_);
+        mWakeCondition_.wait(lock, [this]() {
+            return mStopping_ || mQueuedCount_.load() > 0;
+        });
+        if (mStopping_ && mQueuedCount_.load() == 0) {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::popTask(unsigned int workerIdx, Task& task) {
+    const unsigned int queueCount = static_cast<unsigned int>(mQueues_.size());
+
+    // Own deque first (LIFO keeps the most recently split work hot in cache)
+    if (workerIdx < queueCount) {
+        WorkQueue& queue = *mQueues_[workerIdx];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            mQueuedCount_.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // Steal the oldest task from the other workers
+    for (unsigned int i = 1; i <= queueCount; ++i) {
+        WorkQueue& queue = *mQueues_[(workerIdx + i) % queueCount];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            mQueuedCount_.fetch_sub(1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::runTask(Task& task) {
+    const ThreadPool* pOuterTaskPool = tTaskPool;
+    tTaskPool = this;
+    task();
+    tTaskPool = pOuterTaskPool;
+
+    if (mPendingCount_.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(mSleepMutex_);
+        mDoneCondition_.notify_all();
+    }
+}
+
+bool ThreadPool::tryRunPendingTask() {
+    Task task;
+    if (popTask(currentWorkerIdx(), task)) {
+        runTask(task);
+        return true;
+    }
+    return false;
+}
+
+unsigned int ThreadPool::currentWorkerIdx() const {
+    return (tOwnerPool == this) ? tWorkerIdx : static_cast<unsigned int>(mQueues_.size());
+}
+
+ThreadPool::TaskGroup::TaskGroup(ThreadPool& pool)
+    : mPool_(pool) {}
+
+ThreadPool::TaskGroup::~TaskGroup() {
+    wait();
+}
+
+void ThreadPool::TaskGroup::run(Task task) {
+    mPendingCount_.fetch_add(1);
+    mPool_.submit([this, task = std::move(task)]() {
+        task();
+        mPendingCount_.fetch_sub(1);
+    });
+}
+
+void ThreadPool::TaskGroup::wait() {
+    // Help with any queued work (possibly of other groups) instead of blocking a worker
+    while (mPendingCount_.load() > 0) {
+        if (!mPool_.tryRunPendingTask()) {
+            std::this_thread::yield();
+        }
+    }
+}
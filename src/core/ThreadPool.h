@@ -0,0 +1,122 @@
+#pragma once
+// standard lib
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Work-stealing thread pool. Every worker owns a task deque, pops its own work from the back and steals
+ * from the front of the other workers' deques when it runs dry.
+ */
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    /** Tasks that can be waited on independently of the rest of the pool, e.g. from inside another task */
+    class TaskGroup {
+    public:
+        /** Constructor */
+        explicit TaskGroup(ThreadPool& pool);
+
+        /** Destructor. Waits for the group's tasks */
+        ~TaskGroup();
+
+        /**
+         * Queue a task in this group
+         * @param task Task to run
+         */
+        void run(Task task);
+
+        /** Block until every task of the group has finished. The calling thread helps run queued tasks */
+        void wait();
+
+    private:
+        ThreadPool& mPool_;
+        /** Tasks of this group that have not finished */
+        std::atomic<std::size_t> mPendingCount_ = 0;
+    };
+
+    /**
+     * Constructor
+     * @param threadCount Number of worker threads. 0 uses the hardware concurrency of the machine
+     */
+    explicit ThreadPool(unsigned int threadCount = 0);
+
+    /** Destructor. Finishes the queued tasks and joins the workers */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Queue a task. Tasks submitted from a worker go to that worker's own deque
+     * @param task Task to run
+     */
+    void submit(Task task);
+
+    /**
+     * Block until every submitted task has finished. The calling thread helps run tasks while waiting. A task
+     * would wait for itself, so tasks of this pool have to wait with TaskGroup::wait instead, wait throws there
+     */
+    void wait();
+
+    /** Get the number of worker threads */
+    unsigned int getThreadCount() const;
+
+    /**
+     * Split [begin, end) into chunks and run them in parallel, returning once all chunks are done
+     * @param begin First index
+     * @param end One past the last index
+     * @param grainSize Minimum number of indices per chunk
+     * @param fn Called with the begin and end index of each chunk
+     */
+    void parallelFor(std::size_t begin, std::size_t end, std::size_t grainSize, const std::function<void(std::size_t, std::size_t)>& fn);
+
+private:
+    /** Per worker task deque */
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    /** Run loop of each worker thread */
+    void workerLoop(unsigned int workerIdx);
+
+    /**
+     * Take a task from the given worker's deque or steal one from another worker
+     * @param workerIdx Index of the calling worker, or the worker count for non-worker threads
+     * @param task Output task
+     */
+    bool popTask(unsigned int workerIdx, Task& task);
+
+    /** Run a task taken from the queues and update the pending counters */
+    void runTask(Task& task);
+
+    /** Run one queued task on the calling thread if there is any */
+    bool tryRunPendingTask();
+
+    /** Index of the calling thread if it is a worker of this pool, otherwise the worker count */
+    unsigned int currentWorkerIdx() const;
+
+    std::vector<std::thread> mWorkers_;
+    std::vector<std::unique_ptr<WorkQueue>> mQueues_;
+
+    /** Tasks sitting in the deques */
+    std::atomic<std::size_t> mQueuedCount_ = 0;
+    /** Tasks queued or running */
+    std::atomic<std::size_t> mPendingCount_ = 0;
+    /** Round robin queue index for tasks submitted from outside the pool */
+    std::atomic<unsigned int> mNextQueue_ = 0;
+
+    std::mutex mSleepMutex_;
+    std::condition_variable mWakeCondition_;
+    std::condition_variable mDoneCondition_;
+    bool mStopping_ = false;
+};
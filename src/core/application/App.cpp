@@ -24,13 +24,28 @@ void App::initialize() {
     if (GLEW_OK != err) {
         throw std::runtime_error("GLEW Init error");
     }
+    // Let the driver compile on as many threads as it has, the programs are all compiled at once in loadResources
+    if (GLEW_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    } else if (GLEW_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    }
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
     glEnable(GL_STENCIL_TEST);
     glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
     glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
     
+    // Programs linked on an earlier start are loaded from their binaries instead of being compiled again
+    const auto loadStart = std::chrono::steady_clock::now();
+    mResources_.enableProgramBinaryCache("shader_cache");
     loadResources();
+    mResources_.finishShaderLoads();
+    const std::chrono::duration<float, std::milli> loadTime = std::chrono::steady_clock::now() - loadStart;
+    std::cout << "Loaded resources in " << loadTime.count() << " ms" << std::endl;
+    mpFrameUniforms_ = std::make_unique<FrameUniformBuffer>();
+    mpShaderWatcher_ = std::make_unique<FileWatcher>(std::string(RESOURCE_PATH) + "/Shaders");
+    mStartTime_ = std::chrono::steady_clock::now();
 
     // set up imgui
     {
@@ -112,7 +127,13 @@ void App::update() {
 }
 
 void App::render() {
+    reloadChangedShaders();
+
+    // The scene writes its camera into this frame's slot of the uniform buffer
+    std::chrono::duration<float> time = (std::chrono::steady_clock::now() - mStartTime_);
+    mpFrameUniforms_->beginFrame(time.count());
     mScenes_[mCurrentSceneIdx_]->render();
+    mpFrameUniforms_->endFrame();
     mScenes_[mCurrentSceneIdx_]->renderUI();
 
     mpWindow_->render();
@@ -141,6 +162,20 @@ void App::setAntiAliasing(unsigned int sampleSize) {
 
 }
 
+void App::reloadChangedShaders() {
+    mResources_.reloadShaders(mpShaderWatcher_->pollChanges());
+    const std::vector<std::string> reloadedPrograms = mResources_.swapReloadedShaders();
+    if (reloadedPrograms.empty()) {
+        return;
+    }
+    for (const std::string& programName : reloadedPrograms) {
+        std::cout << "Reloaded shader program " << programName << std::endl;
+    }
+    for (const auto& scene : mScenes_) {
+        scene->onShadersReloaded(reloadedPrograms);
+    }
+}
+
 void App::loadResources() {
     mResources_.loadResource<ShaderProgram>(
         {{ std::string(RESOURCE_PATH) + "/Shaders/compute_shader.glsl:COMPUTE"}},
@@ -191,8 +226,95 @@ void App::loadResources() {
         {{ std::string(RESOURCE_PATH) + "/Shaders/ray_trace_multi.glsl:COMPUTE"}},
         "RayTraceMulti"
     );
+
+    mResources_.loadResource<ShaderProgram>(
+        {{ std::string(RESOURCE_PATH) + "/Shaders/ray_trace_tile_compact.glsl:COMPUTE"}},
+        "RayTraceTileCompact"
+    );
+
+    mResources_.loadResource<ShaderProgram>(
+        {{ std::string(RESOURCE_PATH) + "/Shaders/ray_trace_reproject.glsl:COMPUTE"}},
+        "RayTraceReproject"
+    );
+
+    mResources_.loadResource<ShaderProgram>(
+        {{ std::string(RESOURCE_PATH) + "/Shaders/ray_trace_checkerboard.glsl:COMPUTE"}},
+        "RayTraceCheckerboard"
+    );
+
+    // Megakernel run by persistent threads pulling pixels from a global counter
+    mResources_.loadResource<ShaderProgram>(
+        {{ std::string(RESOURCE_PATH) + "/Shaders/ray_trace_persistent.glsl:COMPUTE"}},
+        "RayTracePersistent"
+    );
+
+    // Wavefront path tracer stages
+    mResources_.loadResource<ShaderProgram>(
+        {{ std::string(RESOURCE_PATH) + "/Shaders/ray_wavefront_generate.glsl:COMPUTE"}},
+        "RayWavefrontGenerate"
+    );
+
+    mResources_.loadResource<ShaderProgram>(
+        {{ std::string(RESOURCE_PATH) + "/Shaders/ray_wavefront_extend.glsl:COMPUTE"}},
+        "RayWavefrontExtend"
+    );
+
+    mResources_.loadResource<ShaderProgram>(
+        {{ std::string(RESOURCE_PATH) + "/Shaders/ray_wavefront_shade.glsl:COMPUTE"}},
+        "RayWavefrontShade"
+    );
+
+    mResources_.loadResource<ShaderProgram>(
+        {{ std::string(RESOURCE_PATH) + "/Shaders/ray_wavefront_compact.glsl:COMPUTE"}},
+        "RayWavefrontCompact"
+    );
+
+    mResources_.loadResource<ShaderProgram>(
+        {{ std::string(RESOURCE_PATH) + "/Shaders/ray_wavefront_reorder.glsl:COMPUTE"}},
+        "RayWavefrontReorder"
+    );
+
+    // GPU radix sort and LBVH builder
+    mResources_.loadResource<ShaderProgram>(
+        {{ std::string(RESOURCE_PATH) + "/Shaders/radix_sort_histogram.glsl:COMPUTE"}},
+        "RadixSortHistogram"
+    );
+
+    mResources_.loadResource<ShaderProgram>(
+        {{ std::string(RESOURCE_PATH) + "/Shaders/radix_sort_scan.glsl:COMPUTE"}},
+        "RadixSortScan"
+    );
+
+    mResources_.loadResource<ShaderProgram>(
+        {{ std::string(RESOURCE_PATH) + "/Shaders/radix_sort_scatter.glsl:COMPUTE"}},
+        "RadixSortScatter"
+    );
+
+    mResources_.loadResource<ShaderProgram>(
+        {{ std::string(RESOURCE_PATH) + "/Shaders/lbvh_scene_bounds.glsl:COMPUTE"}},
+        "LBVHSceneBounds"
+    );
+
+    mResources_.loadResource<ShaderProgram>(
+        {{ std::string(RESOURCE_PATH) + "/Shaders/lbvh_morton.glsl:COMPUTE"}},
+        "LBVHMorton"
+    );
+
+    mResources_.loadResource<ShaderProgram>(
+        {{ std::string(RESOURCE_PATH) + "/Shaders/lbvh_hierarchy.glsl:COMPUTE"}},
+        "LBVHHierarchy"
+    );
+
+    mResources_.loadResource<ShaderProgram>(
+        {{ std::string(RESOURCE_PATH) + "/Shaders/lbvh_node_bounds.glsl:COMPUTE"}},
+        "LBVHNodeBounds"
+    );
 }
 
 Resources& App::getResources() {
     return mResources_;
+}
+
+FrameUniformBuffer& App::getFrameUniforms() {
+    return *mpFrameUniforms_;
 }
\ No newline at end of file
@@ -1,10 +1,12 @@
 #pragma once
 // standard lib
 #include <chrono>
+#include "core/FileWatcher.h"
 #include "core/gui/Window.h"
 #include "core/application/Resources.h"
 #include "core/application/Scene.h"
 #include "core/graphics/Camera.h"
+#include "core/graphics/FrameUniformBuffer.h"
 
 class App {
 public:
@@ -48,18 +50,33 @@ public:
     /** Get application resources */
     Resources& getResources();
 
+    /** Get the camera and time uniforms shared by all scenes and programs */
+    FrameUniformBuffer& getFrameUniforms();
+
 private:
     /** Load/Build the common resources for the scenes in this application */
     void loadResources();
 
+    /** Recompile the shader programs whose files changed and swap in the ones that are done, between two frames */
+    void reloadChangedShaders();
+
     /** Time of last update call */
     std::chrono::steady_clock::time_point mLastTime_;
+
+    /** Time the application was initialized, the frame uniforms count their time from it */
+    std::chrono::steady_clock::time_point mStartTime_;
     /** The window for this application*/
     std::unique_ptr<Window> mpWindow_;
 
     /** Resource for this application that can be shared with child scenes */
     Resources mResources_;
 
+    /** Created once there is a GL context */
+    std::unique_ptr<FrameUniformBuffer> mpFrameUniforms_;
+
+    /** Watches the shader directory, edited shaders are reloaded while the application runs */
+    std::unique_ptr<FileWatcher> mpShaderWatcher_;
+
     int mCurrentSceneIdx_ = 0;
 
     Camera camera;
@@ -1,6 +1,11 @@
 // standard lib
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <thread>
 // third party
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -25,6 +30,64 @@ FileData Resources::loadFileToMemory(const std::string& filePath) {
     return {std::move(buffer), static_cast<std::size_t>(fileSize)}; 
 }
 
+std::string Resources::loadShaderSource(const std::string& filePath, const ShaderDefines& defines,
+                                        std::unordered_set<std::string>* pSourceFiles) {
+    std::unordered_set<std::string> includedFiles;
+    std::string source = expandShaderIncludes(filePath, includedFiles);
+    if (pSourceFiles != nullptr) {
+        for (const std::string& includedFile : includedFiles) {
+            pSourceFiles->insert(std::filesystem::path(includedFile).lexically_normal().string());
+        }
+    }
+    if (defines.empty()) {
+        return source;
+    }
+
+    std::string defineLines;
+    for (const auto& [name, value] : defines) {
+        defineLines += "#define " + name + " " + value + "\n";
+    }
+    // Nothing but comments may come before #version
+    const size_t versionStart = source.find("#version");
+    const size_t versionEnd = (versionStart == std::string::npos) ? std::string::npos : source.find('\n', versionStart);
+    if (versionEnd == std::string::npos) {
+        throw std::runtime_error("No #version line to add defines after in " + filePath);
+    }
+    source.insert(versionEnd + 1, defineLines);
+    return source;
+}
+
+std::string Resources::expandShaderIncludes(const std::string& filePath, std::unordered_set<std::string>& includedFiles) {
+    includedFiles.insert(filePath);
+
+    FileData fileData = loadFileToMemory(filePath);
+    std::istringstream source(std::string(reinterpret_cast<char*>(fileData.data.get()), fileData.size));
+    const size_t lastSlash = filePath.find_last_of("/\\");
+    const std::string directory = (lastSlash == std::string::npos) ? "" : filePath.substr(0, lastSlash + 1);
+
+    std::string expanded;
+    std::string line;
+    while (std::getline(source, line)) {
+        const size_t directiveStart = line.find_first_not_of(" \t");
+        if (directiveStart == std::string::npos || line.compare(directiveStart, 8, "#include") != 0) {
+            expanded += line;
+            expanded += '\n';
+            continue;
+        }
+
+        const size_t nameStart = line.find('"', directiveStart);
+        const size_t nameEnd = (nameStart == std::string::npos) ? std::string::npos : line.find('"', nameStart + 1);
+        if (nameEnd == std::string::npos) {
+            throw std::runtime_error("Malformed include in " + filePath + ": " + line);
+        }
+        const std::string includePath = directory + line.substr(nameStart + 1, nameEnd - nameStart - 1);
+        if (includedFiles.count(includePath) == 0) {
+            expanded += expandShaderIncludes(includePath, includedFiles);
+        }
+    }
+    return expanded;
+}
+
 ImageData fileDataToImageData(const FileData& imageFile) {
     ImageData imageData;
     imageData.pixels = stbi_load_from_memory(
@@ -46,50 +109,221 @@ ImageData fileDataToImageData(const FileData& imageFile) {
 }
 
 template<typename T>
-void Resources::loadResource(const std::vector<std::string>& resourceInfo, const std::string& resourceName) {
+void Resources::loadResource(const std::vector<std::string>& resourceInfo, const std::string& resourceName,
+                             const ShaderDefines& defines) {
     if constexpr(std::is_same_v<T, Texture>) {
         FileData fileData = loadFileToMemory(resourceInfo[0]);
         ImageData imageData = fileDataToImageData(fileData);
         auto texture = std::make_unique<Texture>(imageData);
         mTextures_[resourceName] = std::move(texture);
     } else if constexpr (std::is_same_v<T, ShaderProgram>) {
-        auto shaderProgram = std::make_unique<ShaderProgram>();
-
-        for (const auto& eachPath: resourceInfo) {
-            const size_t lastColon =  eachPath.find_last_of(':');
-            const std::string shaderPath = eachPath.substr(0, lastColon);
-            const std::string shaderType = eachPath.substr(lastColon + 1);
-
-            FileData fileData = loadFileToMemory(shaderPath);
-
-            ShaderProgram::ShaderCreateInfo::Type shaderTypeEnum;
-
-            if (shaderType == "VERTEX") {
-                shaderTypeEnum = ShaderProgram::ShaderCreateInfo::Type::VERTEX;
-            } else if (shaderType == "TESSELLATION_CONTROL") {
-                shaderTypeEnum = ShaderProgram::ShaderCreateInfo::Type::TESSELLATION_CONTROL;
-            } else if (shaderType == "TESSELLATION_EVALUATION") {
-                shaderTypeEnum = ShaderProgram::ShaderCreateInfo::Type::TESSELLATION_EVALUATION;
-            } else if (shaderType == "GEOMETRY") {
-                shaderTypeEnum = ShaderProgram::ShaderCreateInfo::Type::GEOMETRY;
-            } else if (shaderType == "FRAGMENT") {
-                shaderTypeEnum = ShaderProgram::ShaderCreateInfo::Type::FRAGMENT;
-            } else if (shaderType == "COMPUTE") {
-                shaderTypeEnum = ShaderProgram::ShaderCreateInfo::Type::COMPUTE;
-            } else {
-                throw std::runtime_error("Invalid shader path suffix");
-            }
+        // A program replaced while its link or reload is pending would be finished after it is gone
+        if (mShaders_.count(resourceName) != 0) {
+            finishShaderLoads();
+            std::erase_if(mShaderReloads_, [&](const ShaderReload& reload) { return reload.name == resourceName; });
+        }
+        ShaderSource source = {resourceInfo, defines};
+        std::optional<uint64_t> cacheKey;
+        mShaders_[resourceName] = createShaderProgram(resourceInfo, defines, cacheKey, &source.files);
+        mPendingPrograms_.push_back({resourceName, mShaders_[resourceName].get(), cacheKey});
+        mShaderSources_[resourceName] = std::move(source);
+    }
+}
+
+std::unique_ptr<ShaderProgram> Resources::createShaderProgram(const std::vector<std::string>& resourceInfo,
+                                                              const ShaderDefines& defines,
+                                                              std::optional<uint64_t>& cacheKey,
+                                                              std::unordered_set<std::string>* pSourceFiles) {
+    auto shaderProgram = std::make_unique<ShaderProgram>();
+
+    // The expanded sources are read first, they are part of the program binary cache key
+    std::vector<std::pair<std::string, std::string>> stageSources;
+    for (const auto& eachPath: resourceInfo) {
+        const size_t lastColon =  eachPath.find_last_of(':');
+        stageSources.emplace_back(eachPath, loadShaderSource(eachPath.substr(0, lastColon), defines, pSourceFiles));
+    }
+
+    cacheKey.reset();
+    if (mpProgramBinaryCache_ != nullptr) {
+        std::string defineList;
+        for (const auto& [name, value] : defines) {
+            defineList += name + "=" + value + "\n";
+        }
+        const uint64_t key = mpProgramBinaryCache_->makeKey(stageSources, defineList);
+        if (mpProgramBinaryCache_->load(key, *shaderProgram)) {
+            return shaderProgram;
+        }
+        cacheKey = key;
+    }
+
+    for (const auto& [eachPath, shaderSource]: stageSources) {
+        const std::string shaderType = eachPath.substr(eachPath.find_last_of(':') + 1);
+
+        ShaderProgram::ShaderCreateInfo::Type shaderTypeEnum;
+
+        if (shaderType == "VERTEX") {
+            shaderTypeEnum = ShaderProgram::ShaderCreateInfo::Type::VERTEX;
+        } else if (shaderType == "TESSELLATION_CONTROL") {
+            shaderTypeEnum = ShaderProgram::ShaderCreateInfo::Type::TESSELLATION_CONTROL;
+        } else if (shaderType == "TESSELLATION_EVALUATION") {
+            shaderTypeEnum = ShaderProgram::ShaderCreateInfo::Type::TESSELLATION_EVALUATION;
+        } else if (shaderType == "GEOMETRY") {
+            shaderTypeEnum = ShaderProgram::ShaderCreateInfo::Type::GEOMETRY;
+        } else if (shaderType == "FRAGMENT") {
+            shaderTypeEnum = ShaderProgram::ShaderCreateInfo::Type::FRAGMENT;
+        } else if (shaderType == "COMPUTE") {
+            shaderTypeEnum = ShaderProgram::ShaderCreateInfo::Type::COMPUTE;
+        } else {
+            throw std::runtime_error("Invalid shader path suffix");
+        }
+
+        shaderProgram->addShader({
+            shaderTypeEnum,
+            shaderSource.c_str(),
+            shaderSource.size()
+        });
+    }
+
+    shaderProgram->linkProgram();
+    return shaderProgram;
+}
+
+std::string Resources::finishShaderProgram(ShaderProgram& program, const std::optional<uint64_t>& cacheKey) {
+    const std::string log = program.finishLink();
+    if (log.empty() && cacheKey.has_value() && mpProgramBinaryCache_ != nullptr) {
+        // A rejected binary is replaced by the freshly linked program
+        mpProgramBinaryCache_->save(*cacheKey, program);
+    }
+    return log;
+}
+
+ShaderProgram* Resources::getShaderVariant(const std::string& resourceName, const ShaderDefines& defines) {
+    if (defines.empty()) {
+        return getResource<ShaderProgram>(resourceName);
+    }
+
+    std::string variantKey = resourceName;
+    for (const auto& [name, value] : defines) {
+        variantKey += " " + name + "=" + value;
+    }
+    auto it = mShaderVariants_.find(variantKey);
+    if (it != mShaderVariants_.end()) {
+        return it->second.get();
+    }
 
-            shaderProgram->addShader({
-                shaderTypeEnum,
-                std::string(reinterpret_cast<char*>(fileData.data.get()), fileData.size).c_str(),
-                fileData.size
-            });
+    auto sourceIt = mShaderSources_.find(resourceName);
+    if (sourceIt == mShaderSources_.end()) {
+        throw std::runtime_error("No shader program " + resourceName + " to specialize");
+    }
+    // The variant's defines take precedence over the ones the program was loaded with
+    ShaderDefines variantDefines = defines;
+    variantDefines.insert(sourceIt->second.defines.begin(), sourceIt->second.defines.end());
+    std::optional<uint64_t> cacheKey;
+    auto variant = createShaderProgram(sourceIt->second.resourceInfo, variantDefines, cacheKey);
+    ShaderProgram* pVariant = variant.get();
+    mShaderVariants_[variantKey] = std::move(variant);
+    sourceIt->second.variants[variantKey] = variantDefines;
+    mPendingPrograms_.push_back({variantKey, pVariant, cacheKey});
+    finishShaderLoads();
+    return pVariant;
+}
+
+void Resources::enableProgramBinaryCache(const std::string& cacheDirectory) {
+    mpProgramBinaryCache_ = std::make_unique<ProgramBinaryCache>(cacheDirectory);
+    if (!mpProgramBinaryCache_->isEnabled()) {
+        std::cout << "No program binary formats, shaders are compiled on every start" << std::endl;
+    }
+}
+
+void Resources::finishShaderLoads() {
+    std::string errors;
+    while (!mPendingPrograms_.empty()) {
+        // Programs are finished in the order the driver completes them
+        auto completed = std::find_if(mPendingPrograms_.begin(), mPendingPrograms_.end(),
+                                      [](const PendingProgram& pending) { return pending.pProgram->isLinkComplete(); });
+        if (completed == mPendingPrograms_.end()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
         }
 
-        shaderProgram->linkProgram();
-        mShaders_[resourceName] = std::move(shaderProgram);
+        const std::string log = finishShaderProgram(*completed->pProgram, completed->cacheKey);
+        if (!log.empty()) {
+            errors += "Shader program " + completed->name + " failed to link:\n" + log + "\n";
+        }
+        mPendingPrograms_.erase(completed);
+    }
+    if (!errors.empty()) {
+        std::cout << errors << std::flush;
+    }
+}
+
+void Resources::reloadShaders(const std::vector<std::string>& changedFiles) {
+    for (auto& [name, source] : mShaderSources_) {
+        const bool changed = std::any_of(changedFiles.begin(), changedFiles.end(), [&](const std::string& filePath) {
+            return source.files.count(filePath) != 0;
+        });
+        if (!changed) {
+            continue;
+        }
+        // The includes may have changed as well, the files are collected again
+        startShaderReload(name, source, source.defines, mShaders_[name].get(), &source.files);
+        for (const auto& [variantKey, variantDefines] : source.variants) {
+            startShaderReload(variantKey, source, variantDefines, mShaderVariants_[variantKey].get(), nullptr);
+        }
+    }
+}
+
+void Resources::startShaderReload(const std::string& name, const ShaderSource& source, const ShaderDefines& defines,
+                                  ShaderProgram* pTarget, std::unordered_set<std::string>* pSourceFiles) {
+    // Editors can write a file several times, only the last version is compiled to the end
+    std::erase_if(mShaderReloads_, [&](const ShaderReload& reload) { return reload.name == name; });
+
+    std::optional<uint64_t> cacheKey;
+    std::unordered_set<std::string> sourceFiles;
+    std::unique_ptr<ShaderProgram> pProgram;
+    try {
+        pProgram = createShaderProgram(source.resourceInfo, defines, cacheKey, &sourceFiles);
+    } catch (const std::runtime_error& error) {
+        // E.g. an include that doesn't exist yet, the old program stays
+        std::cout << "Shader program " << name << " failed to reload, keeping the old one: " << error.what()
+                  << std::endl;
+        return;
+    }
+    if (pSourceFiles != nullptr) {
+        *pSourceFiles = std::move(sourceFiles);
+    }
+    mShaderReloads_.push_back({name, std::move(pProgram), pTarget, cacheKey});
+}
+
+std::vector<std::string> Resources::swapReloadedShaders() {
+    std::vector<std::string> swappedNames;
+    std::string errors;
+    for (auto it = mShaderReloads_.begin(); it != mShaderReloads_.end();) {
+        if (!it->pProgram->isLinkComplete()) {
+            ++it;
+            continue;
+        }
+        std::string log = finishShaderProgram(*it->pProgram, it->cacheKey);
+        if (log.empty()) {
+            // Scenes resolve their uniform handles again with the types they used before, which would throw
+            const std::string uniformName = it->pProgram->findUniformTypeMismatch(*it->pTarget);
+            if (!uniformName.empty()) {
+                log = "Uniform " + uniformName + " changed its type\n";
+            }
+        }
+        if (log.empty()) {
+            // The old program is left in the reload and deleted with it
+            it->pTarget->swap(*it->pProgram);
+            swappedNames.push_back(it->name);
+        } else {
+            errors += "Shader program " + it->name + " failed to reload, keeping the old one:\n" + log + "\n";
+        }
+        it = mShaderReloads_.erase(it);
+    }
+    if (!errors.empty()) {
+        std::cout << errors << std::flush;
     }
+    return swappedNames;
 }
 
 template<typename T>
@@ -100,6 +334,7 @@ T* Resources::getResource(const std::string& resourceName) {
             return it->second.get();
         }
     } else if constexpr (std::is_same_v<T, ShaderProgram>) {
+        finishShaderLoads();
         auto it = mShaders_.find(resourceName);
         if (it != mShaders_.end()) {
             return it->second.get();
@@ -111,8 +346,10 @@ T* Resources::getResource(const std::string& resourceName) {
 }
 
 // Explicit instantiate template for expected types
-template void Resources::loadResource<Texture>(const std::vector<std::string>& resourceInfo, const std::string& resourceName);
-template void Resources::loadResource<ShaderProgram>(const std::vector<std::string>& resourceInfo, const std::string& resourceName);
+template void Resources::loadResource<Texture>(const std::vector<std::string>& resourceInfo, const std::string& resourceName,
+                                               const ShaderDefines& defines);
+template void Resources::loadResource<ShaderProgram>(const std::vector<std::string>& resourceInfo, const std::string& resourceName,
+                                                     const ShaderDefines& defines);
 
 template Texture* Resources::getResource(const std::string& resourceName);
 template ShaderProgram* Resources::getResource(const std::string& resourceName);
@@ -1,24 +1,146 @@
 #pragma once
 // standard lib
+#include <map>
+#include <memory>
 #include <string>
 #include <optional>
+#include <unordered_set>
 // Project
+#include "core/graphics/ProgramBinaryCache.h"
 #include "core/graphics/ShaderProgram.h"
 #include "core/graphics/Texture.h"
 #include "core/Utils.h"
 
+/** #define names and values injected after the #version line of every stage, ordered so equal sets give equal keys */
+using ShaderDefines = std::map<std::string, std::string>;
 
 class Resources {
 public:
     std::unordered_map<std::string, std::unique_ptr<ShaderProgram>> mShaders_;
 
+    /** Specialized variants of the loaded shader programs, keyed by program name and defines */
+    std::unordered_map<std::string, std::unique_ptr<ShaderProgram>> mShaderVariants_;
+
     std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures_;
 
     FileData loadFileToMemory(const std::string& filePath);
 
+    /**
+     * Read a shader file and splice in the files named by its #include "file" lines, resolved relative to the
+     * including file. Every file is spliced in once, so files can include shared declarations independently
+     * @param filePath Path of the shader file
+     * @param defines Defines added after the #version line
+     * @param pSourceFiles Optional set the lexically normalized paths of the file and its includes are added to
+     * @return Source with the includes expanded
+     */
+    std::string loadShaderSource(const std::string& filePath, const ShaderDefines& defines = {},
+                                 std::unordered_set<std::string>* pSourceFiles = nullptr);
+
+    /**
+     * Load a resource
+     * @param resourceInfo Image path of a Texture, "path:STAGE" per stage of a ShaderProgram
+     * @param resourceName Name to get the resource by
+     * @param defines Defines the stages of a ShaderProgram are compiled with, variants add their own on top
+     */
     template<typename T>
-    void loadResource(const std::vector<std::string>& resourceInfo, const std::string& resourceName);
+    void loadResource(const std::vector<std::string>& resourceInfo, const std::string& resourceName,
+                      const ShaderDefines& defines = {});
 
     template<typename T>
     T* getResource(const std::string& resourceName);
+
+    /**
+     * Get a loaded shader program compiled with additional defines, e.g. constants that would otherwise be
+     * uniforms so the compiler can fold them. Every combination is compiled the first time it is asked for and
+     * cached, so it can be picked every frame
+     * @param resourceName Name the program was loaded with
+     * @param defines Defines added to the ones the program was loaded with, the program itself if empty
+     * @return The variant, owned by Resources
+     */
+    ShaderProgram* getShaderVariant(const std::string& resourceName, const ShaderDefines& defines);
+
+    /**
+     * Keep linked programs on disk and load them from there on later starts instead of compiling. Needs a
+     * current GL context, programs loaded before are not cached
+     * @param cacheDirectory Directory of the program binaries
+     */
+    void enableProgramBinaryCache(const std::string& cacheDirectory);
+
+    /**
+     * Wait for the programs still compiling and print the logs of the ones that failed, all at once. Loading a
+     * program only starts its compile and link, so the driver can build all of them at the same time; getting
+     * a program finishes the loads as well
+     */
+    void finishShaderLoads();
+
+    /**
+     * Start compiling again every program and variant that reads one of the changed files, includes too. The
+     * old programs stay in use until swapReloadedShaders replaces them. A program that fails to compile, or
+     * changes the type of a uniform it shares with the old program, is kept
+     * @param changedFiles Lexically normalized paths of the changed files, as FileWatcher reports them
+     */
+    void reloadShaders(const std::vector<std::string>& changedFiles);
+
+    /**
+     * Replace the programs whose recompile has finished, without waiting for the others. Call between two frames.
+     * Pointers to the programs stay valid, handles from ShaderProgram::getUniform have to be resolved again
+     * @return Names of the replaced programs and variants
+     */
+    std::vector<std::string> swapReloadedShaders();
+
+private:
+    /** Stage paths and defines of a loaded shader program, to compile its variants and reload it */
+    struct ShaderSource {
+        std::vector<std::string> resourceInfo;
+        ShaderDefines defines;
+        /** Lexically normalized paths of the stage files and their includes */
+        std::unordered_set<std::string> files;
+        /** Defines of every variant compiled from the program, keyed by variant name */
+        std::map<std::string, ShaderDefines> variants;
+    };
+    std::unordered_map<std::string, ShaderSource> mShaderSources_;
+
+    /** Program whose link was started but not checked yet */
+    struct PendingProgram {
+        std::string name;
+        ShaderProgram* pProgram;
+        /** Program binary cache key to save the program under once it is linked, empty if it is not saved */
+        std::optional<uint64_t> cacheKey;
+    };
+    std::vector<PendingProgram> mPendingPrograms_;
+
+    /** Program compiled again after its files changed, waiting to replace the target */
+    struct ShaderReload {
+        std::string name;
+        std::unique_ptr<ShaderProgram> pProgram;
+        ShaderProgram* pTarget;
+        std::optional<uint64_t> cacheKey;
+    };
+    std::vector<ShaderReload> mShaderReloads_;
+
+    /** Disabled until enableProgramBinaryCache */
+    std::unique_ptr<ProgramBinaryCache> mpProgramBinaryCache_;
+
+    /**
+     * Start compiling and linking the "path:STAGE" stages of a program, or load it from the program binary cache
+     * @param cacheKey Set to the key to save the program under once it is linked, empty if loaded from the cache
+     * @param pSourceFiles Optional set the files read are added to
+     */
+    std::unique_ptr<ShaderProgram> createShaderProgram(const std::vector<std::string>& resourceInfo,
+                                                       const ShaderDefines& defines,
+                                                       std::optional<uint64_t>& cacheKey,
+                                                       std::unordered_set<std::string>* pSourceFiles = nullptr);
+
+    /**
+     * Wait for the link of a program created by createShaderProgram and save it to the program binary cache
+     * @return Compile and link logs if the program failed to link, empty otherwise
+     */
+    std::string finishShaderProgram(ShaderProgram& program, const std::optional<uint64_t>& cacheKey);
+
+    /** Start the recompile of a program or variant, replacing a reload of it that is still compiling */
+    void startShaderReload(const std::string& name, const ShaderSource& source, const ShaderDefines& defines,
+                           ShaderProgram* pTarget, std::unordered_set<std::string>* pSourceFiles);
+
+    /** Expand the includes of one file, skipping files already in includedFiles */
+    std::string expandShaderIncludes(const std::string& filePath, std::unordered_set<std::string>& includedFiles);
 };
@@ -12,4 +12,6 @@ void Scene::onMousePress(const MouseEvent& mouseEvent) {}
 
 void Scene::onMouseRelease(const MouseEvent& mouseEvent) {}
 
-void Scene::onMouseWheel(const MouseEvent& mouseEvent) {}
\ No newline at end of file
+void Scene::onMouseWheel(const MouseEvent& mouseEvent) {}
+
+void Scene::onShadersReloaded(const std::vector<std::string>& programNames) {}
\ No newline at end of file
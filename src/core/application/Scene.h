@@ -1,4 +1,8 @@
 #pragma once
+// standard lib
+#include <string>
+#include <vector>
+// project
 #include "core/application/InputHandler.h"
 
 class App;
@@ -23,6 +27,13 @@ public:
 
     virtual void onMouseWheel(const MouseEvent& mouseEvent);
 
+    /**
+     * Called on every scene after shader programs were recompiled and replaced in place. Pointers to the programs
+     * stay valid, uniform handles have to be resolved again
+     * @param programNames Names of the replaced programs and variants
+     */
+    virtual void onShadersReloaded(const std::vector<std::string>& programNames);
+
 
 protected:
     App& mParentApp_;
@@ -0,0 +1,83 @@
+// standard lib
+#include <cstring>
+// third party
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GL/gl.h>
+// project
+#include "core/graphics/FrameUniformBuffer.h"
+
+
+FrameUniformBuffer::FrameUniformBuffer() {
+    GLint alignment = 1;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    mSlotSize_ = (sizeof(FrameUniformData) + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &mBuffer_);
+    glBindBuffer(GL_UNIFORM_BUFFER, mBuffer_);
+    const GLsizeiptr ringSize = static_cast<GLsizeiptr>(mSlotSize_ * kRingSize);
+    if (GLEW_ARB_buffer_storage) {
+        // Coherent, so a write is visible to commands issued after it without a flush
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, ringSize, nullptr, flags);
+        mpMappedRing_ = static_cast<unsigned char*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, ringSize, flags));
+    } else {
+        glBufferData(GL_UNIFORM_BUFFER, ringSize, nullptr, GL_DYNAMIC_DRAW);
+    }
+}
+
+FrameUniformBuffer::~FrameUniformBuffer() {
+    for (void* fence : mSlotFences_) {
+        if (fence != nullptr) {
+            glDeleteSync(static_cast<GLsync>(fence));
+        }
+    }
+    if (mpMappedRing_ != nullptr) {
+        glBindBuffer(GL_UNIFORM_BUFFER, mBuffer_);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+    }
+    glDeleteBuffers(1, &mBuffer_);
+}
+
+void FrameUniformBuffer::beginFrame(float time) {
+    mSlot_ = (mSlot_ + 1) % kRingSize;
+    ++mData_.frameIndex;
+    mData_.time = time;
+
+    // The slot was last read kRingSize frames ago, which the GPU has normally finished long since
+    GLsync fence = static_cast<GLsync>(mSlotFences_[mSlot_]);
+    if (fence != nullptr) {
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(fence);
+        mSlotFences_[mSlot_] = nullptr;
+    }
+}
+
+void FrameUniformBuffer::setCamera(const glm::mat4& view, const glm::mat4& projection) {
+    mData_.viewMatrix = view;
+    mData_.projMatrix = projection;
+    mData_.invViewMatrix = glm::inverse(view);
+    mData_.invProjMatrix = glm::inverse(projection);
+    mData_.viewProjMatrix = projection * view;
+    mData_.cameraPosition = glm::vec3(mData_.invViewMatrix[3]);
+
+    const GLintptr offset = static_cast<GLintptr>(mSlot_ * mSlotSize_);
+    if (mpMappedRing_ != nullptr) {
+        std::memcpy(mpMappedRing_ + offset, &mData_, sizeof(FrameUniformData));
+    } else {
+        glBindBuffer(GL_UNIFORM_BUFFER, mBuffer_);
+        glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(FrameUniformData), &mData_);
+    }
+    glBindBufferRange(GL_UNIFORM_BUFFER, kBinding, mBuffer_, offset, sizeof(FrameUniformData));
+}
+
+void FrameUniformBuffer::endFrame() {
+    if (mSlotFences_[mSlot_] != nullptr) {
+        glDeleteSync(static_cast<GLsync>(mSlotFences_[mSlot_]));
+    }
+    mSlotFences_[mSlot_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+const FrameUniformData& FrameUniformBuffer::getData() const {
+    return mData_;
+}
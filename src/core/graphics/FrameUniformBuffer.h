@@ -0,0 +1,79 @@
+#pragma once
+// standard lib
+#include <cstddef>
+#include <cstdint>
+// third party
+#include <glm/glm.hpp>
+
+/** Camera and time of a frame, laid out like the std140 FrameUniforms block of frame_uniforms.glsl */
+struct FrameUniformData {
+    glm::mat4 viewMatrix;
+    glm::mat4 projMatrix;
+    glm::mat4 invViewMatrix;
+    glm::mat4 invProjMatrix;
+    glm::mat4 viewProjMatrix;
+    /** World position of the camera, packed with frameIndex into one std140 slot */
+    glm::vec3 cameraPosition;
+    uint32_t frameIndex;
+    /** Seconds since the application started */
+    float time;
+    uint32_t padding[3];
+};
+static_assert(sizeof(FrameUniformData) == 352, "FrameUniformData must match the std140 FrameUniforms block");
+
+/**
+ * Uniform buffer with the camera and time of the frame, bound at kBinding for every shader that includes
+ * frame_uniforms.glsl. The buffer is a ring of kRingSize slots that stays mapped: every frame writes the next slot
+ * while the GPU may still read the ones of the frames before, a fence per slot keeps a write from overtaking
+ * the GPU. Without ARB_buffer_storage the slots are written with glBufferSubData instead
+ */
+class FrameUniformBuffer {
+public:
+    /** Uniform buffer binding of the FrameUniforms block */
+    static constexpr unsigned int kBinding = 0;
+
+    /** Frames in flight, one slot each */
+    static constexpr int kRingSize = 3;
+
+    FrameUniformBuffer();
+
+    ~FrameUniformBuffer();
+
+    FrameUniformBuffer(const FrameUniformBuffer&) = delete;
+    FrameUniformBuffer& operator=(const FrameUniformBuffer&) = delete;
+
+    /**
+     * Start a frame on the next slot, waiting in the rare case the GPU still reads it
+     * @param time Seconds since the application started
+     */
+    void beginFrame(float time);
+
+    /**
+     * Write the camera of the frame and bind the slot. Call once per frame, before the commands that read it
+     * @param view Camera view matrix
+     * @param projection Camera projection matrix
+     */
+    void setCamera(const glm::mat4& view, const glm::mat4& projection);
+
+    /** Fence the slot after the commands of the frame */
+    void endFrame();
+
+    /** Data of the current frame, with the inverses already computed */
+    const FrameUniformData& getData() const;
+
+private:
+    unsigned int mBuffer_ = 0;
+
+    /** Slot size rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT */
+    std::size_t mSlotSize_ = 0;
+
+    /** Persistently mapped ring, nullptr without ARB_buffer_storage */
+    unsigned char* mpMappedRing_ = nullptr;
+
+    int mSlot_ = 0;
+
+    /** GLsync of the last frame that used every slot */
+    void* mSlotFences_[kRingSize] = {};
+
+    FrameUniformData mData_ = {};
+};
@@ -0,0 +1,120 @@
+// standard lib
+#include <utility>
+// third party
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GL/gl.h>
+// project
+#include "core/graphics/GpuRadixSort.h"
+
+
+GpuRadixSort::GpuRadixSort(Resources& resources) {
+    mpHistogramProgram_ = resources.getResource<ShaderProgram>("RadixSortHistogram");
+    mpScanProgram_ = resources.getResource<ShaderProgram>("RadixSortScan");
+    mpScatterProgram_ = resources.getResource<ShaderProgram>("RadixSortScatter");
+
+    glGenBuffers(1, &mKeysScratchSSBO_);
+    glGenBuffers(1, &mValuesScratchSSBO_);
+    glGenBuffers(1, &mBlockSumsSSBO_);
+
+    glGenBuffers(1, &mCountSSBO_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCountSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+}
+
+GpuRadixSort::~GpuRadixSort() {
+    glDeleteBuffers(1, &mKeysScratchSSBO_);
+    glDeleteBuffers(1, &mValuesScratchSSBO_);
+    glDeleteBuffers(1, &mBlockSumsSSBO_);
+    glDeleteBuffers(1, &mCountSSBO_);
+}
+
+void GpuRadixSort::sort(unsigned int keySSBO, unsigned int valueSSBO, uint32_t count, uint32_t keyBits) {
+    if (count <= 1) {
+        return;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCountSSBO_);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(count), &count);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 29, mCountSSBO_); // Bind to binding=29
+    sortPasses(keySSBO, valueSSBO, 0, count, keyBits);
+}
+
+void GpuRadixSort::sortIndirect(unsigned int keySSBO, unsigned int valueSSBO, unsigned int countSSBO, uint32_t countOffset,
+                                uint32_t maxCount, uint32_t keyBits) {
+    if (maxCount <= 1) {
+        return;
+    }
+    // Indexed instead of bound at the offset, which would have to meet the SSBO offset alignment
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 29, countSSBO); // Bind to binding=29
+    sortPasses(keySSBO, valueSSBO, countOffset / sizeof(uint32_t), maxCount, keyBits);
+}
+
+void GpuRadixSort::sortPasses(unsigned int keySSBO, unsigned int valueSSBO, uint32_t countIndex, uint32_t maxCount, uint32_t keyBits) {
+    reserve(maxCount);
+
+    const uint32_t blockCount = (maxCount + kBlockSize - 1) / kBlockSize;
+    const uint32_t passCount = (keyBits + kBitsPerPass - 1) / kBitsPerPass;
+
+    unsigned int keysIn = keySSBO;
+    unsigned int valuesIn = valueSSBO;
+    unsigned int keysOut = mKeysScratchSSBO_;
+    unsigned int valuesOut = mValuesScratchSSBO_;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 28, mBlockSumsSSBO_); // Bind to binding=28
+
+    for (uint32_t pass = 0; pass < passCount; ++pass) {
+        const uint32_t bitOffset = pass * kBitsPerPass;
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 24, keysIn);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 25, valuesIn);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 26, keysOut);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 27, valuesOut);
+
+        mpHistogramProgram_->bind();
+        mpHistogramProgram_->setUInt("countIndex", countIndex);
+        mpHistogramProgram_->setUInt("numBlocks", blockCount);
+        mpHistogramProgram_->setUInt("bitOffset", bitOffset);
+        glDispatchCompute(blockCount, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        mpScanProgram_->bind();
+        mpScanProgram_->setUInt("countIndex", countIndex);
+        mpScanProgram_->setUInt("numBlocks", blockCount);
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        mpScatterProgram_->bind();
+        mpScatterProgram_->setUInt("countIndex", countIndex);
+        mpScatterProgram_->setUInt("numBlocks", blockCount);
+        mpScatterProgram_->setUInt("bitOffset", bitOffset);
+        glDispatchCompute(blockCount, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        std::swap(keysIn, keysOut);
+        std::swap(valuesIn, valuesOut);
+    }
+
+    // After an odd number of passes the result sits in the scratch buffers
+    if (keysIn != keySSBO) {
+        glBindBuffer(GL_COPY_READ_BUFFER, keysIn);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, keySSBO);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, maxCount * sizeof(uint32_t));
+        glBindBuffer(GL_COPY_READ_BUFFER, valuesIn);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, valueSSBO);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, maxCount * sizeof(uint32_t));
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+}
+
+void GpuRadixSort::reserve(uint32_t count) {
+    if (count <= mCapacity_) {
+        return;
+    }
+    mCapacity_ = count;
+    const uint32_t blockCount = (count + kBlockSize - 1) / kBlockSize;
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mKeysScratchSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mValuesScratchSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBlockSumsSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, blockCount * (1u << kBitsPerPass) * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+}
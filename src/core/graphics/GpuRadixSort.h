@@ -0,0 +1,72 @@
+#pragma once
+// standard lib
+#include <cstdint>
+// project
+#include "core/application/Resources.h"
+
+/**
+ * Stable least significant digit radix sort of uint key/value pairs in compute shaders. Every pass sorts 4 bits
+ * with a histogram, a scan and a scatter dispatch, ping-ponging with internal scratch buffers. The sort uses
+ * bindings 24 to 29 only, so the buffers other passes left bound stay in place
+ */
+class GpuRadixSort {
+public:
+    /**
+     * Constructor
+     * @param resources Resources holding the RadixSortHistogram, RadixSortScan and RadixSortScatter programs
+     */
+    explicit GpuRadixSort(Resources& resources);
+
+    ~GpuRadixSort();
+
+    GpuRadixSort(const GpuRadixSort&) = delete;
+    GpuRadixSort& operator=(const GpuRadixSort&) = delete;
+
+    /**
+     * Sort the pairs in place by key, ascending
+     * @param keySSBO Buffer with count uint keys
+     * @param valueSSBO Buffer with count uint values, moved along with their keys
+     * @param count Number of pairs
+     * @param keyBits Number of low key bits to sort by, higher bits are ignored
+     */
+    void sort(unsigned int keySSBO, unsigned int valueSSBO, uint32_t count, uint32_t keyBits = 32);
+
+    /**
+     * Sort pairs whose count is only known on the GPU, without reading it back. Every pass is dispatched for
+     * maxCount pairs and the blocks past the count leave right away
+     * @param keySSBO Buffer with at least maxCount uint keys
+     * @param valueSSBO Buffer with at least maxCount uint values, moved along with their keys
+     * @param countSSBO Buffer holding the number of pairs
+     * @param countOffset Byte offset of the count in countSSBO, a multiple of 4
+     * @param maxCount Upper bound of the count
+     * @param keyBits Number of low key bits to sort by, higher bits are ignored
+     */
+    void sortIndirect(unsigned int keySSBO, unsigned int valueSSBO, unsigned int countSSBO, uint32_t countOffset,
+                      uint32_t maxCount, uint32_t keyBits = 32);
+
+    /** Elements sorted per workgroup */
+    static constexpr uint32_t kBlockSize = 256;
+    /** Bits sorted per pass */
+    static constexpr uint32_t kBitsPerPass = 4;
+
+private:
+    /** Grow the scratch buffers to hold count pairs */
+    void reserve(uint32_t count);
+
+    /** Run the passes over maxCount pairs, the actual count is read from the buffer bound to binding 29 */
+    void sortPasses(unsigned int keySSBO, unsigned int valueSSBO, uint32_t countIndex, uint32_t maxCount, uint32_t keyBits);
+
+    ShaderProgram* mpHistogramProgram_ = nullptr;
+    ShaderProgram* mpScanProgram_ = nullptr;
+    ShaderProgram* mpScatterProgram_ = nullptr;
+
+    /** Ping-pong targets of the odd passes */
+    unsigned int mKeysScratchSSBO_ = 0;
+    unsigned int mValuesScratchSSBO_ = 0;
+    /** Per block digit counts, scanned in place into scatter offsets */
+    unsigned int mBlockSumsSSBO_ = 0;
+    /** Count of the pairs passed to sort */
+    unsigned int mCountSSBO_ = 0;
+
+    uint32_t mCapacity_ = 0;
+};
@@ -0,0 +1,59 @@
+// third party
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GL/gl.h>
+// project
+#include "core/graphics/GpuTimer.h"
+
+
+GpuTimer::GpuTimer() {
+    glGenQueries(kQueryCount * 2, &mQueries_[0][0]);
+}
+
+GpuTimer::~GpuTimer() {
+    glDeleteQueries(kQueryCount * 2, &mQueries_[0][0]);
+}
+
+void GpuTimer::begin() {
+    // A query can't be reused before its result is read, drop the measurement rather than stall
+    if (mPendingQueries_ == kQueryCount) {
+        return;
+    }
+    glQueryCounter(mQueries_[mNextQuery_][0], GL_TIMESTAMP);
+    mActive_ = true;
+}
+
+void GpuTimer::end() {
+    if (!mActive_) {
+        return;
+    }
+    glQueryCounter(mQueries_[mNextQuery_][1], GL_TIMESTAMP);
+    mActive_ = false;
+    mNextQuery_ = (mNextQuery_ + 1) % kQueryCount;
+    ++mPendingQueries_;
+}
+
+bool GpuTimer::update() {
+    bool updated = false;
+    while (mPendingQueries_ > 0) {
+        const GLuint* queries = mQueries_[(mNextQuery_ - mPendingQueries_ + kQueryCount) % kQueryCount];
+        // Timestamps complete in order, the end being available covers the start
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == GL_FALSE) {
+            break;
+        }
+        GLuint64 start = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &end);
+        mMilliseconds_ = static_cast<float>(end - start) * 1e-6f;
+        --mPendingQueries_;
+        updated = true;
+    }
+    return updated;
+}
+
+float GpuTimer::getMilliseconds() const {
+    return mMilliseconds_;
+}
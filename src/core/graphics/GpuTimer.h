@@ -0,0 +1,47 @@
+#pragma once
+
+/**
+ * Measures GPU time of the commands between begin and end with a pair of GL_TIMESTAMP queries. Results are collected
+ * a few frames later without waiting on the GPU, so the time read is always that of an earlier frame. Timers may
+ * nest and overlap, e.g. stage timers inside a frame timer
+ */
+class GpuTimer {
+public:
+    GpuTimer();
+
+    ~GpuTimer();
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    /** Start timing. Skipped when every query is still waiting for its result */
+    void begin();
+
+    /** Stop timing the commands issued since begin */
+    void end();
+
+    /**
+     * Collect the queries the GPU has finished, without waiting
+     * @return If a new time arrived
+     */
+    bool update();
+
+    /** GPU time of the newest finished measurement in milliseconds */
+    float getMilliseconds() const;
+
+    /** Queries in flight, enough to cover the frames the driver queues ahead. Results lag up to this many measurements */
+    static constexpr int kQueryCount = 4;
+
+private:
+
+    /** Start and end timestamp of every measurement in flight */
+    unsigned int mQueries_[kQueryCount][2];
+    /** Query the next begin uses */
+    int mNextQuery_ = 0;
+    /** Queries ended but not read yet, the oldest ones before mNextQuery_ */
+    int mPendingQueries_ = 0;
+    /** Between begin and end of a query that is recorded */
+    bool mActive_ = false;
+
+    float mMilliseconds_ = 0.0f;
+};
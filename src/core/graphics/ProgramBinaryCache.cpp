@@ -0,0 +1,175 @@
+// standard lib
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+// third party
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GL/gl.h>
+// project
+#include "core/graphics/ProgramBinaryCache.h"
+
+
+namespace {
+    /** First bytes of every cache file, bumped when the file layout changes */
+    constexpr char kFileMagic[4] = {'P', 'B', 'C', '1'};
+
+    /** 64 bit FNV-1a, chained over several strings through the seed */
+    uint64_t hashString(const std::string& text, uint64_t seed) {
+        uint64_t hash = seed;
+        for (const char c : text) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 0x100000001b3ull;
+        }
+        // Separator, so moving text from one string to the next changes the hash
+        hash ^= 0xff;
+        hash *= 0x100000001b3ull;
+        return hash;
+    }
+
+    std::string getGLString(GLenum name) {
+        const GLubyte* value = glGetString(name);
+        return (value != nullptr) ? reinterpret_cast<const char*>(value) : "unknown";
+    }
+}
+
+ProgramBinaryCache::ProgramBinaryCache(const std::string& cacheDirectory) : mCacheDirectory_(cacheDirectory) {
+    mDriverInfo_ = getGLString(GL_VENDOR) + "\n" + getGLString(GL_RENDERER) + "\n" + getGLString(GL_VERSION);
+
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    mEnabled_ = (formatCount > 0);
+    if (mEnabled_) {
+        prune();
+    }
+}
+
+bool ProgramBinaryCache::isEnabled() const {
+    return mEnabled_;
+}
+
+uint64_t ProgramBinaryCache::makeKey(const std::vector<std::pair<std::string, std::string>>& stageSources,
+                                     const std::string& defines) const {
+    uint64_t hash = hashString(mDriverInfo_, 0xcbf29ce484222325ull);
+    hash = hashString(defines, hash);
+    for (const auto& [stage, source] : stageSources) {
+        hash = hashString(stage, hash);
+        hash = hashString(source, hash);
+    }
+    return hash;
+}
+
+bool ProgramBinaryCache::load(uint64_t key, ShaderProgram& program) const {
+    if (!mEnabled_) {
+        return false;
+    }
+    const std::string filePath = getFilePath(key);
+    std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+    const std::streamoff fileSize = file.tellg();
+    file.seekg(0);
+
+    char magic[4] = {};
+    uint32_t binaryFormat = 0;
+    uint64_t binarySize = 0;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&binaryFormat), sizeof(binaryFormat));
+    file.read(reinterpret_cast<char*>(&binarySize), sizeof(binarySize));
+    // A truncated or corrupted entry is a miss, it is deleted before the stored size is trusted with an allocation
+    const uint64_t remainingSize = file ? static_cast<uint64_t>(fileSize - file.tellg()) : 0;
+    if (!file || !std::equal(magic, magic + sizeof(magic), kFileMagic) || binarySize != remainingSize) {
+        file.close();
+        std::error_code error;
+        std::filesystem::remove(filePath, error);
+        return false;
+    }
+    std::vector<unsigned char> binary(binarySize);
+    if (!file.read(reinterpret_cast<char*>(binary.data()), static_cast<std::streamsize>(binarySize))) {
+        return false;
+    }
+    if (!program.loadBinary(binaryFormat, binary)) {
+        return false;
+    }
+    // Hits are marked as recently used, so pruning removes the entries no program has loaded for the longest
+    std::error_code error;
+    std::filesystem::last_write_time(filePath, std::filesystem::file_time_type::clock::now(), error);
+    return true;
+}
+
+void ProgramBinaryCache::save(uint64_t key, const ShaderProgram& program) const {
+    if (!mEnabled_ || !program.isLinked()) {
+        return;
+    }
+    unsigned int binaryFormat = 0;
+    const std::vector<unsigned char> binary = program.getBinary(binaryFormat);
+    if (binary.empty()) {
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(mCacheDirectory_, error);
+    // Written under a temporary name and renamed, so a start that is cut short never leaves half a binary
+    const std::string filePath = getFilePath(key);
+    const std::string tempFilePath = filePath + ".tmp";
+    {
+        std::ofstream file(tempFilePath, std::ios::binary | std::ios::trunc);
+        const uint32_t format = binaryFormat;
+        const uint64_t binarySize = binary.size();
+        file.write(kFileMagic, sizeof(kFileMagic));
+        file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+        file.write(reinterpret_cast<const char*>(&binarySize), sizeof(binarySize));
+        file.write(reinterpret_cast<const char*>(binary.data()), static_cast<std::streamsize>(binary.size()));
+        if (!file) {
+            std::cout << "Could not write program binary " << tempFilePath << std::endl;
+            return;
+        }
+    }
+    std::filesystem::rename(tempFilePath, filePath, error);
+    prune();
+}
+
+void ProgramBinaryCache::prune() const {
+    struct Entry {
+        std::filesystem::path path;
+        std::filesystem::file_time_type lastUsed;
+        uintmax_t size;
+    };
+    std::vector<Entry> entries;
+    uintmax_t totalSize = 0;
+    std::error_code error;
+    for (const auto& dirEntry : std::filesystem::directory_iterator(mCacheDirectory_, error)) {
+        if (!dirEntry.is_regular_file(error)) {
+            continue;
+        }
+        Entry entry{dirEntry.path(), dirEntry.last_write_time(error), dirEntry.file_size(error)};
+        if (error) {
+            continue;
+        }
+        totalSize += entry.size;
+        entries.push_back(std::move(entry));
+    }
+    if (totalSize <= kMaxCacheSize) {
+        return;
+    }
+
+    // Binaries of edited shaders and other drivers are never loaded again, they are the oldest once the cache is full
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastUsed < b.lastUsed; });
+    for (const Entry& entry : entries) {
+        if (totalSize <= kMaxCacheSize) {
+            break;
+        }
+        if (std::filesystem::remove(entry.path, error)) {
+            totalSize -= entry.size;
+        }
+    }
+}
+
+std::string ProgramBinaryCache::getFilePath(uint64_t key) const {
+    char fileName[32];
+    std::snprintf(fileName, sizeof(fileName), "%016llx.bin", static_cast<unsigned long long>(key));
+    return mCacheDirectory_ + "/" + fileName;
+}
@@ -0,0 +1,68 @@
+#pragma once
+// standard lib
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+// project
+#include "core/graphics/ShaderProgram.h"
+
+/**
+ * On-disk cache of linked programs, so later starts load them with glProgramBinary instead of compiling. Every
+ * program is stored in its own file named after a hash of its stage sources, their defines and the GL vendor,
+ * renderer and version strings, so editing a shader or updating the driver simply misses the cache. Binaries the
+ * driver rejects anyway are compiled again and replaced. The directory is kept below kMaxCacheSize by deleting the
+ * least recently used binaries, which drops the ones left behind by edited shaders
+ */
+class ProgramBinaryCache {
+public:
+    /** Bytes the cache directory may hold before the least recently used binaries are deleted */
+    static constexpr uintmax_t kMaxCacheSize = 64ull * 1024 * 1024;
+
+    /**
+     * Constructor, needs a current GL context. The cache stays disabled if the driver has no binary formats
+     * @param cacheDirectory Directory of the cached binaries, created with the first binary saved
+     */
+    explicit ProgramBinaryCache(const std::string& cacheDirectory);
+
+    /** If the driver can save and load program binaries */
+    bool isEnabled() const;
+
+    /**
+     * Key of a program
+     * @param stageSources "path:STAGE" and the expanded source of every stage
+     * @param defines Defines the stages were compiled with, as one string
+     * @return Key to load and save the program by
+     */
+    uint64_t makeKey(const std::vector<std::pair<std::string, std::string>>& stageSources,
+                     const std::string& defines) const;
+
+    /**
+     * Load a cached program
+     * @param key Key from makeKey
+     * @param program Program without shaders to load the binary into
+     * @return If the program was cached and the driver accepted the binary. Entries that are cut short or
+     * corrupted are deleted
+     */
+    bool load(uint64_t key, ShaderProgram& program) const;
+
+    /**
+     * Store a linked program, programs that failed to link are skipped
+     * @param key Key from makeKey
+     * @param program Linked program
+     */
+    void save(uint64_t key, const ShaderProgram& program) const;
+
+private:
+    std::string getFilePath(uint64_t key) const;
+
+    /** Delete the least recently used binaries until the directory fits in kMaxCacheSize */
+    void prune() const;
+
+    std::string mCacheDirectory_;
+
+    /** GL_VENDOR, GL_RENDERER and GL_VERSION of the current context, part of every key */
+    std::string mDriverInfo_;
+
+    bool mEnabled_ = false;
+};
@@ -1,5 +1,8 @@
 // standard lib
+#include <algorithm>
 #include <stdexcept>
+#include <string>
+#include <type_traits>
 // third party
 #define GLEW_STATIC
 #include <GL/glew.h>
@@ -9,12 +12,86 @@
 #include "core/graphics/ShaderProgram.h"
 
 
+namespace {
+    /** Samplers and images are set with their texture or image unit */
+    bool isOpaqueType(GLenum type) {
+        switch (type) {
+            case GL_SAMPLER_1D:
+            case GL_SAMPLER_2D:
+            case GL_SAMPLER_3D:
+            case GL_SAMPLER_CUBE:
+            case GL_SAMPLER_2D_SHADOW:
+            case GL_SAMPLER_2D_ARRAY:
+            case GL_SAMPLER_BUFFER:
+            case GL_INT_SAMPLER_2D:
+            case GL_UNSIGNED_INT_SAMPLER_2D:
+            case GL_IMAGE_2D:
+            case GL_INT_IMAGE_2D:
+            case GL_UNSIGNED_INT_IMAGE_2D:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /** Info log of a shader or a program */
+    std::string getInfoLog(GLuint objectId, bool isShader) {
+        GLint logLength = 0;
+        if (isShader) {
+            glGetShaderiv(objectId, GL_INFO_LOG_LENGTH, &logLength);
+        } else {
+            glGetProgramiv(objectId, GL_INFO_LOG_LENGTH, &logLength);
+        }
+        std::string log(static_cast<std::size_t>(std::max(logLength, 1)), '\0');
+        GLsizei writtenLength = 0;
+        if (isShader) {
+            glGetShaderInfoLog(objectId, logLength, &writtenLength, log.data());
+        } else {
+            glGetProgramInfoLog(objectId, logLength, &writtenLength, log.data());
+        }
+        log.resize(static_cast<std::size_t>(writtenLength));
+        return log;
+    }
+
+    /** If a uniform of a GLSL type can be set with a value of type T */
+    template<typename T>
+    bool isUniformType(GLenum type) {
+        if constexpr (std::is_same_v<T, bool>) {
+            return type == GL_BOOL;
+        } else if constexpr (std::is_same_v<T, int>) {
+            return type == GL_INT || type == GL_BOOL || isOpaqueType(type);
+        } else if constexpr (std::is_same_v<T, unsigned int>) {
+            return type == GL_UNSIGNED_INT;
+        } else if constexpr (std::is_same_v<T, float>) {
+            return type == GL_FLOAT;
+        } else if constexpr (std::is_same_v<T, glm::vec2>) {
+            return type == GL_FLOAT_VEC2;
+        } else if constexpr (std::is_same_v<T, glm::ivec2>) {
+            return type == GL_INT_VEC2;
+        } else if constexpr (std::is_same_v<T, glm::vec3>) {
+            return type == GL_FLOAT_VEC3;
+        } else if constexpr (std::is_same_v<T, glm::vec4>) {
+            return type == GL_FLOAT_VEC4;
+        } else if constexpr (std::is_same_v<T, glm::mat2>) {
+            return type == GL_FLOAT_MAT2;
+        } else if constexpr (std::is_same_v<T, glm::mat3>) {
+            return type == GL_FLOAT_MAT3;
+        } else {
+            static_assert(std::is_same_v<T, glm::mat4>, "Unsupported uniform type");
+            return type == GL_FLOAT_MAT4;
+        }
+    }
+}
+
 ShaderProgram::ShaderProgram() {
     mProgramId_ = glCreateProgram();
 }
 
 ShaderProgram::~ShaderProgram() {
-    glDeleteShader(mProgramId_);
+    for (const unsigned int shaderId : mShaderIds_) {
+        glDeleteShader(shaderId);
+    }
+    glDeleteProgram(mProgramId_);
 }
 
 void ShaderProgram::addShader(const ShaderCreateInfo& shaderInfo) {
@@ -48,77 +125,259 @@ void ShaderProgram::addShader(const ShaderCreateInfo& shaderInfo) {
     glShaderSource(shaderID, 1, &sourceCStr, nullptr);
     glCompileShader(shaderID);
     glAttachShader(mProgramId_, shaderID);
+    mShaderIds_.push_back(shaderID);
 }
 
 void ShaderProgram::linkProgram() {
+    // Lets getBinary return the linked program for the program binary cache
+    glProgramParameteri(mProgramId_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(mProgramId_);
+    mLinkPending_ = true;
+}
+
+bool ShaderProgram::isLinkComplete() const {
+    if (!mLinkPending_ || !(GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile)) {
+        return true;
+    }
+    GLint linkComplete = GL_FALSE;
+    glGetProgramiv(mProgramId_, GL_COMPLETION_STATUS_KHR, &linkComplete);
+    return linkComplete == GL_TRUE;
+}
+
+std::string ShaderProgram::finishLink() {
+    if (!mLinkPending_) {
+        return "";
+    }
+    mLinkPending_ = false;
+
+    // The logs are only read on failure, reading them stalls until the driver is done
+    std::string log;
+    if (!isLinked()) {
+        for (const unsigned int shaderId : mShaderIds_) {
+            GLint compileStatus = GL_FALSE;
+            glGetShaderiv(shaderId, GL_COMPILE_STATUS, &compileStatus);
+            if (compileStatus != GL_TRUE) {
+                log += getInfoLog(shaderId, true);
+            }
+        }
+        log += getInfoLog(mProgramId_, false);
+        if (log.empty()) {
+            log = "Link failed without a log";
+        }
+    }
+
+    // The program keeps the linked code, the shader objects are no longer needed
+    for (const unsigned int shaderId : mShaderIds_) {
+        glDetachShader(mProgramId_, shaderId);
+        glDeleteShader(shaderId);
+    }
+    mShaderIds_.clear();
+
+    reflectUniforms();
+    return log;
+}
+
+bool ShaderProgram::isLinked() const {
+    GLint linkStatus = GL_FALSE;
+    glGetProgramiv(mProgramId_, GL_LINK_STATUS, &linkStatus);
+    return linkStatus == GL_TRUE;
+}
+
+void ShaderProgram::swap(ShaderProgram& other) {
+    std::swap(mProgramId_, other.mProgramId_);
+    std::swap(mShaderIds_, other.mShaderIds_);
+    std::swap(mLinkPending_, other.mLinkPending_);
+    std::swap(mUniforms_, other.mUniforms_);
+}
+
+std::string ShaderProgram::findUniformTypeMismatch(const ShaderProgram& other) const {
+    for (const auto& [name, info] : mUniforms_) {
+        auto it = other.mUniforms_.find(name);
+        if (it != other.mUniforms_.end() && it->second.type != info.type) {
+            return name;
+        }
+    }
+    return "";
+}
+
+bool ShaderProgram::loadBinary(unsigned int binaryFormat, const std::vector<unsigned char>& binary) {
+    glProgramBinary(mProgramId_, binaryFormat, binary.data(), static_cast<GLsizei>(binary.size()));
+    if (!isLinked()) {
+        return false;
+    }
+    reflectUniforms();
+    return true;
+}
+
+std::vector<unsigned char> ShaderProgram::getBinary(unsigned int& binaryFormat) const {
+    GLint binaryLength = 0;
+    glGetProgramiv(mProgramId_, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+    std::vector<unsigned char> binary(static_cast<std::size_t>(binaryLength));
+    if (binaryLength > 0) {
+        GLsizei writtenLength = 0;
+        GLenum format = 0;
+        glGetProgramBinary(mProgramId_, binaryLength, &writtenLength, &format, binary.data());
+        binary.resize(static_cast<std::size_t>(writtenLength));
+        binaryFormat = format;
+    }
+    return binary;
 }
 
 void ShaderProgram::bind() const {
     glUseProgram(mProgramId_); 
 }
 
+void ShaderProgram::reflectUniforms() {
+    mUniforms_.clear();
+    GLint uniformCount = 0;
+    GLint maxNameLength = 0;
+    glGetProgramInterfaceiv(mProgramId_, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniformCount);
+    glGetProgramInterfaceiv(mProgramId_, GL_UNIFORM, GL_MAX_NAME_LENGTH, &maxNameLength);
+
+    std::string name(static_cast<std::size_t>(maxNameLength), '\0');
+    const GLenum properties[3] = {GL_LOCATION, GL_TYPE, GL_BLOCK_INDEX};
+    for (GLint i = 0; i < uniformCount; ++i) {
+        GLint values[3];
+        glGetProgramResourceiv(mProgramId_, GL_UNIFORM, i, 3, properties, 3, nullptr, values);
+        // Members of uniform blocks are set through their buffer
+        if (values[2] != -1) {
+            continue;
+        }
+        GLsizei nameLength = 0;
+        glGetProgramResourceName(mProgramId_, GL_UNIFORM, i, maxNameLength, &nameLength, name.data());
+        const std::string uniformName(name.data(), nameLength);
+        const UniformInfo info = {values[0], static_cast<unsigned int>(values[1])};
+        mUniforms_[uniformName] = info;
+
+        // Arrays are reflected as name[0], GL also accepts the plain name
+        if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0) {
+            mUniforms_[uniformName.substr(0, uniformName.size() - 3)] = info;
+        }
+    }
+}
+
+int ShaderProgram::getUniformLocation(std::string_view name) const {
+    auto it = mUniforms_.find(name);
+    if (it != mUniforms_.end()) {
+        return it->second.location;
+    }
+    // Only the first element of an array is reflected, other elements are rare enough to ask the driver
+    if (name.find('[') != std::string_view::npos) {
+        return glGetUniformLocation(mProgramId_, std::string(name).c_str());
+    }
+    return -1;
+}
+
+template<typename T>
+UniformHandle<T> ShaderProgram::getUniform(std::string_view name) const {
+    auto it = mUniforms_.find(name);
+    if (it == mUniforms_.end()) {
+        return {getUniformLocation(name)};
+    }
+    if (!isUniformType<T>(it->second.type)) {
+        throw std::runtime_error("Uniform " + std::string(name) + " has another type than its handle");
+    }
+    return {it->second.location};
+}
+
+template<typename T>
+void ShaderProgram::set(UniformHandle<T> uniform, const std::type_identity_t<T>& value) const {
+    if constexpr (std::is_same_v<T, bool>) {
+        glUniform1i(uniform.location, static_cast<int>(value));
+    } else if constexpr (std::is_same_v<T, int>) {
+        glUniform1i(uniform.location, value);
+    } else if constexpr (std::is_same_v<T, unsigned int>) {
+        glUniform1ui(uniform.location, value);
+    } else if constexpr (std::is_same_v<T, float>) {
+        glUniform1f(uniform.location, value);
+    } else if constexpr (std::is_same_v<T, glm::vec2>) {
+        glUniform2fv(uniform.location, 1, &value[0]);
+    } else if constexpr (std::is_same_v<T, glm::ivec2>) {
+        glUniform2iv(uniform.location, 1, &value[0]);
+    } else if constexpr (std::is_same_v<T, glm::vec3>) {
+        glUniform3fv(uniform.location, 1, &value[0]);
+    } else if constexpr (std::is_same_v<T, glm::vec4>) {
+        glUniform4fv(uniform.location, 1, &value[0]);
+    } else if constexpr (std::is_same_v<T, glm::mat2>) {
+        glUniformMatrix2fv(uniform.location, 1, GL_FALSE, &value[0][0]);
+    } else if constexpr (std::is_same_v<T, glm::mat3>) {
+        glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &value[0][0]);
+    } else {
+        glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &value[0][0]);
+    }
+}
+
 // utility uniform functions
-void ShaderProgram::setBool(const std::string& name, bool value) const {
-    glUniform1i(glGetUniformLocation(mProgramId_, name.c_str()), (int)value); 
+void ShaderProgram::setBool(std::string_view name, bool value) const {
+    glUniform1i(getUniformLocation(name), (int)value); 
 }
 
-void ShaderProgram::setInt(const std::string& name, int value) const {
-    glUniform1i(glGetUniformLocation(mProgramId_, name.c_str()), value); 
+void ShaderProgram::setInt(std::string_view name, int value) const {
+    glUniform1i(getUniformLocation(name), value); 
 
 }
 
-void ShaderProgram::setFloat(const std::string& name, float value) const {
-    glUniform1f(glGetUniformLocation(mProgramId_, name.c_str()), value); 
+void ShaderProgram::setUInt(std::string_view name, unsigned int value) const {
+    glUniform1ui(getUniformLocation(name), value);
 
 }
 
-void ShaderProgram::setVec2(const std::string& name, const glm::vec2& value) const {
-    glUniform2fv(glGetUniformLocation(mProgramId_, name.c_str()), 1, &value[0]); 
+void ShaderProgram::setFloat(std::string_view name, float value) const {
+    glUniform1f(getUniformLocation(name), value); 
 
 }
 
-void ShaderProgram::setVec2(const std::string& name, float x, float y) const {
-    glUniform2f(glGetUniformLocation(mProgramId_, name.c_str()), x, y); 
+void ShaderProgram::setVec2(std::string_view name, const glm::vec2& value) const {
+    glUniform2fv(getUniformLocation(name), 1, &value[0]); 
 
 }
 
-void ShaderProgram::setVec3(const std::string& name, const glm::vec3& value) const {
-    glUniform3fv(glGetUniformLocation(mProgramId_, name.c_str()), 1, &value[0]); 
+void ShaderProgram::setVec2(std::string_view name, float x, float y) const {
+    glUniform2f(getUniformLocation(name), x, y); 
 
 }
 
-void ShaderProgram::setVec3(const std::string& name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(mProgramId_, name.c_str()), x, y, z); 
+void ShaderProgram::setIVec2(std::string_view name, const glm::ivec2& value) const {
+    glUniform2iv(getUniformLocation(name), 1, &value[0]);
 
 }
 
-void ShaderProgram::setVec4(const std::string& name, const glm::vec4& value) const {
-    glUniform4fv(glGetUniformLocation(mProgramId_, name.c_str()), 1, &value[0]); 
+void ShaderProgram::setVec3(std::string_view name, const glm::vec3& value) const {
+    glUniform3fv(getUniformLocation(name), 1, &value[0]); 
 
 }
 
-void ShaderProgram::setVec4(const std::string& name, float x, float y, float z, float w) const {
-    glUniform4f(glGetUniformLocation(mProgramId_, name.c_str()), x, y, z, w); 
+void ShaderProgram::setVec3(std::string_view name, float x, float y, float z) const {
+    glUniform3f(getUniformLocation(name), x, y, z); 
 
 }
 
-void ShaderProgram::setMat2(const std::string& name, const glm::mat2& mat) const {
-    glUniformMatrix2fv(glGetUniformLocation(mProgramId_, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+void ShaderProgram::setVec4(std::string_view name, const glm::vec4& value) const {
+    glUniform4fv(getUniformLocation(name), 1, &value[0]); 
 
 }
 
-void ShaderProgram::setMat3(const std::string& name, const glm::mat3& mat) const {
-    glUniformMatrix3fv(glGetUniformLocation(mProgramId_, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+void ShaderProgram::setVec4(std::string_view name, float x, float y, float z, float w) const {
+    glUniform4f(getUniformLocation(name), x, y, z, w); 
 
 }
 
-void ShaderProgram::setMat4(const std::string& name, const glm::mat4& mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(mProgramId_, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+void ShaderProgram::setMat2(std::string_view name, const glm::mat2& mat) const {
+    glUniformMatrix2fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
 
 }
 
-void ShaderProgram::setTexture(const std::string& uniformName, unsigned int textureId, unsigned int textureUnit) const {
+void ShaderProgram::setMat3(std::string_view name, const glm::mat3& mat) const {
+    glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
+
+}
+
+void ShaderProgram::setMat4(std::string_view name, const glm::mat4& mat) const {
+    glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
+
+}
+
+void ShaderProgram::setTexture(std::string_view uniformName, unsigned int textureId, unsigned int textureUnit) const {
     glActiveTexture(GL_TEXTURE0 + textureUnit);
     glBindTexture(GL_TEXTURE_2D, textureId);
 
@@ -128,4 +387,29 @@ void ShaderProgram::setTexture(const std::string& uniformName, unsigned int text
 /** Get the shader program Id*/
 unsigned int ShaderProgram::getProgramId() const {
     return mProgramId_;
-}
\ No newline at end of file
+}
+
+// Explicit instantiate template for the uniform types
+template UniformHandle<bool> ShaderProgram::getUniform(std::string_view name) const;
+template UniformHandle<int> ShaderProgram::getUniform(std::string_view name) const;
+template UniformHandle<unsigned int> ShaderProgram::getUniform(std::string_view name) const;
+template UniformHandle<float> ShaderProgram::getUniform(std::string_view name) const;
+template UniformHandle<glm::vec2> ShaderProgram::getUniform(std::string_view name) const;
+template UniformHandle<glm::ivec2> ShaderProgram::getUniform(std::string_view name) const;
+template UniformHandle<glm::vec3> ShaderProgram::getUniform(std::string_view name) const;
+template UniformHandle<glm::vec4> ShaderProgram::getUniform(std::string_view name) const;
+template UniformHandle<glm::mat2> ShaderProgram::getUniform(std::string_view name) const;
+template UniformHandle<glm::mat3> ShaderProgram::getUniform(std::string_view name) const;
+template UniformHandle<glm::mat4> ShaderProgram::getUniform(std::string_view name) const;
+
+template void ShaderProgram::set(UniformHandle<bool> uniform, const bool& value) const;
+template void ShaderProgram::set(UniformHandle<int> uniform, const int& value) const;
+template void ShaderProgram::set(UniformHandle<unsigned int> uniform, const unsigned int& value) const;
+template void ShaderProgram::set(UniformHandle<float> uniform, const float& value) const;
+template void ShaderProgram::set(UniformHandle<glm::vec2> uniform, const glm::vec2& value) const;
+template void ShaderProgram::set(UniformHandle<glm::ivec2> uniform, const glm::ivec2& value) const;
+template void ShaderProgram::set(UniformHandle<glm::vec3> uniform, const glm::vec3& value) const;
+template void ShaderProgram::set(UniformHandle<glm::vec4> uniform, const glm::vec4& value) const;
+template void ShaderProgram::set(UniformHandle<glm::mat2> uniform, const glm::mat2& value) const;
+template void ShaderProgram::set(UniformHandle<glm::mat3> uniform, const glm::mat3& value) const;
+template void ShaderProgram::set(UniformHandle<glm::mat4> uniform, const glm::mat4& value) const;
@@ -1,10 +1,27 @@
 #pragma once
 // standard lib
 #include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 // third party
 #include <glm/glm.hpp>
 
+/**
+ * Location of a uniform resolved once by ShaderProgram::getUniform, set with ShaderProgram::set without a name lookup.
+ * T is the C++ type the uniform is set with
+ */
+template<typename T>
+struct UniformHandle {
+    int location = -1;
+
+    /** If the program uses the uniform, setting an inactive uniform does nothing */
+    bool isActive() const { return location >= 0; }
+};
+
 class ShaderProgram {
 public:
 
@@ -26,33 +43,119 @@ public:
 
     ~ShaderProgram();
 
+    ShaderProgram(const ShaderProgram&) = delete;
+    ShaderProgram& operator=(const ShaderProgram&) = delete;
+
     void addShader(const ShaderCreateInfo& shaderInfo);
 
+    /**
+     * Start linking the added shaders. Nothing waits for the driver, so with KHR_parallel_shader_compile the
+     * compiles and links of several programs run at the same time. finishLink has to be called before the program
+     * is used
+     */
     void linkProgram();
 
+    /** If the driver is done linking, without waiting for it. Always true without KHR_parallel_shader_compile */
+    bool isLinkComplete() const;
+
+    /**
+     * Wait for the link, release the shaders and reflect the active uniforms of the program
+     * @return Compile and link logs if the program failed to link, empty otherwise
+     */
+    std::string finishLink();
+
+    /** If the last link, or loadBinary, produced a usable program */
+    bool isLinked() const;
+
+    /**
+     * Exchange the GL programs and uniform tables of two programs, e.g. to replace a program with a recompiled
+     * one while pointers to it stay valid. Handles from getUniform have to be resolved again
+     */
+    void swap(ShaderProgram& other);
+
+    /**
+     * Find a uniform both programs use with different GLSL types, handles resolved on one would throw on the other
+     * @param other Program to compare the reflected uniforms with
+     * @return Name of the first such uniform, empty if all shared uniforms match
+     */
+    std::string findUniformTypeMismatch(const ShaderProgram& other) const;
+
+    /**
+     * Load a program saved with getBinary instead of compiling and linking shaders
+     * @param binaryFormat Driver specific format getBinary returned
+     * @param binary Program binary
+     * @return If the driver accepted the binary, it rejects binaries of other drivers or versions
+     */
+    bool loadBinary(unsigned int binaryFormat, const std::vector<unsigned char>& binary);
+
+    /**
+     * Get the linked program as a driver specific binary
+     * @param binaryFormat Set to the format to load the binary with
+     * @return The binary, empty if the driver can't provide one
+     */
+    std::vector<unsigned char> getBinary(unsigned int& binaryFormat) const;
+
     void bind() const;
 
-    // utility uniform functions
-    void setBool(const std::string& name, bool value) const;
-    void setInt(const std::string& name, int value) const;
-    void setFloat(const std::string& name, float value) const;
-    void setVec2(const std::string& name, const glm::vec2& value) const;
-    void setVec2(const std::string& name, float x, float y) const;
-    void setVec3(const std::string& name, const glm::vec3& value) const;
-    void setVec3(const std::string& name, float x, float y, float z) const;
-    void setVec4(const std::string& name, const glm::vec4& value) const;
-    void setVec4(const std::string& name, float x, float y, float z, float w) const;
-    void setMat2(const std::string& name, const glm::mat2& mat) const;
-    void setMat3(const std::string& name, const glm::mat3& mat) const;
-    void setMat4(const std::string& name, const glm::mat4& mat) const;
-
-    void setTexture(const std::string& uniformName, unsigned int textureId, unsigned int textureUnit) const;
+    /**
+     * Get a handle to a uniform, checked against its GLSL type
+     * @param name Uniform name, arrays can be named with or without [0]
+     * @return Handle to set the uniform with, inactive if the program doesn't use the uniform
+     */
+    template<typename T>
+    UniformHandle<T> getUniform(std::string_view name) const;
+
+    /** Set a uniform of the bound program, the value converts to the type of the handle */
+    template<typename T>
+    void set(UniformHandle<T> uniform, const std::type_identity_t<T>& value) const;
+
+    /** Location of a uniform from the table reflected at link time, -1 if the program doesn't use it */
+    int getUniformLocation(std::string_view name) const;
+
+    // utility uniform functions, the locations are looked up by name in the reflected table
+    void setBool(std::string_view name, bool value) const;
+    void setInt(std::string_view name, int value) const;
+    void setUInt(std::string_view name, unsigned int value) const;
+    void setFloat(std::string_view name, float value) const;
+    void setVec2(std::string_view name, const glm::vec2& value) const;
+    void setVec2(std::string_view name, float x, float y) const;
+    void setIVec2(std::string_view name, const glm::ivec2& value) const;
+    void setVec3(std::string_view name, const glm::vec3& value) const;
+    void setVec3(std::string_view name, float x, float y, float z) const;
+    void setVec4(std::string_view name, const glm::vec4& value) const;
+    void setVec4(std::string_view name, float x, float y, float z, float w) const;
+    void setMat2(std::string_view name, const glm::mat2& mat) const;
+    void setMat3(std::string_view name, const glm::mat3& mat) const;
+    void setMat4(std::string_view name, const glm::mat4& mat) const;
+
+    void setTexture(std::string_view uniformName, unsigned int textureId, unsigned int textureUnit) const;
 
     /** Get the shader program Id*/
     unsigned int getProgramId() const;
 
 private:
+    /** Active uniform reflected at link time */
+    struct UniformInfo {
+        int location;
+        /** GLSL type, e.g. GL_FLOAT_MAT4 */
+        unsigned int type;
+    };
+
+    /** Hashes std::string keys and std::string_view lookups alike, so finding a uniform doesn't allocate */
+    struct NameHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+    };
+
+    void reflectUniforms();
+
     unsigned int mProgramId_;
 
+    /** Shaders attached until the program is linked */
+    std::vector<unsigned int> mShaderIds_;
+
+    /** Between linkProgram and finishLink */
+    bool mLinkPending_ = false;
 
-};
\ No newline at end of file
+    std::unordered_map<std::string, UniformInfo, NameHash, std::equal_to<>> mUniforms_;
+};
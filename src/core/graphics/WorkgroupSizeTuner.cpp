@@ -0,0 +1,94 @@
+// standard lib
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+// third party
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GL/gl.h>
+// project
+#include "core/graphics/GpuTimer.h"
+#include "core/graphics/WorkgroupSizeTuner.h"
+
+
+WorkgroupSizeTuner::WorkgroupSizeTuner(const std::string& cacheFilePath) : mCacheFilePath_(cacheFilePath) {
+    const GLubyte* renderer = glGetString(GL_RENDERER);
+    mRenderer_ = (renderer != nullptr) ? reinterpret_cast<const char*>(renderer) : "unknown";
+    readCache();
+}
+
+std::optional<glm::ivec2> WorkgroupSizeTuner::getTunedSize(const std::string& kernelName) const {
+    auto it = mTunedSizes_.find({mRenderer_, kernelName});
+    if (it == mTunedSizes_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+glm::ivec2 WorkgroupSizeTuner::tune(const std::string& kernelName, const std::vector<glm::ivec2>& candidates,
+                                    const std::function<void(const glm::ivec2&)>& dispatch) {
+    if (candidates.empty()) {
+        throw std::runtime_error("No workgroup sizes to tune " + kernelName + " over");
+    }
+
+    GpuTimer timer;
+    glm::ivec2 bestSize = candidates[0];
+    float bestMilliseconds = 0.0f;
+    for (const glm::ivec2& size : candidates) {
+        for (int run = 0; run < kWarmupRuns; ++run) {
+            dispatch(size);
+        }
+        glFinish();
+
+        std::vector<float> milliseconds;
+        for (int run = 0; run < kTimedRuns; ++run) {
+            timer.begin();
+            dispatch(size);
+            timer.end();
+            // Waiting keeps a single query in flight, the result is there right away
+            glFinish();
+            timer.update();
+            milliseconds.push_back(timer.getMilliseconds());
+        }
+        std::nth_element(milliseconds.begin(), milliseconds.begin() + kTimedRuns / 2, milliseconds.end());
+        const float medianMilliseconds = milliseconds[kTimedRuns / 2];
+        std::cout << kernelName << " " << size.x << "x" << size.y << ": " << medianMilliseconds << " ms" << std::endl;
+
+        if (size == candidates[0] || medianMilliseconds < bestMilliseconds) {
+            bestSize = size;
+            bestMilliseconds = medianMilliseconds;
+        }
+    }
+
+    mTunedSizes_[{mRenderer_, kernelName}] = bestSize;
+    writeCache();
+    return bestSize;
+}
+
+void WorkgroupSizeTuner::readCache() {
+    std::ifstream file(mCacheFilePath_);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string renderer;
+        std::string kernelName;
+        glm::ivec2 size;
+        // Renderer strings have spaces but no tabs
+        if (std::getline(fields, renderer, '\t') && std::getline(fields, kernelName, '\t') && (fields >> size.x >> size.y)) {
+            mTunedSizes_[{renderer, kernelName}] = size;
+        }
+    }
+}
+
+void WorkgroupSizeTuner::writeCache() const {
+    std::ofstream file(mCacheFilePath_, std::ios::trunc);
+    if (!file) {
+        std::cerr << "Could not write the workgroup size cache " << mCacheFilePath_ << std::endl;
+        return;
+    }
+    for (const auto& [key, size] : mTunedSizes_) {
+        file << key.first << "\t" << key.second << "\t" << size.x << "\t" << size.y << "\n";
+    }
+}
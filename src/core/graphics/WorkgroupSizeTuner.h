@@ -0,0 +1,60 @@
+#pragma once
+// standard lib
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+// third party
+#include <glm/glm.hpp>
+
+/**
+ * Picks the fastest workgroup size of a compute kernel on the device it runs on. Every candidate is dispatched a
+ * few times and timed with GL timer queries, the winner is kept per GL_RENDERER string in a small text file so
+ * later runs on the same device start with it
+ */
+class WorkgroupSizeTuner {
+public:
+    /**
+     * Constructor, needs a current GL context
+     * @param cacheFilePath File the tuned sizes are read from and written to, one "renderer<TAB>kernel<TAB>x<TAB>y"
+     * line per tuned kernel. A missing file is created by the first tune
+     */
+    explicit WorkgroupSizeTuner(const std::string& cacheFilePath);
+
+    /**
+     * Get the size a kernel was tuned to on this renderer
+     * @param kernelName Name the kernel was tuned under
+     * @return The tuned size, empty if the kernel was never tuned on this renderer
+     */
+    std::optional<glm::ivec2> getTunedSize(const std::string& kernelName) const;
+
+    /**
+     * Time every candidate and store the fastest. Waits for the GPU after every dispatch, so this is meant for
+     * startup or an explicit request rather than every frame
+     * @param kernelName Name to store the result under
+     * @param candidates Workgroup sizes to try
+     * @param dispatch Binds the kernel compiled for a workgroup size and dispatches one frame of work with it
+     * @return The fastest candidate
+     */
+    glm::ivec2 tune(const std::string& kernelName, const std::vector<glm::ivec2>& candidates,
+                    const std::function<void(const glm::ivec2&)>& dispatch);
+
+    /** Dispatches per candidate before timing, the first one also compiles the variant */
+    static constexpr int kWarmupRuns = 2;
+    /** Timed dispatches per candidate, the median is compared */
+    static constexpr int kTimedRuns = 5;
+
+private:
+    void readCache();
+
+    void writeCache() const;
+
+    std::string mCacheFilePath_;
+
+    /** GL_RENDERER of the current context */
+    std::string mRenderer_;
+
+    /** Tuned sizes of every renderer in the cache file, keyed by renderer and kernel name */
+    std::map<std::pair<std::string, std::string>, glm::ivec2> mTunedSizes_;
+};
@@ -0,0 +1,144 @@
+// standard lib
+#include <stdexcept>
+#include <string>
+// project
+#include "core/raytrace/AccelerationStructure.h"
+
+
+uint32_t AccelerationStructure::addMesh(const TriangleMesh& mesh) {
+    const uint32_t meshIdx = static_cast<uint32_t>(mMeshes_.size());
+    mMeshes_.push_back(mesh);
+
+    std::vector<BoundingBox> triangleBounds;
+    mesh.computeBounds(triangleBounds);
+    mMeshBVHs_.emplace_back();
+    mMeshBVHs_.back().build(triangleBounds);
+
+    // Meshes are packed back to back in the order they were added
+    mMeshOffsets_.push_back(mPackedSize_);
+    mPackedSize_.node += static_cast<uint32_t>(mMeshBVHs_.back().getNodes().size());
+    mPackedSize_.primIndex += static_cast<uint32_t>(mMeshBVHs_.back().getPrimIndices().size());
+    mPackedSize_.triangle += static_cast<uint32_t>(mesh.size());
+    mPackedSize_.material += static_cast<uint32_t>(mesh.getMaterialCount());
+
+    return meshIdx;
+}
+
+uint32_t AccelerationStructure::addInstance(uint32_t meshIdx, const glm::mat4& objectToWorld) {
+    if (meshIdx >= mMeshes_.size()) {
+        throw std::runtime_error("Instance of unknown mesh " + std::to_string(meshIdx));
+    }
+    if (mMeshes_[meshIdx].empty()) {
+        throw std::runtime_error("Instance of empty mesh " + std::to_string(meshIdx));
+    }
+
+    const uint32_t instanceIdx = static_cast<uint32_t>(mInstances_.size());
+    mInstances_.push_back({meshIdx, objectToWorld, glm::inverse(objectToWorld)});
+    mInstanceBounds_.push_back(computeInstanceBounds(mInstances_.back()));
+    return instanceIdx;
+}
+
+void AccelerationStructure::setInstanceTransform(uint32_t instanceIdx, const glm::mat4& objectToWorld) {
+    MeshInstance& instance = mInstances_[instanceIdx];
+    instance.objectToWorld = objectToWorld;
+    instance.worldToObject = glm::inverse(objectToWorld);
+    mInstanceBounds_[instanceIdx] = computeInstanceBounds(instance);
+}
+
+void AccelerationStructure::buildTopLevel(ThreadPool* pThreadPool) {
+    mTopLevel_.build(mInstanceBounds_, pThreadPool);
+}
+
+void AccelerationStructure::clear() {
+    mMeshes_.clear();
+    mMeshBVHs_.clear();
+    mMeshOffsets_.clear();
+    mPackedSize_ = {0, 0, 0, 0};
+    mInstances_.clear();
+    mInstanceBounds_.clear();
+    mTopLevel_.build(mInstanceBounds_);
+}
+
+std::size_t AccelerationStructure::getMeshCount() const {
+    return mMeshes_.size();
+}
+
+std::size_t AccelerationStructure::getInstanceCount() const {
+    return mInstances_.size();
+}
+
+std::size_t AccelerationStructure::getTriangleCount() const {
+    return mPackedSize_.triangle;
+}
+
+bool AccelerationStructure::empty() const {
+    return mTopLevel_.empty();
+}
+
+const TriangleMesh& AccelerationStructure::getMesh(std::size_t meshIdx) const {
+    return mMeshes_[meshIdx];
+}
+
+const BVH& AccelerationStructure::getMeshBVH(std::size_t meshIdx) const {
+    return mMeshBVHs_[meshIdx];
+}
+
+const MeshInstance& AccelerationStructure::getInstance(std::size_t instanceIdx) const {
+    return mInstances_[instanceIdx];
+}
+
+const BVH& AccelerationStructure::getTopLevel() const {
+    return mTopLevel_;
+}
+
+glm::vec3 AccelerationStructure::getWorldNormal(std::size_t instanceIdx, std::size_t triangleIdx) const {
+    const MeshInstance& instance = mInstances_[instanceIdx];
+    // Normals transform with the inverse transpose to stay perpendicular under non uniform scale
+    const glm::vec3 objectNormal = mMeshes_[instance.meshIdx].getNormal(triangleIdx);
+    return glm::normalize(glm::transpose(glm::mat3(instance.worldToObject)) * objectNormal);
+}
+
+void AccelerationStructure::packMeshes(std::vector<glm::vec4>& triangles, std::vector<glm::vec4>& materials,
+                                       std::vector<BVHNode>& nodes, std::vector<uint32_t>& primIndices) const {
+    triangles.clear();
+    materials.clear();
+    nodes.clear();
+    primIndices.clear();
+    triangles.reserve(static_cast<std::size_t>(mPackedSize_.triangle) * 3);
+    materials.reserve(mPackedSize_.material);
+    nodes.reserve(mPackedSize_.node);
+    primIndices.reserve(mPackedSize_.primIndex);
+
+    for (std::size_t meshIdx = 0; meshIdx < mMeshes_.size(); ++meshIdx) {
+        const MeshOffsets& offsets = mMeshOffsets_[meshIdx];
+        mMeshes_[meshIdx].packTriangles(triangles, offsets.material);
+        mMeshes_[meshIdx].packMaterials(materials);
+
+        for (BVHNode node : mMeshBVHs_[meshIdx].getNodes()) {
+            node.leftFirst += static_cast<int32_t>(node.isLeaf() ? offsets.primIndex : offsets.node);
+            nodes.push_back(node);
+        }
+        for (const uint32_t triangleIdx : mMeshBVHs_[meshIdx].getPrimIndices()) {
+            primIndices.push_back(triangleIdx + offsets.triangle);
+        }
+    }
+}
+
+void AccelerationStructure::packInstances(std::vector<GpuMeshInstance>& instances) const {
+    instances.resize(mInstances_.size());
+    for (std::size_t i = 0; i < mInstances_.size(); ++i) {
+        instances[i] = {mInstances_[i].worldToObject, mMeshOffsets_[mInstances_[i].meshIdx].node, {0, 0, 0}};
+    }
+}
+
+BoundingBox AccelerationStructure::computeInstanceBounds(const MeshInstance& instance) const {
+    const BVHNode& root = mMeshBVHs_[instance.meshIdx].getNodes()[0];
+    BoundingBox bounds;
+    for (int corner = 0; corner < 8; ++corner) {
+        const glm::vec3 objectCorner((corner & 1) ? root.boundsMax.x : root.boundsMin.x,
+                                     (corner & 2) ? root.boundsMax.y : root.boundsMin.y,
+                                     (corner & 4) ? root.boundsMax.z : root.boundsMin.z);
+        bounds.grow(glm::vec3(instance.objectToWorld * glm::vec4(objectCorner, 1.0f)));
+    }
+    return bounds;
+}
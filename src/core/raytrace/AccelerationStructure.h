@@ -0,0 +1,133 @@
+#pragma once
+// standard lib
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+// third party
+#include <glm/glm.hpp>
+// project
+#include "core/ThreadPool.h"
+#include "core/raytrace/BVH.h"
+#include "core/raytrace/BoundingBox.h"
+#include "core/raytrace/TriangleMesh.h"
+
+/** Placement of a mesh in the world */
+struct MeshInstance {
+    uint32_t meshIdx;
+    glm::mat4 objectToWorld;
+    glm::mat4 worldToObject;
+};
+
+/** Instance record read by ray_trace_multi.glsl (std430 layout) */
+struct GpuMeshInstance {
+    glm::mat4 worldToObject;
+    /** Root node of the mesh BVH in the packed node array */
+    uint32_t rootNode;
+    uint32_t padding[3];
+};
+static_assert(sizeof(GpuMeshInstance) == 80, "GpuMeshInstance must match the std430 MeshInstance struct");
+
+/**
+ * Two level hierarchy over instanced triangle meshes. Every mesh keeps its triangles in object space with a
+ * bottom level BVH that is built once when the mesh is added. The top level BVH is built over the world bounds
+ * of the instances, so moving an instance only needs a new top level. Rays are moved into the object space of
+ * an instance before they traverse its mesh
+ */
+class AccelerationStructure {
+public:
+    /**
+     * Add a mesh and build its bottom level BVH. Meshes of a Model can be appended to one TriangleMesh with
+     * TriangleMesh::addMesh to instance the whole model at once
+     * @param mesh Triangles in object space
+     * @return Index of the mesh
+     */
+    uint32_t addMesh(const TriangleMesh& mesh);
+
+    /**
+     * Place a mesh in the world. The top level has to be rebuilt before tracing
+     * @param meshIdx Index returned by addMesh
+     * @param objectToWorld Transform of the instance
+     * @return Index of the instance
+     */
+    uint32_t addInstance(uint32_t meshIdx, const glm::mat4& objectToWorld);
+
+    /**
+     * Move an instance. The top level has to be rebuilt before tracing
+     * @param instanceIdx Index returned by addInstance
+     * @param objectToWorld New transform of the instance
+     */
+    void setInstanceTransform(uint32_t instanceIdx, const glm::mat4& objectToWorld);
+
+    /**
+     * Rebuild the top level BVH over the world bounds of the instances. This is cheap enough to run every frame
+     * since there is a single primitive per instance
+     * @param pThreadPool Optional pool to build in parallel
+     */
+    void buildTopLevel(ThreadPool* pThreadPool = nullptr);
+
+    /** Remove all meshes and instances */
+    void clear();
+
+    std::size_t getMeshCount() const;
+
+    std::size_t getInstanceCount() const;
+
+    /** Total number of triangles over all meshes, instanced triangles are only counted once */
+    std::size_t getTriangleCount() const;
+
+    /** If there are no instances to trace */
+    bool empty() const;
+
+    const TriangleMesh& getMesh(std::size_t meshIdx) const;
+
+    const BVH& getMeshBVH(std::size_t meshIdx) const;
+
+    const MeshInstance& getInstance(std::size_t instanceIdx) const;
+
+    /** Get the hierarchy over the instances, the leaves reference instance indices */
+    const BVH& getTopLevel() const;
+
+    /** Get the world space unit normal of a triangle of an instance */
+    glm::vec3 getWorldNormal(std::size_t instanceIdx, std::size_t triangleIdx) const;
+
+    /**
+     * Concatenate all meshes for the GPU. Indices are rebased so the arrays can be indexed directly: inner nodes
+     * point at global child nodes, leaves at global prim indices, prim indices at global triangles and triangles
+     * at global materials
+     * @param triangles Three vec4 per triangle, see TriangleMesh::packTriangles
+     * @param materials One vec4 per material, see TriangleMesh::packMaterials
+     * @param nodes Bottom level BVH nodes, the root of mesh i is at its entry in GpuMeshInstance::rootNode
+     * @param primIndices Triangle indices referenced by the leaves
+     */
+    void packMeshes(std::vector<glm::vec4>& triangles, std::vector<glm::vec4>& materials,
+                    std::vector<BVHNode>& nodes, std::vector<uint32_t>& primIndices) const;
+
+    /** Write the instance records read by the GPU */
+    void packInstances(std::vector<GpuMeshInstance>& instances) const;
+
+private:
+    /** World bounds of an instance from the corners of its mesh bounds */
+    BoundingBox computeInstanceBounds(const MeshInstance& instance) const;
+
+    std::vector<TriangleMesh> mMeshes_;
+
+    std::vector<BVH> mMeshBVHs_;
+
+    /** Offsets of every mesh in the packed arrays */
+    struct MeshOffsets {
+        uint32_t node;
+        uint32_t primIndex;
+        uint32_t triangle;
+        uint32_t material;
+    };
+    std::vector<MeshOffsets> mMeshOffsets_;
+
+    /** Packed sizes so far, the offsets of the next mesh */
+    MeshOffsets mPackedSize_ = {0, 0, 0, 0};
+
+    std::vector<MeshInstance> mInstances_;
+
+    std::vector<BoundingBox> mInstanceBounds_;
+
+    BVH mTopLevel_;
+};
@@ -0,0 +1,414 @@
+// standard lib
+#include <algorithm>
+#include <mutex>
+#include <numeric>
+// project
+#include "core/raytrace/BVH.h"
+
+void BVH::build(const std::vector<BoundingBox>& primBounds, ThreadPool* pThreadPool) {
+    const uint32_t primCount = static_cast<uint32_t>(primBounds.size());
+
+    mNodes_.clear();
+    mLevelNodes_.clear();
+    mLevelOffsets_.clear();
+    mBuildSAHCost_ = 0.0f;
+    mPrimIndices_.resize(primCount);
+    std::iota(mPrimIndices_.begin(), mPrimIndices_.end(), 0u);
+
+    if (primCount == 0) {
+        return;
+    }
+
+    BuildContext context{primBounds};
+    context.pThreadPool = pThreadPool;
+    context.centroids.resize(primCount);
+
+    // Root bounds, reduced per chunk when building in parallel
+    BoundingBox rootBounds;
+    BoundingBox rootCentroidBounds;
+    std::mutex rootMutex;
+    const auto computeRootBounds = [&](size_t begin, size_t end) {
+        BoundingBox bounds;
+        BoundingBox centroidBounds;
+        for (size_t i = begin; i < end; ++i) {
+            context.centroids[i] = primBounds[i].getCentroid();
+            bounds.grow(primBounds[i]);
+            centroidBounds.grow(context.centroids[i]);
+        }
+        std::lock_guard<std::mutex> lock(rootMutex);
+        rootBounds.grow(bounds);
+        rootCentroidBounds.grow(centroidBounds);
+    };
+    if (pThreadPool != nullptr) {
+        pThreadPool->parallelFor(0, primCount, kParallelBinThreshold / 4, computeRootBounds);
+    } else {
+        computeRootBounds(0, primCount);
+    }
+
+    // A binary tree with N leaves has at most 2N - 1 nodes
+    mNodes_.resize(2 * static_cast<size_t>(primCount) - 1);
+    BVHNode& root = mNodes_[0];
+    root.leftFirst = 0;
+    root.count = static_cast<int32_t>(primCount);
+    root.boundsMin = rootBounds.min;
+    root.boundsMax = rootBounds.max;
+    context.nodesUsed = 1;
+
+    if (pThreadPool != nullptr) {
+        ThreadPool::TaskGroup tasks(*pThreadPool);
+        context.pTasks = &tasks;
+        subdivide(0, rootCentroidBounds, context, 0);
+        tasks.wait();
+    } else {
+        subdivide(0, rootCentroidBounds, context, 0);
+    }
+
+    mNodes_.resize(context.nodesUsed.load());
+    mBuildSAHCost_ = computeSAHCost();
+    mLevelNodes_.clear();
+    mLevelOffsets_.clear();
+}
+
+void BVH::build(const SphereSet& spheres, ThreadPool* pThreadPool) {
+    std::vector<BoundingBox> primBounds;
+    computeSphereBounds(spheres, primBounds);
+    build(primBounds, pThreadPool);
+}
+
+void BVH::refit(const std::vector<BoundingBox>& primBounds, ThreadPool* pThreadPool, std::vector<NodeRange>* pChangedRanges) {
+    if (pChangedRanges != nullptr) {
+        pChangedRanges->clear();
+    }
+    if (mNodes_.empty()) {
+        return;
+    }
+    if (mLevelOffsets_.empty()) {
+        computeLevels();
+    }
+
+    // Children always sit one level deeper than their parent, so going up level by level sees final child bounds
+    std::vector<uint8_t> changed(mNodes_.size(), 0);
+    for (size_t level = mLevelOffsets_.size() - 1; level-- > 0;) {
+        const size_t begin = mLevelOffsets_[level];
+        const size_t end = mLevelOffsets_[level + 1];
+        const auto refitLevel = [&](size_t chunkBegin, size_t chunkEnd) {
+            for (size_t i = chunkBegin; i < chunkEnd; ++i) {
+                const uint32_t nodeIdx = mLevelNodes_[i];
+                changed[nodeIdx] = refitNode(nodeIdx, primBounds) ? 1 : 0;
+            }
+        };
+
+        if (pThreadPool != nullptr && end - begin >= kParallelRefitThreshold) {
+            pThreadPool->parallelFor(begin, end, kParallelRefitThreshold / 4, refitLevel);
+        } else {
+            refitLevel(begin, end);
+        }
+    }
+
+    if (pChangedRanges == nullptr) {
+        return;
+    }
+
+    // Merge changed nodes into ranges, bridging small gaps to keep the number of uploads down
+    for (uint32_t nodeIdx = 0; nodeIdx < mNodes_.size(); ++nodeIdx) {
+        if (changed[nodeIdx] == 0) {
+            continue;
+        }
+        if (!pChangedRanges->empty()) {
+            NodeRange& last = pChangedRanges->back();
+            if (nodeIdx - (last.first + last.count) <= kRangeMergeGap) {
+                last.count = nodeIdx - last.first + 1;
+                continue;
+            }
+        }
+        pChangedRanges->push_back({nodeIdx, 1});
+    }
+}
+
+float BVH::getQualityRatio() const {
+    if (mBuildSAHCost_ <= 0.0f) {
+        return 1.0f;
+    }
+    return computeSAHCost() / mBuildSAHCost_;
+}
+
+const std::vector<BVHNode>& BVH::getNodes() const {
+    return mNodes_;
+}
+
+const std::vector<uint32_t>& BVH::getPrimIndices() const {
+    return mPrimIndices_;
+}
+
+bool BVH::empty() const {
+    return mNodes_.empty();
+}
+
+float BVH::computeSAHCost() const {
+    if (mNodes_.empty()) {
+        return 0.0f;
+    }
+
+    const auto getArea = [](const BVHNode& node) {
+        BoundingBox bounds;
+        bounds.min = node.boundsMin;
+        bounds.max = node.boundsMax;
+        return bounds.getSurfaceArea();
+    };
+
+    const float rootArea = getArea(mNodes_[0]);
+    if (rootArea <= 0.0f) {
+        return static_cast<float>(mPrimIndices_.size());
+    }
+
+    // Node visits and primitive tests are weighted the same
+    float cost = 0.0f;
+    for (const BVHNode& node : mNodes_) {
+        cost += getArea(node) * (node.isLeaf() ? static_cast<float>(node.count) : 1.0f);
+    }
+    return cost / rootArea;
+}
+
+void BVH::computeSphereBounds(const SphereSet& spheres, std::vector<BoundingBox>& primBounds) {
+    primBounds.resize(spheres.size());
+    for (size_t i = 0; i < spheres.size(); ++i) {
+        const glm::vec3 center = spheres.getCenter(i);
+        const glm::vec3 extent(spheres.getRadius(i));
+        primBounds[i].min = center - extent;
+        primBounds[i].max = center + extent;
+    }
+}
+
+float BVH::intersectNode(const glm::vec3& rayOrigin, const glm::vec3& invRayDir, const BVHNode& node, float maxT) {
+    const glm::vec3 t0 = (node.boundsMin - rayOrigin) * invRayDir;
+    const glm::vec3 t1 = (node.boundsMax - rayOrigin) * invRayDir;
+    const glm::vec3 tNear = glm::min(t0, t1);
+    const glm::vec3 tFar = glm::max(t0, t1);
+    const float tEnter = std::max(std::max(tNear.x, tNear.y), tNear.z);
+    const float tExit = std::min(std::min(tFar.x, tFar.y), tFar.z);
+
+    if (tExit >= tEnter && tExit > 0.0f && tEnter < maxT) {
+        return tEnter;
+    }
+    return kMiss;
+}
+
+void BVH::subdivide(uint32_t nodeIdx, const BoundingBox& centroidBounds, BuildContext& context, int depth) {
+    BVHNode& node = mNodes_[nodeIdx];
+    // The traversal stack holds at most one entry per level
+    if (node.count <= kMinLeafSize || depth >= kMaxStackDepth - 1) {
+        return;
+    }
+
+    const Split split = findBestSplit(node, centroidBounds, context);
+    if (split.axis == -1) {
+        return;
+    }
+
+    BoundingBox nodeBounds;
+    nodeBounds.min = node.boundsMin;
+    nodeBounds.max = node.boundsMax;
+    const float leafCost = static_cast<float>(node.count) * nodeBounds.getSurfaceArea();
+    if (split.cost >= leafCost && node.count <= kMaxLeafSize) {
+        return;
+    }
+
+    // Partition the primitive indices in place around the split bin
+    int32_t i = node.leftFirst;
+    int32_t j = i + node.count - 1;
+    while (i <= j) {
+        if (getBin(centroidBounds, split.axis, context.centroids[mPrimIndices_[i]][split.axis]) < split.bin) {
+            ++i;
+        } else {
+            std::swap(mPrimIndices_[i], mPrimIndices_[j--]);
+        }
+    }
+
+    const int32_t leftCount = i - node.leftFirst;
+    if (leftCount == 0 || leftCount == node.count) {
+        return;
+    }
+
+    const uint32_t leftIdx = context.nodesUsed.fetch_add(2);
+
+    // Child bounds come straight from the bins, no extra pass over the primitives
+    BVHNode& left = mNodes_[leftIdx];
+    left.leftFirst = node.leftFirst;
+    left.count = leftCount;
+    left.boundsMin = split.leftBounds.min;
+    left.boundsMax = split.leftBounds.max;
+
+    BVHNode& right = mNodes_[leftIdx + 1];
+    right.leftFirst = i;
+    right.count = node.count - leftCount;
+    right.boundsMin = split.rightBounds.min;
+    right.boundsMax = split.rightBounds.max;
+
+    node.leftFirst = static_cast<int32_t>(leftIdx);
+    node.count = 0;
+
+    // Large subtrees go to other threads, the smaller work continues on this one
+    if (context.pTasks != nullptr && leftCount >= kParallelTaskThreshold) {
+        const BoundingBox leftCentroidBounds = split.leftCentroidBounds;
+        context.pTasks->run([this, leftIdx, leftCentroidBounds, &context, depth]() {
+            subdivide(leftIdx, leftCentroidBounds, context, depth + 1);
+        });
+    } else {
+        subdivide(leftIdx, split.leftCentroidBounds, context, depth + 1);
+    }
+    subdivide(leftIdx + 1, split.rightCentroidBounds, context, depth + 1);
+}
+
+void BVH::Bins::merge(const Bins& other) {
+    for (int axis = 0; axis < 3; ++axis) {
+        for (int b = 0; b < kBinCount; ++b) {
+            bounds[axis][b].grow(other.bounds[axis][b]);
+            centroidBounds[axis][b].grow(other.centroidBounds[axis][b]);
+            counts[axis][b] += other.counts[axis][b];
+        }
+    }
+}
+
+void BVH::binPrimitives(int32_t first, int32_t count, const BoundingBox& centroidBounds, const BuildContext& context, Bins& bins) const {
+    for (int32_t i = first; i < first + count; ++i) {
+        const uint32_t primIdx = mPrimIndices_[i];
+        const glm::vec3& centroid = context.centroids[primIdx];
+        for (int axis = 0; axis < 3; ++axis) {
+            const int bin = getBin(centroidBounds, axis, centroid[axis]);
+            bins.bounds[axis][bin].grow(context.primBounds[primIdx]);
+            bins.centroidBounds[axis][bin].grow(centroid);
+            ++bins.counts[axis][bin];
+        }
+    }
+}
+
+BVH::Split BVH::findBestSplit(const BVHNode& node, const BoundingBox& centroidBounds, BuildContext& context) const {
+    // Bins span the centroid bounds rather than the node bounds so no bin range is wasted
+    Bins bins;
+    if (context.pThreadPool != nullptr && node.count >= kParallelBinThreshold) {
+        // Every chunk fills its own histogram, merged once all chunks are done
+        std::mutex binsMutex;
+        context.pThreadPool->parallelFor(node.leftFirst, node.leftFirst + node.count, kParallelBinThreshold / 8,
+            [&](size_t begin, size_t end) {
+                Bins localBins;
+                binPrimitives(static_cast<int32_t>(begin), static_cast<int32_t>(end - begin), centroidBounds, context, localBins);
+                std::lock_guard<std::mutex> lock(binsMutex);
+                bins.merge(localBins);
+            }
+        );
+    } else {
+        binPrimitives(node.leftFirst, node.count, centroidBounds, context, bins);
+    }
+
+    Split bestSplit;
+    bestSplit.cost = std::numeric_limits<float>::max();
+
+    for (int axis = 0; axis < 3; ++axis) {
+        if (centroidBounds.max[axis] <= centroidBounds.min[axis]) {
+            continue;
+        }
+
+        // Sweep from both sides to get the area and count left and right of every plane between bins
+        float leftAreas[kBinCount - 1];
+        float rightAreas[kBinCount - 1];
+        int leftCounts[kBinCount - 1];
+        int rightCounts[kBinCount - 1];
+        BoundingBox leftBox;
+        BoundingBox rightBox;
+        int leftSum = 0;
+        int rightSum = 0;
+        for (int b = 0; b < kBinCount - 1; ++b) {
+            leftSum += bins.counts[axis][b];
+            leftBox.grow(bins.bounds[axis][b]);
+            leftCounts[b] = leftSum;
+            leftAreas[b] = leftBox.getSurfaceArea();
+
+            rightSum += bins.counts[axis][kBinCount - 1 - b];
+            rightBox.grow(bins.bounds[axis][kBinCount - 1 - b]);
+            rightCounts[kBinCount - 2 - b] = rightSum;
+            rightAreas[kBinCount - 2 - b] = rightBox.getSurfaceArea();
+        }
+
+        for (int b = 0; b < kBinCount - 1; ++b) {
+            const float cost = leftCounts[b] * leftAreas[b] + rightCounts[b] * rightAreas[b];
+            if (leftCounts[b] > 0 && rightCounts[b] > 0 && cost < bestSplit.cost) {
+                bestSplit.axis = axis;
+                bestSplit.bin = b + 1;
+                bestSplit.cost = cost;
+            }
+        }
+    }
+
+    if (bestSplit.axis == -1) {
+        return bestSplit;
+    }
+
+    for (int b = 0; b < kBinCount; ++b) {
+        if (b < bestSplit.bin) {
+            bestSplit.leftBounds.grow(bins.bounds[bestSplit.axis][b]);
+            bestSplit.leftCentroidBounds.grow(bins.centroidBounds[bestSplit.axis][b]);
+        } else {
+            bestSplit.rightBounds.grow(bins.bounds[bestSplit.axis][b]);
+            bestSplit.rightCentroidBounds.grow(bins.centroidBounds[bestSplit.axis][b]);
+        }
+    }
+
+    return bestSplit;
+}
+
+int BVH::getBin(const BoundingBox& centroidBounds, int axis, float centroid) {
+    const float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+    if (extent <= 0.0f) {
+        return 0;
+    }
+    const int bin = static_cast<int>((centroid - centroidBounds.min[axis]) * (kBinCount / extent));
+    return std::clamp(bin, 0, kBinCount - 1);
+}
+
+void BVH::computeLevels() {
+    mLevelNodes_.clear();
+    mLevelOffsets_.clear();
+    if (mNodes_.empty()) {
+        return;
+    }
+
+    // Breadth first walk, one level at a time
+    mLevelNodes_.reserve(mNodes_.size());
+    mLevelNodes_.push_back(0);
+    mLevelOffsets_.push_back(0);
+    size_t levelBegin = 0;
+    while (levelBegin < mLevelNodes_.size()) {
+        const size_t levelEnd = mLevelNodes_.size();
+        mLevelOffsets_.push_back(levelEnd);
+        for (size_t i = levelBegin; i < levelEnd; ++i) {
+            const BVHNode& node = mNodes_[mLevelNodes_[i]];
+            if (!node.isLeaf()) {
+                mLevelNodes_.push_back(node.leftFirst);
+                mLevelNodes_.push_back(node.leftFirst + 1);
+            }
+        }
+        levelBegin = levelEnd;
+    }
+}
+
+bool BVH::refitNode(uint32_t nodeIdx, const std::vector<BoundingBox>& primBounds) {
+    BVHNode& node = mNodes_[nodeIdx];
+    BoundingBox bounds;
+    if (node.isLeaf()) {
+        for (int32_t i = 0; i < node.count; ++i) {
+            bounds.grow(primBounds[mPrimIndices_[node.leftFirst + i]]);
+        }
+    } else {
+        for (int32_t child = node.leftFirst; child <= node.leftFirst + 1; ++child) {
+            bounds.min = glm::min(bounds.min, mNodes_[child].boundsMin);
+            bounds.max = glm::max(bounds.max, mNodes_[child].boundsMax);
+        }
+    }
+
+    if (bounds.min == node.boundsMin && bounds.max == node.boundsMax) {
+        return false;
+    }
+    node.boundsMin = bounds.min;
+    node.boundsMax = bounds.max;
+    return true;
+}
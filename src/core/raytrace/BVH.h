@@ -0,0 +1,187 @@
+#pragma once
+// standard lib
+#include <atomic>
+#include <cstdint>
+#include <vector>
+// third party
+#include <glm/glm.hpp>
+// project
+#include "core/ThreadPool.h"
+#include "core/raytrace/BoundingBox.h"
+#include "core/raytrace/SphereSet.h"
+
+/** Flattened BVH node, laid out to match the std430 BVHNode struct in the ray trace shaders */
+struct BVHNode {
+    glm::vec3 boundsMin;
+    /** Left child index for inner nodes (the right child is the next node), first primitive index for leaves */
+    int32_t leftFirst;
+    glm::vec3 boundsMax;
+    /** Number of primitives in a leaf, 0 for inner nodes */
+    int32_t count;
+
+    bool isLeaf() const {
+        return count > 0;
+    }
+};
+static_assert(sizeof(BVHNode) == 32, "BVHNode must match the GPU layout");
+
+/**
+ * Bounding volume hierarchy over a list of primitive bounds, built with binned SAH. Leaves reference ranges of
+ * the primitive index list, children of an inner node are stored next to each other.
+ */
+class BVH {
+public:
+    /**
+     * Build the hierarchy. With a thread pool, large subtrees are built as parallel tasks and large nodes are
+     * binned by all threads at once
+     * @param primBounds Bounds of every primitive
+     * @param pThreadPool Optional pool to build with
+     */
+    void build(const std::vector<BoundingBox>& primBounds, ThreadPool* pThreadPool = nullptr);
+
+    /** Build the hierarchy over the bounds of the spheres */
+    void build(const SphereSet& spheres, ThreadPool* pThreadPool = nullptr);
+
+    /** Range of nodes [first, first + count) */
+    struct NodeRange {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    /**
+     * Update the node bounds bottom-up for moved primitives while keeping the topology. Levels are refit from
+     * the deepest up, the nodes of a level in parallel
+     * @param primBounds New bounds of every primitive, same count and order as the build
+     * @param pThreadPool Optional pool to refit with
+     * @param pChangedRanges Optional output of the node ranges whose bounds changed, close ranges are merged
+     */
+    void refit(const std::vector<BoundingBox>& primBounds, ThreadPool* pThreadPool = nullptr, std::vector<NodeRange>* pChangedRanges = nullptr);
+
+    /**
+     * Get how much the tree has degraded since it was built: current SAH cost over the cost right after the
+     * build. Refits keep the topology, so moving primitives apart slowly raises this above 1
+     */
+    float getQualityRatio() const;
+
+    /** Get the flattened nodes, the root is the first node */
+    const std::vector<BVHNode>& getNodes() const;
+
+    /** Get the primitive indices referenced by the leaves */
+    const std::vector<uint32_t>& getPrimIndices() const;
+
+    /** If the hierarchy has no nodes */
+    bool empty() const;
+
+    /**
+     * Get the SAH cost of the tree relative to the root area: the expected number of node visits plus
+     * primitive tests of a random ray hitting the root
+     */
+    float computeSAHCost() const;
+
+    /**
+     * Get the bounds of every sphere in the set
+     * @param spheres Spheres to bound
+     * @param primBounds Output bounds
+     */
+    static void computeSphereBounds(const SphereSet& spheres, std::vector<BoundingBox>& primBounds);
+
+    /**
+     * Slab test of a ray against a node
+     * @param rayOrigin Ray origin
+     * @param invRayDir Reciprocal of the ray direction
+     * @param node Node to test
+     * @param maxT Only count hits closer than this distance
+     * @return Entry distance, or a huge value on a miss
+     */
+    static float intersectNode(const glm::vec3& rayOrigin, const glm::vec3& invRayDir, const BVHNode& node, float maxT);
+
+    /** Value returned by intersectNode on a miss */
+    static constexpr float kMiss = 1e30f;
+
+    /** Max depth of a traversal stack */
+    static constexpr int kMaxStackDepth = 64;
+
+private:
+    /** Number of SAH bins per axis */
+    static constexpr int kBinCount = 16;
+    /** Leaves are never split below this size */
+    static constexpr int kMinLeafSize = 1;
+    /** Nodes with more primitives than this are split even when the SAH says not to */
+    static constexpr int kMaxLeafSize = 8;
+    /** Subtrees with at least this many primitives are built as separate tasks */
+    static constexpr int kParallelTaskThreshold = 4096;
+    /** Nodes with at least this many primitives are binned by several threads */
+    static constexpr int kParallelBinThreshold = 65536;
+
+    /** State shared by every node of one build */
+    struct BuildContext {
+        const std::vector<BoundingBox>& primBounds;
+        std::vector<glm::vec3> centroids;
+        std::atomic<uint32_t> nodesUsed = 0;
+        ThreadPool* pThreadPool = nullptr;
+        ThreadPool::TaskGroup* pTasks = nullptr;
+    };
+
+    /** SAH bins of a node on all three axes */
+    struct Bins {
+        BoundingBox bounds[3][kBinCount];
+        BoundingBox centroidBounds[3][kBinCount];
+        int counts[3][kBinCount] = {};
+
+        /** Add the contents of bins filled by another thread */
+        void merge(const Bins& other);
+    };
+
+    /** Best split found for a node */
+    struct Split {
+        int axis = -1;
+        /** Primitives in bins below this one go left */
+        int bin = 0;
+        float cost = 0.0f;
+        BoundingBox leftBounds;
+        BoundingBox rightBounds;
+        BoundingBox leftCentroidBounds;
+        BoundingBox rightCentroidBounds;
+    };
+
+    /**
+     * Split the node and its children until the leaves are cheaper than any split
+     * @param nodeIdx Node to split
+     * @param centroidBounds Bounds of the centroids of the node's primitives
+     * @param context Build state
+     * @param depth Depth of the node
+     */
+    void subdivide(uint32_t nodeIdx, const BoundingBox& centroidBounds, BuildContext& context, int depth);
+
+    /** Find the cheapest binned SAH split of a node */
+    Split findBestSplit(const BVHNode& node, const BoundingBox& centroidBounds, BuildContext& context) const;
+
+    /** Bin the primitives of [first, first + count) of the index list */
+    void binPrimitives(int32_t first, int32_t count, const BoundingBox& centroidBounds, const BuildContext& context, Bins& bins) const;
+
+    /** Get the bin of a centroid along an axis of the binned centroid bounds */
+    static int getBin(const BoundingBox& centroidBounds, int axis, float centroid);
+
+    /** Group the nodes by depth for the refit */
+    void computeLevels();
+
+    /** Refit a single node from its primitives or children, returns if the bounds changed */
+    bool refitNode(uint32_t nodeIdx, const std::vector<BoundingBox>& primBounds);
+
+    /** Nodes closer than this are uploaded as one range */
+    static constexpr uint32_t kRangeMergeGap = 16;
+    /** Levels with fewer nodes than this are refit on the calling thread */
+    static constexpr size_t kParallelRefitThreshold = 1024;
+
+    std::vector<BVHNode> mNodes_;
+
+    std::vector<uint32_t> mPrimIndices_;
+
+    /** SAH cost right after the last build */
+    float mBuildSAHCost_ = 0.0f;
+
+    /** Node indices sorted by depth, root first */
+    std::vector<uint32_t> mLevelNodes_;
+    /** Start of every depth in mLevelNodes_, plus the end */
+    std::vector<size_t> mLevelOffsets_;
+};
@@ -0,0 +1,45 @@
+#pragma once
+// standard lib
+#include <limits>
+// third party
+#include <glm/glm.hpp>
+
+/** Axis aligned bounding box. Default constructed boxes are empty and grow to fit what is added */
+struct BoundingBox {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    /** Grow to include a point */
+    void grow(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    /** Grow to include another box */
+    void grow(const BoundingBox& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    /** If nothing has been added to the box */
+    bool isEmpty() const {
+        return min.x > max.x;
+    }
+
+    glm::vec3 getCentroid() const {
+        return (min + max) * 0.5f;
+    }
+
+    glm::vec3 getExtent() const {
+        return max - min;
+    }
+
+    /** Surface area used by the SAH cost. Empty boxes have no area */
+    float getSurfaceArea() const {
+        if (isEmpty()) {
+            return 0.0f;
+        }
+        const glm::vec3 extent = getExtent();
+        return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+    }
+};
@@ -0,0 +1,527 @@
+// standard lib
+#include <algorithm>
+#include <bit>
+#include <cmath>
+// project
+#include "core/raytrace/CpuRayTracer.h"
+
+namespace {
+    /** Computes Fresnel reflection factor using Schlick's approximation */
+    float fresnelSchlick(float cosTheta, float F0) {
+        return F0 + (1.0f - F0) * std::pow(1.0f - cosTheta, 5.0f);
+    }
+
+    /** Ray-Sphere intersection, same as intersectSphere in ray_trace_multi.glsl */
+    bool intersectSphere(const glm::vec3& rayOrigin, const glm::vec3& rayDir, const glm::vec3& center, float radius, float& t) {
+        const glm::vec3 oc = rayOrigin - center;
+        const float a = glm::dot(rayDir, rayDir);
+        const float b = 2.0f * glm::dot(oc, rayDir);
+        const float c = glm::dot(oc, oc) - radius * radius;
+        const float discriminant = b * b - 4.0f * a * c;
+
+        if (discriminant < 0.0f) {
+            return false;
+        }
+
+        const float sqrtD = std::sqrt(discriminant);
+        const float t0 = (-b - sqrtD) / (2.0f * a);
+        const float t1 = (-b + sqrtD) / (2.0f * a);
+
+        t = (t0 > 0.0f) ? t0 : t1;
+        return t > 0.0f;
+    }
+
+    /** Dark blue background color */
+    const glm::vec3 kBackgroundColor(0.1f, 0.1f, 0.2f);
+
+    /**
+     * Near child first traversal of a binary BVH
+     * @param bvh Hierarchy to traverse
+     * @param rayOrigin Ray origin
+     * @param invRayDir Component wise inverse of the ray direction
+     * @param maxT Closest hit so far, lowered by intersectPrim on a closer hit to cull the remaining nodes
+     * @param intersectPrim Called with the index of every primitive in the leaves hit
+     */
+    template<typename IntersectPrim>
+    void traverseBVH(const BVH& bvh, const glm::vec3& rayOrigin, const glm::vec3& invRayDir, const float& maxT, IntersectPrim&& intersectPrim) {
+        const std::vector<BVHNode>& nodes = bvh.getNodes();
+        const std::vector<uint32_t>& primIndices = bvh.getPrimIndices();
+        if (nodes.empty() || BVH::intersectNode(rayOrigin, invRayDir, nodes[0], maxT) == BVH::kMiss) {
+            return;
+        }
+
+        int32_t stack[BVH::kMaxStackDepth];
+        int stackSize = 0;
+        int32_t nodeIdx = 0;
+
+        while (true) {
+            const BVHNode& node = nodes[nodeIdx];
+            if (node.isLeaf()) {
+                for (int32_t i = 0; i < node.count; ++i) {
+                    intersectPrim(primIndices[node.leftFirst + i]);
+                }
+            } else {
+                // Visit the nearer child first, the farther one is pushed for later
+                int32_t nearIdx = node.leftFirst;
+                int32_t farIdx = node.leftFirst + 1;
+                float nearT = BVH::intersectNode(rayOrigin, invRayDir, nodes[nearIdx], maxT);
+                float farT = BVH::intersectNode(rayOrigin, invRayDir, nodes[farIdx], maxT);
+                if (nearT > farT) {
+                    std::swap(nearIdx, farIdx);
+                    std::swap(nearT, farT);
+                }
+                if (nearT != BVH::kMiss) {
+                    if (farT != BVH::kMiss) {
+                        stack[stackSize++] = farIdx;
+                    }
+                    nodeIdx = nearIdx;
+                    continue;
+                }
+            }
+
+            if (stackSize == 0) {
+                break;
+            }
+            nodeIdx = stack[--stackSize];
+        }
+    }
+}
+
+CpuRayTracer::CpuRayTracer(ThreadPool& threadPool)
+    : mThreadPool_(threadPool) {}
+
+void CpuRayTracer::setSpheres(const SphereSet* pSpheres, const BVH* pBVH) {
+    mpSpheres_ = pSpheres;
+    mpBVH_ = pBVH;
+    collapseBVH();
+}
+
+void CpuRayTracer::refitBVH() {
+    // The topology is unchanged, only the child bounds are copied from the refit binary nodes
+    if (mBVHWidth_ == 4) {
+        mBVH4_.refit(*mpBVH_);
+    } else if (mBVHWidth_ == 8) {
+        mBVH8_.refit(*mpBVH_);
+    }
+}
+
+void CpuRayTracer::setMeshes(const AccelerationStructure* pMeshes) {
+    mpMeshes_ = pMeshes;
+}
+
+void CpuRayTracer::render(const glm::mat4& invViewMatrix, const glm::mat4& invProjMatrix, const glm::ivec2& imageSize) {
+    mInvViewMatrix_ = invViewMatrix;
+    mInvProjMatrix_ = invProjMatrix;
+    mImageSize_ = imageSize;
+    mPixels_.resize(static_cast<size_t>(imageSize.x) * imageSize.y);
+
+    // Only the tiles are waited for, the pool is shared with the scene
+    ThreadPool::TaskGroup tiles(mThreadPool_);
+    for (int y = 0; y < imageSize.y; y += kTileSize) {
+        for (int x = 0; x < imageSize.x; x += kTileSize) {
+            tiles.run([this, x, y]() {
+                renderTile({x, y});
+            });
+        }
+    }
+    tiles.wait();
+}
+
+const std::vector<glm::vec4>& CpuRayTracer::getPixels() const {
+    return mPixels_;
+}
+
+unsigned int CpuRayTracer::getThreadCount() const {
+    return mThreadPool_.getThreadCount();
+}
+
+void CpuRayTracer::setPacketTracing(bool enabled) {
+    mPacketTracing_ = enabled;
+}
+
+bool CpuRayTracer::isPacketTracing() const {
+    return mPacketTracing_;
+}
+
+PacketIntersector::SimdLevel CpuRayTracer::getSimdLevel() const {
+    return mIntersector_.getSimdLevel();
+}
+
+void CpuRayTracer::setBVHWidth(int width) {
+    mBVHWidth_ = width;
+    collapseBVH();
+}
+
+int CpuRayTracer::getBVHWidth() const {
+    return mBVHWidth_;
+}
+
+void CpuRayTracer::collapseBVH() {
+    if (mpBVH_ == nullptr) {
+        return;
+    }
+    // Only the selected width is kept up to date
+    if (mBVHWidth_ == 4) {
+        mBVH4_.collapse(*mpBVH_);
+    } else if (mBVHWidth_ == 8) {
+        mBVH8_.collapse(*mpBVH_);
+    }
+}
+
+void CpuRayTracer::renderTile(const glm::ivec2& tileStart) {
+    const glm::ivec2 tileEnd = glm::min(tileStart + glm::ivec2(kTileSize), mImageSize_);
+    // Ray origin is the camera position in world space
+    const glm::vec3 rayOrigin = glm::vec3(mInvViewMatrix_[3]);
+
+    if (!mPacketTracing_) {
+        for (int y = tileStart.y; y < tileEnd.y; ++y) {
+            for (int x = tileStart.x; x < tileEnd.x; ++x) {
+                const glm::vec3 color = traceRay(rayOrigin, getPrimaryRayDir(x, y, rayOrigin));
+                mPixels_[static_cast<size_t>(y) * mImageSize_.x + x] = glm::vec4(color, 1.0f);
+            }
+        }
+        return;
+    }
+
+    for (int y = tileStart.y; y < tileEnd.y; y += kPacketHeight) {
+        for (int x = tileStart.x; x < tileEnd.x; x += kPacketWidth) {
+            RayPacket packet;
+            packet.activeMask = 0;
+
+            for (int lane = 0; lane < RayPacket::kSize; ++lane) {
+                const int pixelX = x + lane % kPacketWidth;
+                const int pixelY = y + lane / kPacketWidth;
+                // Lanes past the tile edge stay masked out
+                const bool inside = pixelX < tileEnd.x && pixelY < tileEnd.y;
+                const glm::vec3 rayDir = inside ? getPrimaryRayDir(pixelX, pixelY, rayOrigin) : glm::vec3(0.0f, 0.0f, -1.0f);
+
+                packet.originX[lane] = rayOrigin.x;
+                packet.originY[lane] = rayOrigin.y;
+                packet.originZ[lane] = rayOrigin.z;
+                packet.dirX[lane] = rayDir.x;
+                packet.dirY[lane] = rayDir.y;
+                packet.dirZ[lane] = rayDir.z;
+                packet.activeMask |= inside ? (1u << lane) : 0u;
+            }
+
+            glm::vec3 colors[RayPacket::kSize];
+            tracePacket(packet, colors);
+
+            for (int lane = 0; lane < RayPacket::kSize; ++lane) {
+                const int pixelX = x + lane % kPacketWidth;
+                const int pixelY = y + lane / kPacketWidth;
+                if (pixelX < tileEnd.x && pixelY < tileEnd.y) {
+                    mPixels_[static_cast<size_t>(pixelY) * mImageSize_.x + pixelX] = glm::vec4(colors[lane], 1.0f);
+                }
+            }
+        }
+    }
+}
+
+glm::vec3 CpuRayTracer::getPrimaryRayDir(int x, int y, const glm::vec3& rayOrigin) const {
+    // Pixel to NDC, NDC to view space, view space to world space direction
+    const glm::vec2 uv = (glm::vec2(glm::ivec2(x, y)) / glm::vec2(mImageSize_)) * 2.0f - 1.0f;
+    glm::vec4 viewSpacePos = mInvProjMatrix_ * glm::vec4(uv.x, uv.y, -1.0f, 1.0f);
+    viewSpacePos /= viewSpacePos.w;
+    return glm::normalize(glm::vec3(mInvViewMatrix_ * viewSpacePos) - rayOrigin);
+}
+
+void CpuRayTracer::shadeClosestHit(int sphereIdx, const MeshHit& meshHit, float hitT, glm::vec3& rayOrigin, glm::vec3& rayDir, PathState& state) const {
+    // A triangle is only returned when it is closer than the sphere
+    if (meshHit.triangleIdx != -1) {
+        // Triangles are two sided, shade the side facing the ray
+        glm::vec3 normal = mpMeshes_->getWorldNormal(meshHit.instanceIdx, meshHit.triangleIdx);
+        if (glm::dot(normal, rayDir) > 0.0f) {
+            normal = -normal;
+        }
+        const TriangleMesh& mesh = mpMeshes_->getMesh(mpMeshes_->getInstance(meshHit.instanceIdx).meshIdx);
+        shadeHit(normal, mesh.getMaterial(meshHit.triangleIdx), hitT, rayOrigin, rayDir, state);
+    } else {
+        const glm::vec3 hitPoint = rayOrigin + hitT * rayDir;
+        const glm::vec3 normal = glm::normalize(hitPoint - mpSpheres_->getCenter(sphereIdx));
+        shadeHit(normal, mpSpheres_->getMaterial(sphereIdx), hitT, rayOrigin, rayDir, state);
+    }
+}
+
+void CpuRayTracer::shadeHit(const glm::vec3& normal, const SphereMaterial& material, float hitT, glm::vec3& rayOrigin, glm::vec3& rayDir, PathState& state) {
+    const glm::vec3 hitPoint = rayOrigin + hitT * rayDir;
+
+    // Simple lighting (light at (1,1,0))
+    const glm::vec3 lightDir = glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f));
+    const float brightness = std::max(glm::dot(normal, lightDir), 0.0f);
+    const glm::vec3 baseColor = material.color * brightness;
+
+    // Fresnel reflection factor (based on view angle)
+    const float viewDotNormal = std::max(glm::dot(-rayDir, normal), 0.0f);
+    const float reflectFactor = fresnelSchlick(viewDotNormal, material.reflectivity);
+
+    // Reflection direction with a 20% blend towards the normal for curvature
+    glm::vec3 reflectDir = glm::normalize(glm::reflect(rayDir, normal));
+    reflectDir = glm::normalize(glm::mix(reflectDir, normal, 0.2f));
+
+    rayOrigin = hitPoint + reflectDir * 0.001f;
+    rayDir = reflectDir;
+
+    state.accumulatedColor += state.attenuation * glm::mix(baseColor, state.accumulatedColor, reflectFactor);
+    state.attenuation *= material.reflectivity;
+}
+
+glm::vec3 CpuRayTracer::traceRay(glm::vec3 rayOrigin, glm::vec3 rayDir) const {
+    PathState state;
+    tracePath(rayOrigin, rayDir, 0, state);
+    return state.accumulatedColor;
+}
+
+void CpuRayTracer::tracePath(glm::vec3 rayOrigin, glm::vec3 rayDir, int firstBounce, PathState& state) const {
+    for (int bounce = firstBounce; bounce <= kMaxBounces; ++bounce) {
+        float minT;
+        const int closestSphereIndex = findClosestHit(rayOrigin, rayDir, minT);
+        const MeshHit meshHit = findClosestMeshHit(rayOrigin, rayDir, minT);
+
+        // If no intersection, blend with background color
+        if (closestSphereIndex == -1 && meshHit.triangleIdx == -1) {
+            state.accumulatedColor += state.attenuation * kBackgroundColor;
+            break;
+        }
+
+        shadeClosestHit(closestSphereIndex, meshHit, minT, rayOrigin, rayDir, state);
+    }
+}
+
+void CpuRayTracer::tracePacket(RayPacket& packet, glm::vec3* colors) const {
+    // Primary rays are coherent and traverse the hierarchy together
+    findClosestHits(packet);
+
+    for (int lane = 0; lane < RayPacket::kSize; ++lane) {
+        PathState state;
+
+        if ((packet.activeMask & (1u << lane)) != 0) {
+            glm::vec3 rayOrigin(packet.originX[lane], packet.originY[lane], packet.originZ[lane]);
+            glm::vec3 rayDir(packet.dirX[lane], packet.dirY[lane], packet.dirZ[lane]);
+
+            // Triangles are traced per lane, culled by the sphere hit of the packet
+            float minT = packet.hitT[lane];
+            const MeshHit meshHit = findClosestMeshHit(rayOrigin, rayDir, minT);
+
+            if (packet.hitIndex[lane] == -1 && meshHit.triangleIdx == -1) {
+                state.accumulatedColor += state.attenuation * kBackgroundColor;
+            } else {
+                // Reflected rays diverge, so every lane continues on its own
+                shadeClosestHit(packet.hitIndex[lane], meshHit, minT, rayOrigin, rayDir, state);
+                tracePath(rayOrigin, rayDir, 1, state);
+            }
+        }
+
+        colors[lane] = state.accumulatedColor;
+    }
+}
+
+int CpuRayTracer::findClosestHit(const glm::vec3& rayOrigin, const glm::vec3& rayDir, float& minT) const {
+    switch (mBVHWidth_) {
+        case 4:
+            return findClosestHitWide(mBVH4_, rayOrigin, rayDir, minT);
+        case 8:
+            return findClosestHitWide(mBVH8_, rayOrigin, rayDir, minT);
+        default:
+            return findClosestHitBinary(rayOrigin, rayDir, minT);
+    }
+}
+
+int CpuRayTracer::findClosestHitBinary(const glm::vec3& rayOrigin, const glm::vec3& rayDir, float& minT) const {
+    minT = 1e20f;
+    int closestSphereIndex = -1;
+
+    // Only the hot center/radius arrays are touched until the closest hit is known
+    const float* centersX = mpSpheres_->getCentersX();
+    const float* centersY = mpSpheres_->getCentersY();
+    const float* centersZ = mpSpheres_->getCentersZ();
+    const float* radii = mpSpheres_->getRadii();
+
+    traverseBVH(*mpBVH_, rayOrigin, 1.0f / rayDir, minT, [&](uint32_t sphereIdx) {
+        const glm::vec3 center(centersX[sphereIdx], centersY[sphereIdx], centersZ[sphereIdx]);
+        float t;
+        if (intersectSphere(rayOrigin, rayDir, center, radii[sphereIdx], t) && t < minT) {
+            minT = t;
+            closestSphereIndex = static_cast<int>(sphereIdx);
+        }
+    });
+
+    return closestSphereIndex;
+}
+
+CpuRayTracer::MeshHit CpuRayTracer::findClosestMeshHit(const glm::vec3& rayOrigin, const glm::vec3& rayDir, float& minT) const {
+    MeshHit closestHit;
+    if (mpMeshes_ == nullptr || mpMeshes_->empty()) {
+        return closestHit;
+    }
+
+    traverseBVH(mpMeshes_->getTopLevel(), rayOrigin, 1.0f / rayDir, minT, [&](uint32_t instanceIdx) {
+        const MeshInstance& instance = mpMeshes_->getInstance(instanceIdx);
+        const TriangleMesh& mesh = mpMeshes_->getMesh(instance.meshIdx);
+
+        // The direction is not normalized in object space, so hit distances stay comparable with world space ones
+        const glm::vec3 objectOrigin = glm::vec3(instance.worldToObject * glm::vec4(rayOrigin, 1.0f));
+        const glm::vec3 objectDir = glm::vec3(instance.worldToObject * glm::vec4(rayDir, 0.0f));
+        const TriangleRay ray(objectOrigin, objectDir);
+
+        traverseBVH(mpMeshes_->getMeshBVH(instance.meshIdx), objectOrigin, 1.0f / objectDir, minT, [&](uint32_t triangleIdx) {
+            float t;
+            if (TriangleMesh::intersect(ray, mesh.getVertex(triangleIdx, 0), mesh.getVertex(triangleIdx, 1),
+                                        mesh.getVertex(triangleIdx, 2), t) && t < minT) {
+                minT = t;
+                closestHit = {static_cast<int>(instanceIdx), static_cast<int>(triangleIdx)};
+            }
+        });
+    });
+
+    return closestHit;
+}
+
+template<int Width>
+int CpuRayTracer::findClosestHitWide(const WideBVH<Width>& bvh, const glm::vec3& rayOrigin, const glm::vec3& rayDir, float& minT) const {
+    minT = 1e20f;
+    int closestSphereIndex = -1;
+    if (bvh.empty()) {
+        return -1;
+    }
+
+    const std::vector<typename WideBVH<Width>::Node>& nodes = bvh.getNodes();
+    const std::vector<uint32_t>& primIndices = bvh.getPrimIndices();
+    const glm::vec3 invRayDir = 1.0f / rayDir;
+
+    const float* centersX = mpSpheres_->getCentersX();
+    const float* centersY = mpSpheres_->getCentersY();
+    const float* centersZ = mpSpheres_->getCentersZ();
+    const float* radii = mpSpheres_->getRadii();
+
+    // Nodes waiting to be visited with the distance they are entered at
+    struct StackEntry {
+        int32_t nodeIdx;
+        float tEntry;
+    };
+    StackEntry stack[BVH::kMaxStackDepth * Width];
+    int stackSize = 0;
+    stack[stackSize++] = {0, 0.0f};
+
+    alignas(32) float tEntry[Width];
+    StackEntry innerChildren[Width];
+
+    while (stackSize > 0) {
+        const StackEntry entry = stack[--stackSize];
+        if (entry.tEntry >= minT) {
+            continue;
+        }
+
+        const typename WideBVH<Width>::Node& node = nodes[entry.nodeIdx];
+        uint32_t hitMask = bvh.intersectChildren(node, rayOrigin, invRayDir, minT, tEntry);
+
+        // Leaves are intersected right away so a closer hit can cull the inner children
+        int innerCount = 0;
+        while (hitMask != 0) {
+            const int child = std::countr_zero(hitMask);
+            hitMask &= hitMask - 1;
+            if (node.childCount[child] == 0) {
+                innerChildren[innerCount++] = {node.childIndex[child], tEntry[child]};
+                continue;
+            }
+            for (int32_t i = 0; i < node.childCount[child]; ++i) {
+                const uint32_t sphereIdx = primIndices[node.childIndex[child] + i];
+                const glm::vec3 center(centersX[sphereIdx], centersY[sphereIdx], centersZ[sphereIdx]);
+                float t;
+                if (intersectSphere(rayOrigin, rayDir, center, radii[sphereIdx], t) && t < minT) {
+                    minT = t;
+                    closestSphereIndex = static_cast<int>(sphereIdx);
+                }
+            }
+        }
+
+        // Push the farthest first so the nearest inner child is visited next
+        std::sort(innerChildren, innerChildren + innerCount, [](const StackEntry& a, const StackEntry& b) {
+            return a.tEntry > b.tEntry;
+        });
+        for (int i = 0; i < innerCount; ++i) {
+            if (innerChildren[i].tEntry < minT) {
+                stack[stackSize++] = innerChildren[i];
+            }
+        }
+    }
+
+    return closestSphereIndex;
+}
+
+void CpuRayTracer::findClosestHits(RayPacket& packet) const {
+    alignas(32) float invDirX[RayPacket::kSize];
+    alignas(32) float invDirY[RayPacket::kSize];
+    alignas(32) float invDirZ[RayPacket::kSize];
+    for (int lane = 0; lane < RayPacket::kSize; ++lane) {
+        packet.hitT[lane] = 1e20f;
+        packet.hitIndex[lane] = -1;
+        invDirX[lane] = 1.0f / packet.dirX[lane];
+        invDirY[lane] = 1.0f / packet.dirY[lane];
+        invDirZ[lane] = 1.0f / packet.dirZ[lane];
+    }
+
+    const std::vector<BVHNode>& nodes = mpBVH_->getNodes();
+    const std::vector<uint32_t>& primIndices = mpBVH_->getPrimIndices();
+    if (nodes.empty()) {
+        return;
+    }
+
+    // Closest entry distance of any active lane, so a node is skipped only once every lane misses it
+    const auto intersectPacketNode = [&](const BVHNode& node) {
+        float nearestT = BVH::kMiss;
+        for (int lane = 0; lane < RayPacket::kSize; ++lane) {
+            if ((packet.activeMask & (1u << lane)) != 0) {
+                const glm::vec3 rayOrigin(packet.originX[lane], packet.originY[lane], packet.originZ[lane]);
+                const glm::vec3 invRayDir(invDirX[lane], invDirY[lane], invDirZ[lane]);
+                nearestT = std::min(nearestT, BVH::intersectNode(rayOrigin, invRayDir, node, packet.hitT[lane]));
+            }
+        }
+        return nearestT;
+    };
+
+    if (intersectPacketNode(nodes[0]) == BVH::kMiss) {
+        return;
+    }
+
+    const float* centersX = mpSpheres_->getCentersX();
+    const float* centersY = mpSpheres_->getCentersY();
+    const float* centersZ = mpSpheres_->getCentersZ();
+    const float* radii = mpSpheres_->getRadii();
+
+    int32_t stack[BVH::kMaxStackDepth];
+    int stackSize = 0;
+    int32_t nodeIdx = 0;
+
+    while (true) {
+        const BVHNode& node = nodes[nodeIdx];
+        if (node.isLeaf()) {
+            for (int32_t i = 0; i < node.count; ++i) {
+                const uint32_t sphereIdx = primIndices[node.leftFirst + i];
+                const glm::vec3 center(centersX[sphereIdx], centersY[sphereIdx], centersZ[sphereIdx]);
+                mIntersector_.intersect(packet, center, radii[sphereIdx], static_cast<int>(sphereIdx));
+            }
+        } else {
+            int32_t nearIdx = node.leftFirst;
+            int32_t farIdx = node.leftFirst + 1;
+            float nearT = intersectPacketNode(nodes[nearIdx]);
+            float farT = intersectPacketNode(nodes[farIdx]);
+            if (nearT > farT) {
+                std::swap(nearIdx, farIdx);
+                std::swap(nearT, farT);
+            }
+            if (nearT != BVH::kMiss) {
+                if (farT != BVH::kMiss) {
+                    stack[stackSize++] = farIdx;
+                }
+                nodeIdx = nearIdx;
+                continue;
+            }
+        }
+
+        if (stackSize == 0) {
+            break;
+        }
+        nodeIdx = stack[--stackSize];
+    }
+}
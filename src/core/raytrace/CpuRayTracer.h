@@ -0,0 +1,191 @@
+#pragma once
+// standard lib
+#include <vector>
+// third party
+#include <glm/glm.hpp>
+// project
+#include "core/ThreadPool.h"
+#include "core/raytrace/AccelerationStructure.h"
+#include "core/raytrace/BVH.h"
+#include "core/raytrace/PacketIntersector.h"
+#include "core/raytrace/RayPacket.h"
+#include "core/raytrace/SphereSet.h"
+#include "core/raytrace/WideBVH.h"
+
+/**
+ * CPU implementation of the sphere tracer in ray_trace_multi.glsl. The frame is split into tiles which are
+ * distributed over a work-stealing thread pool.
+ */
+class CpuRayTracer {
+public:
+    /**
+     * Constructor
+     * @param threadPool Pool the tiles are rendered on, shared with the rest of the scene so the cores are not
+     * oversubscribed. Must outlive the tracer
+     */
+    explicit CpuRayTracer(ThreadPool& threadPool);
+
+    /**
+     * Set the spheres to trace against. They are not copied, call again whenever the BVH is rebuilt
+     * @param pSpheres Scene spheres, must outlive the tracer
+     * @param pBVH Hierarchy built over the spheres, must outlive the tracer
+     */
+    void setSpheres(const SphereSet* pSpheres, const BVH* pBVH);
+
+    /** Update the wide BVH after the spheres moved and the BVH passed to setSpheres was refit */
+    void refitBVH();
+
+    /**
+     * Set the instanced meshes to trace against. They are not copied, so moved instances are picked up once the
+     * top level is rebuilt
+     * @param pMeshes Scene meshes, must outlive the tracer. nullptr for none
+     */
+    void setMeshes(const AccelerationStructure* pMeshes);
+
+    /**
+     * Trace a frame. The result is stored row by row starting from the bottom row to match GL texture layout
+     * @param invViewMatrix Inverse of the camera view matrix
+     * @param invProjMatrix Inverse of the camera projection matrix
+     * @param imageSize Output image size in pixels
+     */
+    void render(const glm::mat4& invViewMatrix, const glm::mat4& invProjMatrix, const glm::ivec2& imageSize);
+
+    /** Get the pixels of the last rendered frame (RGBA32F) */
+    const std::vector<glm::vec4>& getPixels() const;
+
+    /** Get the number of threads rendering the tiles */
+    unsigned int getThreadCount() const;
+
+    /**
+     * Enable tracing coherent 4x2 pixel blocks as SIMD ray packets instead of one ray at a time
+     * @param enabled Packet tracing status
+     */
+    void setPacketTracing(bool enabled);
+
+    /** If rays are traced as SIMD packets */
+    bool isPacketTracing() const;
+
+    /** Get the instruction set used by the packet kernel */
+    PacketIntersector::SimdLevel getSimdLevel() const;
+
+    /**
+     * Set the number of children per node of the hierarchy traced by single rays. The binary BVH is collapsed
+     * into a 4 or 8 wide one whose children are tested together with SIMD. Packets always trace the binary BVH
+     * @param width 2, 4 or 8
+     */
+    void setBVHWidth(int width);
+
+    /** Get the number of children per node traced by single rays */
+    int getBVHWidth() const;
+
+private:
+    /** Triangle of a mesh instance hit by a ray */
+    struct MeshHit {
+        int instanceIdx = -1;
+        int triangleIdx = -1;
+    };
+
+    /** Color and attenuation carried along a path */
+    struct PathState {
+        glm::vec3 accumulatedColor = glm::vec3(0.0f);
+        glm::vec3 attenuation = glm::vec3(1.0f);
+    };
+
+    /** Render the pixels of the tile starting at the given pixel */
+    void renderTile(const glm::ivec2& tileStart);
+
+    /** Trace a single ray through the scene with reflections */
+    glm::vec3 traceRay(glm::vec3 rayOrigin, glm::vec3 rayDir) const;
+
+    /**
+     * Continue a path from the given bounce until it leaves the scene or runs out of bounces
+     * @param rayOrigin Ray origin
+     * @param rayDir Ray direction
+     * @param firstBounce Bounce the ray starts at
+     * @param state Path color state, updated in place
+     */
+    void tracePath(glm::vec3 rayOrigin, glm::vec3 rayDir, int firstBounce, PathState& state) const;
+
+    /** Shade the closest of a sphere and a mesh hit, the mesh wins when it is set */
+    void shadeClosestHit(int sphereIdx, const MeshHit& meshHit, float hitT, glm::vec3& rayOrigin, glm::vec3& rayDir, PathState& state) const;
+
+    /** Accumulate the hit color and replace the ray with its reflection */
+    static void shadeHit(const glm::vec3& normal, const SphereMaterial& material, float hitT, glm::vec3& rayOrigin, glm::vec3& rayDir, PathState& state);
+
+    /**
+     * Trace the active lanes of a packet of primary rays. The packet traverses the hierarchy together with
+     * inactive lanes masked out, the reflections continue per lane
+     * @param packet Primary rays
+     * @param colors Output color per lane
+     */
+    void tracePacket(RayPacket& packet, glm::vec3* colors) const;
+
+    /**
+     * Find the closest sphere hit by a ray
+     * @param rayOrigin Ray origin
+     * @param rayDir Ray direction
+     * @param minT Output distance to the hit
+     * @return Index of the hit sphere, -1 for none
+     */
+    int findClosestHit(const glm::vec3& rayOrigin, const glm::vec3& rayDir, float& minT) const;
+
+    /**
+     * Find the closest triangle of the mesh instances hit by a ray that is closer than minT. The top level is
+     * traversed in world space, the mesh of every instance reached in its object space
+     * @param rayOrigin Ray origin
+     * @param rayDir Ray direction
+     * @param minT Closest hit so far, lowered on a closer triangle hit
+     * @return Instance and triangle hit, -1 for none
+     */
+    MeshHit findClosestMeshHit(const glm::vec3& rayOrigin, const glm::vec3& rayDir, float& minT) const;
+
+    /** findClosestHit through the binary BVH */
+    int findClosestHitBinary(const glm::vec3& rayOrigin, const glm::vec3& rayDir, float& minT) const;
+
+    /** findClosestHit through a wide BVH */
+    template<int Width>
+    int findClosestHitWide(const WideBVH<Width>& bvh, const glm::vec3& rayOrigin, const glm::vec3& rayDir, float& minT) const;
+
+    /** Collapse the binary BVH for the selected width */
+    void collapseBVH();
+
+    /** Find the closest sphere hit by every active lane of the packet, stored in hitT/hitIndex */
+    void findClosestHits(RayPacket& packet) const;
+
+    /** Get the world space primary ray direction through the given pixel */
+    glm::vec3 getPrimaryRayDir(int x, int y, const glm::vec3& rayOrigin) const;
+
+    /** Tile width and height in pixels */
+    static constexpr int kTileSize = 16;
+    /** Number of reflections allowed */
+    static constexpr int kMaxBounces = 8;
+    /** Packet footprint in pixels */
+    static constexpr int kPacketWidth = 4;
+    static constexpr int kPacketHeight = RayPacket::kSize / kPacketWidth;
+
+    const SphereSet* mpSpheres_ = nullptr;
+
+    const BVH* mpBVH_ = nullptr;
+
+    WideBVH<4> mBVH4_;
+
+    WideBVH<8> mBVH8_;
+
+    int mBVHWidth_ = 8;
+
+    const AccelerationStructure* mpMeshes_ = nullptr;
+
+    std::vector<glm::vec4> mPixels_;
+
+    glm::ivec2 mImageSize_ = {0, 0};
+
+    glm::mat4 mInvViewMatrix_ = glm::mat4(1.0f);
+
+    glm::mat4 mInvProjMatrix_ = glm::mat4(1.0f);
+
+    bool mPacketTracing_ = true;
+
+    PacketIntersector mIntersector_;
+
+    ThreadPool& mThreadPool_;
+};
@@ -0,0 +1,118 @@
+// standard lib
+#include <algorithm>
+// third party
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GL/gl.h>
+// project
+#include "core/raytrace/GpuLBVHBuilder.h"
+#include "core/raytrace/BVH.h"
+
+
+GpuLBVHBuilder::GpuLBVHBuilder(Resources& resources)
+    : mRadixSort_(resources) {
+    mpSceneBoundsProgram_ = resources.getResource<ShaderProgram>("LBVHSceneBounds");
+    mpMortonProgram_ = resources.getResource<ShaderProgram>("LBVHMorton");
+    mpHierarchyProgram_ = resources.getResource<ShaderProgram>("LBVHHierarchy");
+    mpNodeBoundsProgram_ = resources.getResource<ShaderProgram>("LBVHNodeBounds");
+
+    glGenBuffers(1, &mNodeSSBO_);
+    glGenBuffers(1, &mPrimIndexSSBO_);
+    glGenBuffers(1, &mMortonSSBO_);
+    glGenBuffers(1, &mNodeLinkSSBO_);
+    glGenBuffers(1, &mVisitCountSSBO_);
+    glGenBuffers(1, &mSceneBoundsSSBO_);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mSceneBoundsSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 6 * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+}
+
+GpuLBVHBuilder::~GpuLBVHBuilder() {
+    glDeleteBuffers(1, &mNodeSSBO_);
+    glDeleteBuffers(1, &mPrimIndexSSBO_);
+    glDeleteBuffers(1, &mMortonSSBO_);
+    glDeleteBuffers(1, &mNodeLinkSSBO_);
+    glDeleteBuffers(1, &mVisitCountSSBO_);
+    glDeleteBuffers(1, &mSceneBoundsSSBO_);
+}
+
+void GpuLBVHBuilder::build(unsigned int sphereGeometrySSBO, uint32_t sphereCount) {
+    mNodeCount_ = 0;
+    if (sphereCount == 0) {
+        return;
+    }
+    reserve(sphereCount);
+    mNodeCount_ = 2 * sphereCount - 1;
+
+    const uint32_t leafGroups = (sphereCount + kWorkGroupSize - 1) / kWorkGroupSize;
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, sphereGeometrySSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, mSceneBoundsSSBO_);
+
+    // Centroid bounds, starting from an empty box in the ordered uint encoding
+    const uint32_t emptyBounds[6] = {0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu, 0u, 0u, 0u};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mSceneBoundsSSBO_);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(emptyBounds), emptyBounds);
+
+    mpSceneBoundsProgram_->bind();
+    mpSceneBoundsProgram_->setUInt("numSpheres", sphereCount);
+    glDispatchCompute(leafGroups, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // Morton codes and the identity sphere order
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, mPrimIndexSSBO_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, mMortonSSBO_);
+    mpMortonProgram_->bind();
+    mpMortonProgram_->setUInt("numSpheres", sphereCount);
+    glDispatchCompute(leafGroups, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    mRadixSort_.sort(mMortonSSBO_, mPrimIndexSSBO_, sphereCount, 30);
+
+    // The sort only uses its own bindings (24-29), the sorted codes and sphere order are still bound to 5 and 4
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, mNodeSSBO_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, mNodeLinkSSBO_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, mVisitCountSSBO_);
+
+    if (sphereCount > 1) {
+        mpHierarchyProgram_->bind();
+        mpHierarchyProgram_->setUInt("numSpheres", sphereCount);
+        glDispatchCompute((sphereCount - 1 + kWorkGroupSize - 1) / kWorkGroupSize, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    mpNodeBoundsProgram_->bind();
+    mpNodeBoundsProgram_->setUInt("numSpheres", sphereCount);
+    glDispatchCompute(leafGroups, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+unsigned int GpuLBVHBuilder::getNodeBuffer() const {
+    return mNodeSSBO_;
+}
+
+unsigned int GpuLBVHBuilder::getPrimIndexBuffer() const {
+    return mPrimIndexSSBO_;
+}
+
+uint32_t GpuLBVHBuilder::getNodeCount() const {
+    return mNodeCount_;
+}
+
+void GpuLBVHBuilder::reserve(uint32_t count) {
+    if (count <= mCapacity_) {
+        return;
+    }
+    mCapacity_ = count;
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mNodeSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (2 * count - 1) * sizeof(BVHNode), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mPrimIndexSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mMortonSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mNodeLinkSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (2 * count - 1) * 2 * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mVisitCountSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(count - 1, 1u) * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+}
@@ -0,0 +1,73 @@
+#pragma once
+// standard lib
+#include <cstdint>
+// project
+#include "core/application/Resources.h"
+#include "core/graphics/GpuRadixSort.h"
+
+/**
+ * Linear BVH builder running entirely in compute shaders (Karras 2012). Sphere centers are sorted along a 30 bit
+ * Morton curve and the hierarchy is emitted from the sorted codes, so a scene that moves every frame can be
+ * rebuilt without reading anything back to the CPU.
+ * The output uses the BVHNode and prim index layouts of the CPU BVH, with one sphere per leaf, so the ray trace
+ * shader reads either tree the same way
+ */
+class GpuLBVHBuilder {
+public:
+    /**
+     * Constructor
+     * @param resources Resources holding the LBVH and radix sort programs
+     */
+    explicit GpuLBVHBuilder(Resources& resources);
+
+    ~GpuLBVHBuilder();
+
+    GpuLBVHBuilder(const GpuLBVHBuilder&) = delete;
+    GpuLBVHBuilder& operator=(const GpuLBVHBuilder&) = delete;
+
+    /**
+     * Build the hierarchy over the spheres of a geometry buffer
+     * @param sphereGeometrySSBO Buffer of vec4 spheres (xyz = center, w = radius)
+     * @param sphereCount Number of spheres in the buffer
+     */
+    void build(unsigned int sphereGeometrySSBO, uint32_t sphereCount);
+
+    /** Get the buffer of BVHNodes, 2 * sphereCount - 1 of them */
+    unsigned int getNodeBuffer() const;
+
+    /** Get the buffer of sphere indices referenced by the leaves */
+    unsigned int getPrimIndexBuffer() const;
+
+    /** Get the number of nodes of the last build */
+    uint32_t getNodeCount() const;
+
+private:
+    /** Grow the buffers to hold a tree over count spheres */
+    void reserve(uint32_t count);
+
+    /** Invocations per workgroup of every LBVH program */
+    static constexpr uint32_t kWorkGroupSize = 256;
+
+    GpuRadixSort mRadixSort_;
+
+    ShaderProgram* mpSceneBoundsProgram_ = nullptr;
+    ShaderProgram* mpMortonProgram_ = nullptr;
+    ShaderProgram* mpHierarchyProgram_ = nullptr;
+    ShaderProgram* mpNodeBoundsProgram_ = nullptr;
+
+    /** Output nodes (binding 3) */
+    unsigned int mNodeSSBO_ = 0;
+    /** Sphere indices in Morton order (binding 4) */
+    unsigned int mPrimIndexSSBO_ = 0;
+    /** Morton codes, sorted along with the sphere indices (binding 5) */
+    unsigned int mMortonSSBO_ = 0;
+    /** Slot and parent of every inner node and leaf (binding 10) */
+    unsigned int mNodeLinkSSBO_ = 0;
+    /** Arrival counters of the bottom-up bounds pass (binding 11) */
+    unsigned int mVisitCountSSBO_ = 0;
+    /** Bounds of the sphere centers (binding 12) */
+    unsigned int mSceneBoundsSSBO_ = 0;
+
+    uint32_t mCapacity_ = 0;
+    uint32_t mNodeCount_ = 0;
+};
@@ -0,0 +1,272 @@
+// standard lib
+#include <cmath>
+// project
+#include "core/raytrace/PacketIntersector.h"
+#include "core/raytrace/SimdTarget.h"
+
+namespace {
+    void intersectScalar(RayPacket& packet, const glm::vec3& center, float radius, int sphereIdx) {
+        for (int lane = 0; lane < RayPacket::kSize; ++lane) {
+            if ((packet.activeMask & (1u << lane)) == 0) {
+                continue;
+            }
+            const glm::vec3 rayDir(packet.dirX[lane], packet.dirY[lane], packet.dirZ[lane]);
+            const glm::vec3 oc = glm::vec3(packet.originX[lane], packet.originY[lane], packet.originZ[lane]) - center;
+            const float a = glm::dot(rayDir, rayDir);
+            const float b = 2.0f * glm::dot(oc, rayDir);
+            const float c = glm::dot(oc, oc) - radius * radius;
+            const float discriminant = b * b - 4.0f * a * c;
+
+            if (discriminant < 0.0f) {
+                continue;
+            }
+
+            const float sqrtD = std::sqrt(discriminant);
+            const float t0 = (-b - sqrtD) / (2.0f * a);
+            const float t1 = (-b + sqrtD) / (2.0f * a);
+            const float t = (t0 > 0.0f) ? t0 : t1;
+
+            if (t > 0.0f && t < packet.hitT[lane]) {
+                packet.hitT[lane] = t;
+                packet.hitIndex[lane] = sphereIdx;
+            }
+        }
+    }
+
+#ifdef RT_X86
+    RT_TARGET("sse4.2")
+    void intersectSse(RayPacket& packet, const glm::vec3& center, float radius, int sphereIdx) {
+        const __m128 centerX = _mm_set1_ps(center.x);
+        const __m128 centerY = _mm_set1_ps(center.y);
+        const __m128 centerZ = _mm_set1_ps(center.z);
+        const __m128 radiusSq = _mm_set1_ps(radius * radius);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 two = _mm_set1_ps(2.0f);
+        const __m128 four = _mm_set1_ps(4.0f);
+        const __m128 index = _mm_castsi128_ps(_mm_set1_epi32(sphereIdx));
+        const __m128i laneBits = _mm_setr_epi32(1, 2, 4, 8);
+
+        // Two 4-wide halves of the packet
+        for (int base = 0; base < RayPacket::kSize; base += 4) {
+            const int laneMask = (packet.activeMask >> base) & 0xF;
+            if (laneMask == 0) {
+                continue;
+            }
+            const __m128 active = _mm_castsi128_ps(
+                _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(laneMask), laneBits), laneBits)
+            );
+
+            const __m128 dirX = _mm_load_ps(packet.dirX + base);
+            const __m128 dirY = _mm_load_ps(packet.dirY + base);
+            const __m128 dirZ = _mm_load_ps(packet.dirZ + base);
+            const __m128 ocX = _mm_sub_ps(_mm_load_ps(packet.originX + base), centerX);
+            const __m128 ocY = _mm_sub_ps(_mm_load_ps(packet.originY + base), centerY);
+            const __m128 ocZ = _mm_sub_ps(_mm_load_ps(packet.originZ + base), centerZ);
+
+            const __m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dirX, dirX), _mm_mul_ps(dirY, dirY)), _mm_mul_ps(dirZ, dirZ));
+            const __m128 b = _mm_mul_ps(two,
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocX, dirX), _mm_mul_ps(ocY, dirY)), _mm_mul_ps(ocZ, dirZ))
+            );
+            const __m128 c = _mm_sub_ps(
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocX, ocX), _mm_mul_ps(ocY, ocY)), _mm_mul_ps(ocZ, ocZ)),
+                radiusSq
+            );
+            const __m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(_mm_mul_ps(four, a), c));
+            const __m128 valid = _mm_and_ps(active, _mm_cmpge_ps(discriminant, zero));
+            if (_mm_movemask_ps(valid) == 0) {
+                continue;
+            }
+
+            const __m128 sqrtD = _mm_sqrt_ps(_mm_max_ps(discriminant, zero));
+            const __m128 negB = _mm_sub_ps(zero, b);
+            const __m128 twoA = _mm_mul_ps(two, a);
+            const __m128 t0 = _mm_div_ps(_mm_sub_ps(negB, sqrtD), twoA);
+            const __m128 t1 = _mm_div_ps(_mm_add_ps(negB, sqrtD), twoA);
+            const __m128 t = _mm_blendv_ps(t1, t0, _mm_cmpgt_ps(t0, zero));
+
+            const __m128 hitT = _mm_load_ps(packet.hitT + base);
+            const __m128 hit = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, hitT)));
+
+            const __m128 hitIndex = _mm_load_ps(reinterpret_cast<const float*>(packet.hitIndex + base));
+            _mm_store_ps(packet.hitT + base, _mm_blendv_ps(hitT, t, hit));
+            _mm_store_ps(reinterpret_cast<float*>(packet.hitIndex + base), _mm_blendv_ps(hitIndex, index, hit));
+        }
+    }
+
+    RT_TARGET("avx2")
+    void intersectAvx2(RayPacket& packet, const glm::vec3& center, float radius, int sphereIdx) {
+        const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        const __m256 active = _mm256_castsi256_ps(
+            _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<int>(packet.activeMask)), laneBits), laneBits)
+        );
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 two = _mm256_set1_ps(2.0f);
+
+        const __m256 dirX = _mm256_load_ps(packet.dirX);
+        const __m256 dirY = _mm256_load_ps(packet.dirY);
+        const __m256 dirZ = _mm256_load_ps(packet.dirZ);
+        const __m256 ocX = _mm256_sub_ps(_mm256_load_ps(packet.originX), _mm256_set1_ps(center.x));
+        const __m256 ocY = _mm256_sub_ps(_mm256_load_ps(packet.originY), _mm256_set1_ps(center.y));
+        const __m256 ocZ = _mm256_sub_ps(_mm256_load_ps(packet.originZ), _mm256_set1_ps(center.z));
+
+        const __m256 a = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dirX, dirX), _mm256_mul_ps(dirY, dirY)), _mm256_mul_ps(dirZ, dirZ));
+        const __m256 b = _mm256_mul_ps(two,
+            _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocX, dirX), _mm256_mul_ps(ocY, dirY)), _mm256_mul_ps(ocZ, dirZ))
+        );
+        const __m256 c = _mm256_sub_ps(
+            _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocX, ocX), _mm256_mul_ps(ocY, ocY)), _mm256_mul_ps(ocZ, ocZ)),
+            _mm256_set1_ps(radius * radius)
+        );
+        const __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(4.0f), a), c));
+        const __m256 valid = _mm256_and_ps(active, _mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ));
+        if (_mm256_movemask_ps(valid) == 0) {
+            return;
+        }
+
+        const __m256 sqrtD = _mm256_sqrt_ps(_mm256_max_ps(discriminant, zero));
+        const __m256 negB = _mm256_sub_ps(zero, b);
+        const __m256 twoA = _mm256_mul_ps(two, a);
+        const __m256 t0 = _mm256_div_ps(_mm256_sub_ps(negB, sqrtD), twoA);
+        const __m256 t1 = _mm256_div_ps(_mm256_add_ps(negB, sqrtD), twoA);
+        const __m256 t = _mm256_blendv_ps(t1, t0, _mm256_cmp_ps(t0, zero, _CMP_GT_OQ));
+
+        const __m256 hitT = _mm256_load_ps(packet.hitT);
+        const __m256 hit = _mm256_and_ps(valid,
+            _mm256_and_ps(_mm256_cmp_ps(t, zero, _CMP_GT_OQ), _mm256_cmp_ps(t, hitT, _CMP_LT_OQ))
+        );
+
+        const __m256 hitIndex = _mm256_load_ps(reinterpret_cast<const float*>(packet.hitIndex));
+        _mm256_store_ps(packet.hitT, _mm256_blendv_ps(hitT, t, hit));
+        _mm256_store_ps(reinterpret_cast<float*>(packet.hitIndex),
+            _mm256_blendv_ps(hitIndex, _mm256_castsi256_ps(_mm256_set1_epi32(sphereIdx)), hit)
+        );
+    }
+
+    RT_TARGET("avx512f,avx512vl")
+    void intersectAvx512(RayPacket& packet, const glm::vec3& center, float radius, int sphereIdx) {
+        // Lane predicates live in mask registers instead of blend vectors
+        const __mmask8 active = static_cast<__mmask8>(packet.activeMask);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 two = _mm256_set1_ps(2.0f);
+
+        const __m256 dirX = _mm256_load_ps(packet.dirX);
+        const __m256 dirY = _mm256_load_ps(packet.dirY);
+        const __m256 dirZ = _mm256_load_ps(packet.dirZ);
+        const __m256 ocX = _mm256_sub_ps(_mm256_load_ps(packet.originX), _mm256_set1_ps(center.x));
+        const __m256 ocY = _mm256_sub_ps(_mm256_load_ps(packet.originY), _mm256_set1_ps(center.y));
+        const __m256 ocZ = _mm256_sub_ps(_mm256_load_ps(packet.originZ), _mm256_set1_ps(center.z));
+
+        const __m256 a = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dirX, dirX), _mm256_mul_ps(dirY, dirY)), _mm256_mul_ps(dirZ, dirZ));
+        const __m256 b = _mm256_mul_ps(two,
+            _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocX, dirX), _mm256_mul_ps(ocY, dirY)), _mm256_mul_ps(ocZ, dirZ))
+        );
+        const __m256 c = _mm256_sub_ps(
+            _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocX, ocX), _mm256_mul_ps(ocY, ocY)), _mm256_mul_ps(ocZ, ocZ)),
+            _mm256_set1_ps(radius * radius)
+        );
+        const __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(4.0f), a), c));
+        const __mmask8 valid = _mm256_mask_cmp_ps_mask(active, discriminant, zero, _CMP_GE_OQ);
+        if (valid == 0) {
+            return;
+        }
+
+        const __m256 sqrtD = _mm256_sqrt_ps(_mm256_max_ps(discriminant, zero));
+        const __m256 negB = _mm256_sub_ps(zero, b);
+        const __m256 twoA = _mm256_mul_ps(two, a);
+        const __m256 t0 = _mm256_div_ps(_mm256_sub_ps(negB, sqrtD), twoA);
+        const __m256 t1 = _mm256_div_ps(_mm256_add_ps(negB, sqrtD), twoA);
+        const __m256 t = _mm256_mask_blend_ps(_mm256_cmp_ps_mask(t0, zero, _CMP_GT_OQ), t1, t0);
+
+        const __mmask8 positive = _mm256_mask_cmp_ps_mask(valid, t, zero, _CMP_GT_OQ);
+        const __mmask8 hit = _mm256_mask_cmp_ps_mask(positive, t, _mm256_load_ps(packet.hitT), _CMP_LT_OQ);
+
+        _mm256_mask_store_ps(packet.hitT, hit, t);
+        _mm256_mask_store_epi32(packet.hitIndex, hit, _mm256_set1_epi32(sphereIdx));
+    }
+#endif
+}
+
+PacketIntersector::PacketIntersector(SimdLevel level) {
+    const SimdLevel supported = detectSimdLevel();
+    mSimdLevel_ = (static_cast<int>(level) > static_cast<int>(supported)) ? supported : level;
+
+    switch (mSimdLevel_) {
+#ifdef RT_X86
+        case SimdLevel::SSE4_2:
+            mIntersectFn_ = intersectSse;
+            break;
+        case SimdLevel::AVX2:
+            mIntersectFn_ = intersectAvx2;
+            break;
+        case SimdLevel::AVX512:
+            mIntersectFn_ = intersectAvx512;
+            break;
+#endif
+        default:
+            mIntersectFn_ = intersectScalar;
+            break;
+    }
+}
+
+void PacketIntersector::intersect(RayPacket& packet, const glm::vec3& center, float radius, int sphereIdx) const {
+    mIntersectFn_(packet, center, radius, sphereIdx);
+}
+
+PacketIntersector::SimdLevel PacketIntersector::getSimdLevel() const {
+    return mSimdLevel_;
+}
+
+PacketIntersector::SimdLevel PacketIntersector::detectSimdLevel() {
+#if defined(RT_X86) && defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    const bool sse42 = (info[2] & (1 << 20)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    // Check the OS saves the AVX (and AVX-512) register state on context switches
+    const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    const bool osAvx = (xcr0 & 0x6) == 0x6;
+    const bool osAvx512 = (xcr0 & 0xE6) == 0xE6;
+
+    bool avx2 = false;
+    bool avx512 = false;
+    if (maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = osAvx && (info[1] & (1 << 5)) != 0;
+        avx512 = osAvx512 && (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 31)) != 0;
+    }
+
+    if (avx512) {
+        return SimdLevel::AVX512;
+    } else if (avx2) {
+        return SimdLevel::AVX2;
+    } else if (sse42) {
+        return SimdLevel::SSE4_2;
+    }
+#elif defined(RT_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")) {
+        return SimdLevel::AVX512;
+    } else if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::AVX2;
+    } else if (__builtin_cpu_supports("sse4.2")) {
+        return SimdLevel::SSE4_2;
+    }
+#endif
+    return SimdLevel::SCALAR;
+}
+
+const char* PacketIntersector::getSimdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::SSE4_2:
+            return "SSE4.2";
+        case SimdLevel::AVX2:
+            return "AVX2";
+        case SimdLevel::AVX512:
+            return "AVX-512";
+        default:
+            return "Scalar";
+    }
+}
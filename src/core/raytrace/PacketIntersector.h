@@ -0,0 +1,48 @@
+#pragma once
+// third party
+#include <glm/glm.hpp>
+// project
+#include "core/raytrace/RayPacket.h"
+
+/**
+ * Vectorized ray packet vs sphere intersection. The instruction set is picked at runtime from what the CPU
+ * supports, so the binary does not need to be compiled for a specific target.
+ */
+class PacketIntersector {
+public:
+    /** Instruction set used by the kernel */
+    enum class SimdLevel {
+        SCALAR=0, SSE4_2, AVX2, AVX512
+    };
+
+    /**
+     * Constructor
+     * @param level Instruction set to use. Clamped to what the CPU supports
+     */
+    explicit PacketIntersector(SimdLevel level = detectSimdLevel());
+
+    /**
+     * Test the active rays of the packet against one sphere and record closer hits in hitT/hitIndex
+     * @param packet Rays to test
+     * @param center Sphere center
+     * @param radius Sphere radius
+     * @param sphereIdx Index written to hitIndex on a closer hit
+     */
+    void intersect(RayPacket& packet, const glm::vec3& center, float radius, int sphereIdx) const;
+
+    /** Get the instruction set used by this intersector */
+    SimdLevel getSimdLevel() const;
+
+    /** Get the widest instruction set supported by the CPU */
+    static SimdLevel detectSimdLevel();
+
+    /** Get a display name for the instruction set */
+    static const char* getSimdLevelName(SimdLevel level);
+
+private:
+    using IntersectFn = void(*)(RayPacket&, const glm::vec3&, float, int);
+
+    SimdLevel mSimdLevel_;
+
+    IntersectFn mIntersectFn_;
+};
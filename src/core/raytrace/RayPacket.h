@@ -0,0 +1,25 @@
+#pragma once
+// standard lib
+#include <cstdint>
+
+/**
+ * Structure of arrays packet of coherent rays. Lanes are laid out so a whole packet component can be
+ * loaded with one aligned 256 bit load.
+ */
+struct alignas(32) RayPacket {
+    /** Number of rays in a packet */
+    static constexpr int kSize = 8;
+
+    float originX[kSize];
+    float originY[kSize];
+    float originZ[kSize];
+    float dirX[kSize];
+    float dirY[kSize];
+    float dirZ[kSize];
+    /** Closest hit distance found so far */
+    float hitT[kSize];
+    /** Index of the closest hit sphere, -1 for none */
+    int32_t hitIndex[kSize];
+    /** Bit per lane, set while the ray is still being traced */
+    uint32_t activeMask = 0;
+};
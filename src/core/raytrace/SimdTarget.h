@@ -0,0 +1,16 @@
+#pragma once
+// Shared setup for the runtime dispatched SIMD kernels. RT_X86 is defined when the x86 intrinsics are
+// available, RT_TARGET(isa) enables an instruction set for a single function
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RT_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC allows any intrinsic in any function
+#define RT_TARGET(isa)
+#else
+// GCC/Clang need the instruction set enabled per function to keep the rest of the binary portable
+#define RT_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
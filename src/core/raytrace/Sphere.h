@@ -0,0 +1,12 @@
+#pragma once
+// third party
+#include <glm/glm.hpp>
+
+/** Description of a single sphere, used to fill a SphereSet */
+struct Sphere {
+    glm::vec3 center;
+    float radius;
+    glm::vec3 color;
+    /** Controls reflection intensity */
+    float reflectivity;
+};
@@ -0,0 +1,74 @@
+// project
+#include "core/raytrace/SphereSet.h"
+
+void SphereSet::add(const Sphere& sphere) {
+    mCentersX_.push_back(sphere.center.x);
+    mCentersY_.push_back(sphere.center.y);
+    mCentersZ_.push_back(sphere.center.z);
+    mRadii_.push_back(sphere.radius);
+    mMaterials_.push_back({sphere.color, sphere.reflectivity});
+}
+
+void SphereSet::clear() {
+    mCentersX_.clear();
+    mCentersY_.clear();
+    mCentersZ_.clear();
+    mRadii_.clear();
+    mMaterials_.clear();
+}
+
+std::size_t SphereSet::size() const {
+    return mRadii_.size();
+}
+
+bool SphereSet::empty() const {
+    return mRadii_.empty();
+}
+
+void SphereSet::setCenter(std::size_t sphereIdx, const glm::vec3& center) {
+    mCentersX_[sphereIdx] = center.x;
+    mCentersY_[sphereIdx] = center.y;
+    mCentersZ_[sphereIdx] = center.z;
+}
+
+glm::vec3 SphereSet::getCenter(std::size_t sphereIdx) const {
+    return {mCentersX_[sphereIdx], mCentersY_[sphereIdx], mCentersZ_[sphereIdx]};
+}
+
+float SphereSet::getRadius(std::size_t sphereIdx) const {
+    return mRadii_[sphereIdx];
+}
+
+const SphereMaterial& SphereSet::getMaterial(std::size_t sphereIdx) const {
+    return mMaterials_[sphereIdx];
+}
+
+const float* SphereSet::getCentersX() const {
+    return mCentersX_.data();
+}
+
+const float* SphereSet::getCentersY() const {
+    return mCentersY_.data();
+}
+
+const float* SphereSet::getCentersZ() const {
+    return mCentersZ_.data();
+}
+
+const float* SphereSet::getRadii() const {
+    return mRadii_.data();
+}
+
+void SphereSet::packGeometry(std::vector<glm::vec4>& geometry) const {
+    geometry.resize(size());
+    for (std::size_t i = 0; i < size(); ++i) {
+        geometry[i] = glm::vec4(mCentersX_[i], mCentersY_[i], mCentersZ_[i], mRadii_[i]);
+    }
+}
+
+void SphereSet::packMaterials(std::vector<glm::vec4>& materials) const {
+    materials.resize(size());
+    for (std::size_t i = 0; i < size(); ++i) {
+        materials[i] = glm::vec4(mMaterials_[i].color, mMaterials_[i].reflectivity);
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+// standard lib
+#include <cstddef>
+#include <vector>
+// third party
+#include <glm/glm.hpp>
+// project
+#include "core/raytrace/Sphere.h"
+
+/** Shading data of a sphere, only read once a hit is found */
+struct SphereMaterial {
+    glm::vec3 color;
+    float reflectivity;
+};
+
+/**
+ * Sphere container with a hot/cold split. Centers and radii used by the closest hit search are kept in
+ * separate contiguous arrays, materials are kept in their own table that is only touched on a hit.
+ */
+class SphereSet {
+public:
+    /** Add a sphere to the end of the set */
+    void add(const Sphere& sphere);
+
+    /** Remove all spheres */
+    void clear();
+
+    /** Number of spheres in the set */
+    std::size_t size() const;
+
+    /** If the set has no spheres */
+    bool empty() const;
+
+    /**
+     * Move a sphere
+     * @param sphereIdx Index of the sphere
+     * @param center New center
+     */
+    void setCenter(std::size_t sphereIdx, const glm::vec3& center);
+
+    /** Get the center of a sphere */
+    glm::vec3 getCenter(std::size_t sphereIdx) const;
+
+    /** Get the radius of a sphere */
+    float getRadius(std::size_t sphereIdx) const;
+
+    /** Get the material of a sphere */
+    const SphereMaterial& getMaterial(std::size_t sphereIdx) const;
+
+    const float* getCentersX() const;
+    const float* getCentersY() const;
+    const float* getCentersZ() const;
+    const float* getRadii() const;
+
+    /**
+     * Get the intersection data in the GPU layout: one vec4 per sphere with the center in xyz and the radius in w
+     * @param geometry Output array
+     */
+    void packGeometry(std::vector<glm::vec4>& geometry) const;
+
+    /**
+     * Get the materials in the GPU layout: one vec4 per sphere with the color in rgb and the reflectivity in a
+     * @param materials Output array
+     */
+    void packMaterials(std::vector<glm::vec4>& materials) const;
+
+private:
+    // Hot data, read by every intersection test
+    std::vector<float> mCentersX_;
+    std::vector<float> mCentersY_;
+    std::vector<float> mCentersZ_;
+    std::vector<float> mRadii_;
+
+    // Cold data, read only on a hit
+    std::vector<SphereMaterial> mMaterials_;
+};
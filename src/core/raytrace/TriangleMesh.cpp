@@ -0,0 +1,142 @@
+// standard lib
+#include <cmath>
+#include <cstring>
+#include <utility>
+// project
+#include "core/raytrace/TriangleMesh.h"
+#include "core/graphics/Mesh.h"
+
+
+TriangleRay::TriangleRay(const glm::vec3& rayOrigin, const glm::vec3& rayDir)
+    : origin(rayOrigin) {
+    const glm::vec3 absDir = glm::abs(rayDir);
+    kz = (absDir.x > absDir.y) ? ((absDir.x > absDir.z) ? 0 : 2) : ((absDir.y > absDir.z) ? 1 : 2);
+    kx = (kz + 1) % 3;
+    ky = (kx + 1) % 3;
+    // Keep the winding when looking down a negative axis
+    if (rayDir[kz] < 0.0f) {
+        std::swap(kx, ky);
+    }
+    shearX = rayDir[kx] / rayDir[kz];
+    shearY = rayDir[ky] / rayDir[kz];
+    shearZ = 1.0f / rayDir[kz];
+}
+
+void TriangleMesh::addTriangles(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices,
+                                const SphereMaterial& material, const glm::mat4& transform) {
+    const uint32_t materialIdx = static_cast<uint32_t>(mMaterials_.size());
+    mMaterials_.push_back(material);
+
+    mPositions_.reserve(mPositions_.size() + indices.size());
+    for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+        for (int corner = 0; corner < 3; ++corner) {
+            mPositions_.push_back(glm::vec3(transform * glm::vec4(positions[indices[i + corner]], 1.0f)));
+        }
+        mMaterialIndices_.push_back(materialIdx);
+    }
+}
+
+void TriangleMesh::addMesh(const Mesh& mesh, const SphereMaterial& material, const glm::mat4& transform) {
+    std::vector<glm::vec3> positions;
+    positions.reserve(mesh.vertices.size());
+    for (const Vertex& vertex : mesh.vertices) {
+        positions.push_back(vertex.Position);
+    }
+    addTriangles(positions, mesh.indices, material, transform);
+}
+
+void TriangleMesh::clear() {
+    mPositions_.clear();
+    mMaterialIndices_.clear();
+    mMaterials_.clear();
+}
+
+std::size_t TriangleMesh::size() const {
+    return mMaterialIndices_.size();
+}
+
+bool TriangleMesh::empty() const {
+    return mMaterialIndices_.empty();
+}
+
+const glm::vec3& TriangleMesh::getVertex(std::size_t triangleIdx, int corner) const {
+    return mPositions_[triangleIdx * 3 + corner];
+}
+
+glm::vec3 TriangleMesh::getNormal(std::size_t triangleIdx) const {
+    const glm::vec3& v0 = getVertex(triangleIdx, 0);
+    return glm::normalize(glm::cross(getVertex(triangleIdx, 1) - v0, getVertex(triangleIdx, 2) - v0));
+}
+
+const SphereMaterial& TriangleMesh::getMaterial(std::size_t triangleIdx) const {
+    return mMaterials_[mMaterialIndices_[triangleIdx]];
+}
+
+std::size_t TriangleMesh::getMaterialCount() const {
+    return mMaterials_.size();
+}
+
+void TriangleMesh::computeBounds(std::vector<BoundingBox>& primBounds) const {
+    primBounds.resize(size());
+    for (std::size_t i = 0; i < size(); ++i) {
+        BoundingBox bounds;
+        bounds.grow(getVertex(i, 0));
+        bounds.grow(getVertex(i, 1));
+        bounds.grow(getVertex(i, 2));
+        primBounds[i] = bounds;
+    }
+}
+
+void TriangleMesh::packTriangles(std::vector<glm::vec4>& triangles, uint32_t materialOffset) const {
+    triangles.reserve(triangles.size() + size() * 3);
+    for (std::size_t i = 0; i < size(); ++i) {
+        const uint32_t materialIdx = mMaterialIndices_[i] + materialOffset;
+        float materialBits;
+        std::memcpy(&materialBits, &materialIdx, sizeof(float));
+        triangles.push_back(glm::vec4(getVertex(i, 0), materialBits));
+        triangles.push_back(glm::vec4(getVertex(i, 1), 0.0f));
+        triangles.push_back(glm::vec4(getVertex(i, 2), 0.0f));
+    }
+}
+
+void TriangleMesh::packMaterials(std::vector<glm::vec4>& materials) const {
+    materials.reserve(materials.size() + mMaterials_.size());
+    for (const SphereMaterial& material : mMaterials_) {
+        materials.push_back(glm::vec4(material.color, material.reflectivity));
+    }
+}
+
+bool TriangleMesh::intersect(const TriangleRay& ray, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, float& t) {
+    // Corners relative to the ray origin, sheared into ray space
+    const glm::vec3 a = v0 - ray.origin;
+    const glm::vec3 b = v1 - ray.origin;
+    const glm::vec3 c = v2 - ray.origin;
+    const float ax = a[ray.kx] - ray.shearX * a[ray.kz];
+    const float ay = a[ray.ky] - ray.shearY * a[ray.kz];
+    const float bx = b[ray.kx] - ray.shearX * b[ray.kz];
+    const float by = b[ray.ky] - ray.shearY * b[ray.kz];
+    const float cx = c[ray.kx] - ray.shearX * c[ray.kz];
+    const float cy = c[ray.ky] - ray.shearY * c[ray.kz];
+
+    // Scaled barycentrics, recomputed in double precision when the ray runs exactly along an edge
+    float u = cx * by - cy * bx;
+    float v = ax * cy - ay * cx;
+    float w = bx * ay - by * ax;
+    if (u == 0.0f || v == 0.0f || w == 0.0f) {
+        u = static_cast<float>(static_cast<double>(cx) * by - static_cast<double>(cy) * bx);
+        v = static_cast<float>(static_cast<double>(ax) * cy - static_cast<double>(ay) * cx);
+        w = static_cast<float>(static_cast<double>(bx) * ay - static_cast<double>(by) * ax);
+    }
+
+    if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f)) {
+        return false;
+    }
+    const float det = u + v + w;
+    if (det == 0.0f) {
+        return false;
+    }
+
+    const float scaledT = u * ray.shearZ * a[ray.kz] + v * ray.shearZ * b[ray.kz] + w * ray.shearZ * c[ray.kz];
+    t = scaledT / det;
+    return t > 0.0f;
+}
@@ -0,0 +1,106 @@
+#pragma once
+// standard lib
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+// third party
+#include <glm/glm.hpp>
+// project
+#include "core/raytrace/BoundingBox.h"
+#include "core/raytrace/SphereSet.h"
+
+class Mesh;
+
+/**
+ * Ray precomputation for the watertight ray/triangle test (Woop, Benthin, Wald 2013). The ray is sheared so it
+ * points down the z axis, which makes the edge tests exact on shared edges
+ */
+struct TriangleRay {
+    TriangleRay(const glm::vec3& rayOrigin, const glm::vec3& rayDir);
+
+    glm::vec3 origin;
+    /** Axis permutation, kz is the dominant direction axis */
+    int kx, ky, kz;
+    /** Shear constants */
+    float shearX, shearY, shearZ;
+};
+
+/**
+ * Position only triangle soup for the ray tracer, in the object space of the mesh. AccelerationStructure builds a
+ * bottom level BVH over it and places it in the world with instance transforms. Triangles are copied out of
+ * Mesh::vertices/Mesh::indices or plain position arrays, only the positions are kept plus a material per call
+ */
+class TriangleMesh {
+public:
+    /**
+     * Append indexed triangles
+     * @param positions Vertex positions
+     * @param indices Three vertex indices per triangle
+     * @param material Shading of every triangle added
+     * @param transform Transform into the object space of this mesh, e.g. to combine parts of a model
+     */
+    void addTriangles(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices,
+                      const SphereMaterial& material, const glm::mat4& transform = glm::mat4(1.0f));
+
+    /**
+     * Append the triangles of a Mesh (Mesh::vertices/Mesh::indices), e.g. every mesh of a Model
+     * @param mesh Mesh to copy the positions from
+     * @param material Shading of every triangle added
+     * @param transform Transform into the object space of this mesh
+     */
+    void addMesh(const Mesh& mesh, const SphereMaterial& material, const glm::mat4& transform = glm::mat4(1.0f));
+
+    /** Remove all triangles */
+    void clear();
+
+    /** Number of triangles */
+    std::size_t size() const;
+
+    /** If there are no triangles */
+    bool empty() const;
+
+    /** Get a corner (0-2) of a triangle */
+    const glm::vec3& getVertex(std::size_t triangleIdx, int corner) const;
+
+    /** Get the unit geometric normal of a triangle, wound counter clockwise */
+    glm::vec3 getNormal(std::size_t triangleIdx) const;
+
+    /** Get the material of a triangle */
+    const SphereMaterial& getMaterial(std::size_t triangleIdx) const;
+
+    /** Number of materials, one per addTriangles call */
+    std::size_t getMaterialCount() const;
+
+    /** Get the bounds of every triangle */
+    void computeBounds(std::vector<BoundingBox>& primBounds) const;
+
+    /**
+     * Append three vec4 per triangle (xyz = corner), the w of the first holds the material index bits
+     * @param triangles Output, the triangles are added after what it already holds
+     * @param materialOffset Added to the material indices, for materials packed after those of other meshes
+     */
+    void packTriangles(std::vector<glm::vec4>& triangles, uint32_t materialOffset = 0) const;
+
+    /** Append one vec4 per material (rgb = color, a = reflectivity) */
+    void packMaterials(std::vector<glm::vec4>& materials) const;
+
+    /**
+     * Watertight ray/triangle test, same as intersectTriangle in ray_traverse.glsl including the double precision
+     * fallback for rays along an edge. Both faces are hit
+     * @param ray Precomputed ray
+     * @param v0 First corner
+     * @param v1 Second corner
+     * @param v2 Third corner
+     * @param t Output hit distance
+     * @return If the ray hits the triangle in front of its origin
+     */
+    static bool intersect(const TriangleRay& ray, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, float& t);
+
+private:
+    /** Three corners per triangle */
+    std::vector<glm::vec3> mPositions_;
+
+    std::vector<uint32_t> mMaterialIndices_;
+
+    std::vector<SphereMaterial> mMaterials_;
+};
@@ -0,0 +1,198 @@
+// standard lib
+#include <stdexcept>
+// third party
+#define GLEW_STATIC
+#include <GL/glew.h>
+#include <GL/gl.h>
+// project
+#include "core/raytrace/WavefrontPathTracer.h"
+
+
+namespace {
+    /** std430 Path of ray_wavefront.glsl */
+    constexpr size_t kPathSize = 3 * 4 * sizeof(float);
+    /** std430 PathHit of ray_wavefront.glsl */
+    constexpr size_t kPathHitSize = 4 * sizeof(float);
+    /** Dispatch arguments and count in front of the path indices of a queue */
+    constexpr size_t kQueueHeaderSize = 4 * sizeof(GLuint);
+    /** Pixels along each side of a generate workgroup */
+    constexpr int kGenerateTileSize = 16;
+}
+
+WavefrontPathTracer::WavefrontPathTracer(Resources& resources, const glm::ivec2& maxRenderSize)
+    : mRadixSort_(resources), mMaxRenderSize_(maxRenderSize) {
+    mpGenerateProgram_ = resources.getResource<ShaderProgram>("RayWavefrontGenerate");
+    mpExtendProgram_ = resources.getResource<ShaderProgram>("RayWavefrontExtend");
+    mpShadeProgram_ = resources.getResource<ShaderProgram>("RayWavefrontShade");
+    mpCompactProgram_ = resources.getResource<ShaderProgram>("RayWavefrontCompact");
+    mpReorderProgram_ = resources.getResource<ShaderProgram>("RayWavefrontReorder");
+
+    const size_t maxPaths = static_cast<size_t>(maxRenderSize.x) * static_cast<size_t>(maxRenderSize.y);
+    mMaxPaths_ = static_cast<uint32_t>(maxPaths);
+
+    glGenBuffers(1, &mPathSSBO_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mPathSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, maxPaths * kPathSize, nullptr, GL_DYNAMIC_COPY);
+
+    glGenBuffers(1, &mPathHitSSBO_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mPathHitSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, maxPaths * kPathHitSize, nullptr, GL_DYNAMIC_COPY);
+
+    glGenBuffers(2, mQueueSSBOs_);
+    for (const GLuint queueSSBO : mQueueSSBOs_) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, queueSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, kQueueHeaderSize + maxPaths * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    }
+
+    glGenBuffers(1, &mSortKeySSBO_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mSortKeySSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, maxPaths * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+
+    glGenBuffers(1, &mSortedPathSSBO_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mSortedPathSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, maxPaths * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+}
+
+WavefrontPathTracer::~WavefrontPathTracer() {
+    glDeleteBuffers(1, &mPathSSBO_);
+    glDeleteBuffers(1, &mPathHitSSBO_);
+    glDeleteBuffers(2, mQueueSSBOs_);
+    glDeleteBuffers(1, &mSortKeySSBO_);
+    glDeleteBuffers(1, &mSortedPathSSBO_);
+}
+
+void WavefrontPathTracer::trace(const glm::ivec2& renderSize, const glm::ivec2& generateGroups, unsigned int generateArgsBuffer,
+                                const std::function<void(const ShaderProgram&)>& setUniforms) {
+    // The path and queue buffers hold one entry per pixel of the largest frame
+    if (renderSize.x < 1 || renderSize.y < 1 || renderSize.x > mMaxRenderSize_.x || renderSize.y > mMaxRenderSize_.y) {
+        throw std::runtime_error("Wavefront render size exceeds the allocated paths");
+    }
+
+    // Uniforms stay with the programs, only the bounce changes between the dispatches below
+    for (ShaderProgram* pProgram : {mpGenerateProgram_, mpExtendProgram_, mpShadeProgram_, mpCompactProgram_}) {
+        pProgram->bind();
+        setUniforms(*pProgram);
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 16, mPathSSBO_); // Bind to binding=16
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 17, mPathHitSSBO_); // Bind to binding=17
+
+    // Primary rays of the selected pixels into the first queue
+    mGenerateTimer_.begin();
+    resetQueue(mQueueSSBOs_[0]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 19, mQueueSSBOs_[0]); // Bind to binding=19
+    mpGenerateProgram_->bind();
+    if (generateArgsBuffer != 0) {
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, generateArgsBuffer);
+        glDispatchComputeIndirect(0);
+    } else {
+        // Tiles past the render size would queue paths of pixels that are not traced
+        const glm::ivec2 renderTiles = (renderSize + kGenerateTileSize - 1) / kGenerateTileSize;
+        const glm::ivec2 groups = glm::min(generateGroups, renderTiles);
+        glDispatchCompute(groups.x, groups.y, 1);
+    }
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    mGenerateTimer_.end();
+
+    int inputQueue = 0;
+    for (int bounce = 0; bounce <= kMaxBounces; ++bounce) {
+        // Every stage of the bounce runs one invocation per queued path
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 18, mQueueSSBOs_[inputQueue]); // Bind to binding=18
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, mQueueSSBOs_[inputQueue]);
+
+        GpuTimer& extendTimer = mBounceTimers_[static_cast<int>(Stage::EXTEND) - 1][bounce];
+        extendTimer.begin();
+        mpExtendProgram_->bind();
+        glDispatchComputeIndirect(0);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        extendTimer.end();
+
+        GpuTimer& shadeTimer = mBounceTimers_[static_cast<int>(Stage::SHADE) - 1][bounce];
+        shadeTimer.begin();
+        mpShadeProgram_->bind();
+        mpShadeProgram_->setInt("bounce", bounce);
+        glDispatchComputeIndirect(0);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        shadeTimer.end();
+
+        // Shade finishes every path on the last bounce
+        if (bounce == kMaxBounces) {
+            break;
+        }
+
+        GpuTimer& compactTimer = mBounceTimers_[static_cast<int>(Stage::COMPACT) - 1][bounce];
+        compactTimer.begin();
+        resetQueue(mQueueSSBOs_[1 - inputQueue]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 19, mQueueSSBOs_[1 - inputQueue]); // Bind to binding=19
+        mpCompactProgram_->bind();
+        glDispatchComputeIndirect(0);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+        compactTimer.end();
+
+        inputQueue = 1 - inputQueue;
+
+        if (mRayReordering_) {
+            GpuTimer& reorderTimer = mBounceTimers_[static_cast<int>(Stage::REORDER) - 1][bounce];
+            reorderTimer.begin();
+            reorderQueue(mQueueSSBOs_[inputQueue]);
+            reorderTimer.end();
+        }
+    }
+}
+
+void WavefrontPathTracer::setRayReordering(bool enabled, const BoundingBox& sceneBounds) {
+    mRayReordering_ = enabled;
+    mSceneBounds_ = sceneBounds;
+}
+
+bool WavefrontPathTracer::getRayReordering() const {
+    return mRayReordering_;
+}
+
+void WavefrontPathTracer::updateTimers() {
+    mGenerateTimer_.update();
+    for (auto& stageTimers : mBounceTimers_) {
+        for (GpuTimer& timer : stageTimers) {
+            timer.update();
+        }
+    }
+}
+
+float WavefrontPathTracer::getStageMilliseconds(Stage stage) const {
+    if (stage == Stage::GENERATE) {
+        return mGenerateTimer_.getMilliseconds();
+    }
+    float milliseconds = 0.0f;
+    for (const GpuTimer& timer : mBounceTimers_[static_cast<int>(stage) - 1]) {
+        milliseconds += timer.getMilliseconds();
+    }
+    return milliseconds;
+}
+
+void WavefrontPathTracer::resetQueue(unsigned int queueSSBO) {
+    const GLuint header[4] = {0, 1, 1, 0};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, queueSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(header), header);
+}
+
+void WavefrontPathTracer::reorderQueue(unsigned int queueSSBO) {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 18, queueSSBO); // Bind to binding=18
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 21, mSortKeySSBO_); // Bind to binding=21
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 22, mSortedPathSSBO_); // Bind to binding=22
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, queueSSBO);
+
+    mpReorderProgram_->bind();
+    mpReorderProgram_->setVec3("sceneBoundsMin", mSceneBounds_.min);
+    mpReorderProgram_->setVec3("sceneBoundsMax", mSceneBounds_.max);
+    mpReorderProgram_->setInt("reorderPass", 0);
+    glDispatchComputeIndirect(0);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // The count stays on the GPU, the sort skips the blocks past it
+    mRadixSort_.sortIndirect(mSortKeySSBO_, mSortedPathSSBO_, queueSSBO, 3 * sizeof(GLuint), mMaxPaths_, kReorderKeyBits);
+
+    mpReorderProgram_->bind();
+    mpReorderProgram_->setInt("reorderPass", 1);
+    glDispatchComputeIndirect(0);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
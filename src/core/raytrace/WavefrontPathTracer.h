@@ -0,0 +1,112 @@
+#pragma once
+// standard lib
+#include <array>
+#include <cstdint>
+#include <functional>
+// third party
+#include <glm/glm.hpp>
+// project
+#include "core/application/Resources.h"
+#include "core/graphics/GpuRadixSort.h"
+#include "core/graphics/GpuTimer.h"
+#include "core/raytrace/BoundingBox.h"
+
+/**
+ * Path tracer split into compute stages that run once per bounce (Laine, Karras, Aila 2013). Generate starts a path
+ * at every selected pixel, extend finds the closest hits, shade adds their color and sets up the reflection rays and
+ * compact queues the paths still alive for the next bounce. The queues live in SSBOs whose headers are the indirect
+ * dispatch arguments of the next stage, so a finished path stops taking up an invocation instead of idling next to
+ * the longest path of its workgroup as in the megakernel ray_trace_multi.glsl.
+ * The stages share the sampling and accumulation code of the megakernel and produce the same image.
+ * With ray reordering the queue of every secondary bounce is radix sorted by origin cell and direction octant
+ * before it is extended, which trades a sort for more coherent traversal of the incoherent reflection rays
+ */
+class WavefrontPathTracer {
+public:
+    enum class Stage {
+        GENERATE=0, EXTEND, SHADE, COMPACT, REORDER
+    };
+    static constexpr int kStageCount = 5;
+
+    /** Bounces after the primary hit, MAX_BOUNCES of ray_common.glsl */
+    static constexpr int kMaxBounces = 8;
+
+    /** Bits of the ray reordering keys of ray_wavefront_reorder.glsl, a 4 bit per axis origin cell and the octant */
+    static constexpr uint32_t kReorderKeyBits = 15;
+
+    /**
+     * Constructor
+     * @param resources Resources holding the RayWavefrontGenerate, Extend, Shade, Compact and Reorder programs and
+     * the RadixSort programs
+     * @param maxRenderSize Largest frame traced, a path is kept for every pixel
+     */
+    WavefrontPathTracer(Resources& resources, const glm::ivec2& maxRenderSize);
+
+    ~WavefrontPathTracer();
+
+    WavefrontPathTracer(const WavefrontPathTracer&) = delete;
+    WavefrontPathTracer& operator=(const WavefrontPathTracer&) = delete;
+
+    /**
+     * Trace one sample of the pixels picked by the sampling uniforms of ray_sample.glsl. The scene buffers, the frame
+     * images and the convergence and tile buffers must be bound
+     * @param renderSize Pixels traced, at most maxRenderSize, throws otherwise
+     * @param generateGroups Workgroups of the generate stage, one per 16x16 pixel tile, clamped to the tiles of
+     * renderSize
+     * @param generateArgsBuffer Indirect dispatch arguments of the generate stage, 0 to dispatch generateGroups
+     * @param setUniforms Sets the camera, sampling and scene uniforms on a bound stage program
+     */
+    void trace(const glm::ivec2& renderSize, const glm::ivec2& generateGroups, unsigned int generateArgsBuffer,
+               const std::function<void(const ShaderProgram&)>& setUniforms);
+
+    /**
+     * Sort the rays of every secondary bounce before they are extended
+     * @param enabled Reorder the rays of the following traces
+     * @param sceneBounds Bounds the ray origins are quantized in for the sort keys
+     */
+    void setRayReordering(bool enabled, const BoundingBox& sceneBounds);
+
+    bool getRayReordering() const;
+
+    /** Collect the finished stage times without waiting */
+    void updateTimers();
+
+    /** GPU time of a stage summed over the bounces of a recent frame, in milliseconds */
+    float getStageMilliseconds(Stage stage) const;
+
+private:
+    /** Empty a queue, its header becomes the dispatch arguments (0, 1, 1) and count 0 */
+    void resetQueue(unsigned int queueSSBO);
+
+    /** Sort the paths of a queue by their reordering keys, the queue header stays as it is */
+    void reorderQueue(unsigned int queueSSBO);
+
+    ShaderProgram* mpGenerateProgram_ = nullptr;
+    ShaderProgram* mpExtendProgram_ = nullptr;
+    ShaderProgram* mpShadeProgram_ = nullptr;
+    ShaderProgram* mpCompactProgram_ = nullptr;
+    ShaderProgram* mpReorderProgram_ = nullptr;
+
+    GpuRadixSort mRadixSort_;
+    bool mRayReordering_ = false;
+    BoundingBox mSceneBounds_;
+    /** Largest render size a trace accepts */
+    glm::ivec2 mMaxRenderSize_;
+    /** Paths in the pool, an upper bound of every queue count */
+    uint32_t mMaxPaths_ = 0;
+
+    /** Path state per pixel (binding 16) */
+    unsigned int mPathSSBO_ = 0;
+    /** Closest hit per pixel (binding 17) */
+    unsigned int mPathHitSSBO_ = 0;
+    /** Ping-pong path queues, bound as input (binding 18) and output (binding 19) */
+    unsigned int mQueueSSBOs_[2] = {0, 0};
+    /** Reordering keys of the queued paths (binding 21) */
+    unsigned int mSortKeySSBO_ = 0;
+    /** Queued path indices sorted along with the keys (binding 22) */
+    unsigned int mSortedPathSSBO_ = 0;
+
+    GpuTimer mGenerateTimer_;
+    /** Extend, shade, compact and reorder timers of every bounce, compact and reorder don't run after the last one */
+    std::array<std::array<GpuTimer, kMaxBounces + 1>, kStageCount - 1> mBounceTimers_;
+};
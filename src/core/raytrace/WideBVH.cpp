@@ -0,0 +1,257 @@
+// standard lib
+#include <algorithm>
+// project
+#include "core/raytrace/WideBVH.h"
+#include "core/raytrace/SimdTarget.h"
+
+namespace {
+    template<int Width>
+    uint32_t intersectChildrenScalar(const typename WideBVH<Width>::Node& node, const glm::vec3& rayOrigin,
+                                     const glm::vec3& invRayDir, float maxT, float* tEntry) {
+        uint32_t hitMask = 0;
+        for (int i = 0; i < Width; ++i) {
+            if (node.childIndex[i] < 0) {
+                continue;
+            }
+            BVHNode child;
+            child.boundsMin = glm::vec3(node.boundsMinX[i], node.boundsMinY[i], node.boundsMinZ[i]);
+            child.boundsMax = glm::vec3(node.boundsMaxX[i], node.boundsMaxY[i], node.boundsMaxZ[i]);
+            tEntry[i] = BVH::intersectNode(rayOrigin, invRayDir, child, maxT);
+            if (tEntry[i] != BVH::kMiss) {
+                hitMask |= 1u << i;
+            }
+        }
+        return hitMask;
+    }
+
+#ifdef RT_X86
+    /** 4 children per step, two steps for 8-wide nodes */
+    template<int Width>
+    RT_TARGET("sse4.2")
+    uint32_t intersectChildrenSse(const typename WideBVH<Width>::Node& node, const glm::vec3& rayOrigin,
+                                  const glm::vec3& invRayDir, float maxT, float* tEntry) {
+        const __m128 originX = _mm_set1_ps(rayOrigin.x);
+        const __m128 originY = _mm_set1_ps(rayOrigin.y);
+        const __m128 originZ = _mm_set1_ps(rayOrigin.z);
+        const __m128 invDirX = _mm_set1_ps(invRayDir.x);
+        const __m128 invDirY = _mm_set1_ps(invRayDir.y);
+        const __m128 invDirZ = _mm_set1_ps(invRayDir.z);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 maxTs = _mm_set1_ps(maxT);
+        const __m128i unused = _mm_set1_epi32(-1);
+
+        uint32_t hitMask = 0;
+        for (int base = 0; base < Width; base += 4) {
+            const __m128 t0X = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.boundsMinX + base), originX), invDirX);
+            const __m128 t1X = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.boundsMaxX + base), originX), invDirX);
+            const __m128 t0Y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.boundsMinY + base), originY), invDirY);
+            const __m128 t1Y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.boundsMaxY + base), originY), invDirY);
+            const __m128 t0Z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.boundsMinZ + base), originZ), invDirZ);
+            const __m128 t1Z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.boundsMaxZ + base), originZ), invDirZ);
+
+            const __m128 tEnter = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0X, t1X), _mm_min_ps(t0Y, t1Y)), _mm_min_ps(t0Z, t1Z));
+            const __m128 tExit = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0X, t1X), _mm_max_ps(t0Y, t1Y)), _mm_max_ps(t0Z, t1Z));
+
+            const __m128 used = _mm_castsi128_ps(
+                _mm_cmpgt_epi32(_mm_load_si128(reinterpret_cast<const __m128i*>(node.childIndex + base)), unused)
+            );
+            const __m128 hit = _mm_and_ps(
+                _mm_and_ps(_mm_cmpge_ps(tExit, tEnter), _mm_cmpgt_ps(tExit, zero)),
+                _mm_and_ps(_mm_cmplt_ps(tEnter, maxTs), used)
+            );
+
+            _mm_store_ps(tEntry + base, tEnter);
+            hitMask |= static_cast<uint32_t>(_mm_movemask_ps(hit)) << base;
+        }
+        return hitMask;
+    }
+
+    /** All 8 children of an 8-wide node in one step */
+    RT_TARGET("avx2")
+    uint32_t intersectChildrenAvx2(const WideBVH<8>::Node& node, const glm::vec3& rayOrigin,
+                                   const glm::vec3& invRayDir, float maxT, float* tEntry) {
+        const __m256 originX = _mm256_set1_ps(rayOrigin.x);
+        const __m256 originY = _mm256_set1_ps(rayOrigin.y);
+        const __m256 originZ = _mm256_set1_ps(rayOrigin.z);
+        const __m256 invDirX = _mm256_set1_ps(invRayDir.x);
+        const __m256 invDirY = _mm256_set1_ps(invRayDir.y);
+        const __m256 invDirZ = _mm256_set1_ps(invRayDir.z);
+
+        const __m256 t0X = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.boundsMinX), originX), invDirX);
+        const __m256 t1X = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.boundsMaxX), originX), invDirX);
+        const __m256 t0Y = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.boundsMinY), originY), invDirY);
+        const __m256 t1Y = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.boundsMaxY), originY), invDirY);
+        const __m256 t0Z = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.boundsMinZ), originZ), invDirZ);
+        const __m256 t1Z = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.boundsMaxZ), originZ), invDirZ);
+
+        const __m256 tEnter = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(t0X, t1X), _mm256_min_ps(t0Y, t1Y)), _mm256_min_ps(t0Z, t1Z));
+        const __m256 tExit = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(t0X, t1X), _mm256_max_ps(t0Y, t1Y)), _mm256_max_ps(t0Z, t1Z));
+
+        const __m256 used = _mm256_castsi256_ps(_mm256_cmpgt_epi32(
+            _mm256_load_si256(reinterpret_cast<const __m256i*>(node.childIndex)), _mm256_set1_epi32(-1)
+        ));
+        const __m256 hit = _mm256_and_ps(
+            _mm256_and_ps(_mm256_cmp_ps(tExit, tEnter, _CMP_GE_OQ), _mm256_cmp_ps(tExit, _mm256_setzero_ps(), _CMP_GT_OQ)),
+            _mm256_and_ps(_mm256_cmp_ps(tEnter, _mm256_set1_ps(maxT), _CMP_LT_OQ), used)
+        );
+
+        _mm256_store_ps(tEntry, tEnter);
+        return static_cast<uint32_t>(_mm256_movemask_ps(hit));
+    }
+#endif
+
+    /** Surface area of a binary node, used to pick which child to open */
+    float getSurfaceArea(const BVHNode& node) {
+        const glm::vec3 extent = node.boundsMax - node.boundsMin;
+        return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+    }
+}
+
+template<int Width>
+WideBVH<Width>::WideBVH(PacketIntersector::SimdLevel level) {
+    const PacketIntersector::SimdLevel supported = PacketIntersector::detectSimdLevel();
+    mSimdLevel_ = (static_cast<int>(level) > static_cast<int>(supported)) ? supported : level;
+
+    mIntersectFn_ = intersectChildrenScalar<Width>;
+#ifdef RT_X86
+    if (mSimdLevel_ != PacketIntersector::SimdLevel::SCALAR) {
+        mIntersectFn_ = intersectChildrenSse<Width>;
+    }
+    if constexpr (Width == 8) {
+        // AVX-512 has nothing to add for 8 floats
+        if (mSimdLevel_ == PacketIntersector::SimdLevel::AVX2 || mSimdLevel_ == PacketIntersector::SimdLevel::AVX512) {
+            mIntersectFn_ = intersectChildrenAvx2;
+        }
+    }
+#endif
+}
+
+template<int Width>
+void WideBVH<Width>::collapse(const BVH& bvh) {
+    mNodes_.clear();
+    mSourceNodes_.clear();
+    mPrimIndices_ = bvh.getPrimIndices();
+    if (bvh.empty()) {
+        return;
+    }
+    mNodes_.reserve(bvh.getNodes().size() / 2 + 1);
+    mSourceNodes_.reserve(mNodes_.capacity() * Width);
+    collapseNode(bvh, 0);
+}
+
+template<int Width>
+void WideBVH<Width>::refit(const BVH& bvh) {
+    const std::vector<BVHNode>& binaryNodes = bvh.getNodes();
+    for (std::size_t nodeIdx = 0; nodeIdx < mNodes_.size(); ++nodeIdx) {
+        Node& node = mNodes_[nodeIdx];
+        for (int i = 0; i < Width; ++i) {
+            const int32_t sourceIdx = mSourceNodes_[nodeIdx * Width + i];
+            if (sourceIdx == -1) {
+                continue;
+            }
+            const BVHNode& child = binaryNodes[sourceIdx];
+            node.boundsMinX[i] = child.boundsMin.x;
+            node.boundsMinY[i] = child.boundsMin.y;
+            node.boundsMinZ[i] = child.boundsMin.z;
+            node.boundsMaxX[i] = child.boundsMax.x;
+            node.boundsMaxY[i] = child.boundsMax.y;
+            node.boundsMaxZ[i] = child.boundsMax.z;
+        }
+    }
+}
+
+template<int Width>
+int32_t WideBVH<Width>::collapseNode(const BVH& bvh, int32_t binaryIdx) {
+    const std::vector<BVHNode>& binaryNodes = bvh.getNodes();
+    const int32_t wideIdx = static_cast<int32_t>(mNodes_.size());
+    mNodes_.emplace_back();
+    mSourceNodes_.resize(mNodes_.size() * Width, -1);
+
+    // Start from the two children, a leaf root becomes the only child
+    int32_t children[Width];
+    int childCount = 0;
+    const BVHNode& binaryNode = binaryNodes[binaryIdx];
+    if (binaryNode.isLeaf()) {
+        children[childCount++] = binaryIdx;
+    } else {
+        children[childCount++] = binaryNode.leftFirst;
+        children[childCount++] = binaryNode.leftFirst + 1;
+    }
+
+    // Open the largest inner child until the slots are full, large children are the most likely to be hit
+    while (childCount < Width) {
+        int largest = -1;
+        float largestArea = -1.0f;
+        for (int i = 0; i < childCount; ++i) {
+            const BVHNode& child = binaryNodes[children[i]];
+            if (!child.isLeaf() && getSurfaceArea(child) > largestArea) {
+                largest = i;
+                largestArea = getSurfaceArea(child);
+            }
+        }
+        if (largest == -1) {
+            break;
+        }
+        const int32_t opened = children[largest];
+        children[largest] = binaryNodes[opened].leftFirst;
+        children[childCount++] = binaryNodes[opened].leftFirst + 1;
+    }
+
+    // Inner children are collapsed first, the node is only referenced by index since the vector grows
+    int32_t childIndex[Width];
+    for (int i = 0; i < childCount; ++i) {
+        const BVHNode& child = binaryNodes[children[i]];
+        childIndex[i] = child.isLeaf() ? child.leftFirst : collapseNode(bvh, children[i]);
+    }
+
+    Node& node = mNodes_[wideIdx];
+    for (int i = 0; i < Width; ++i) {
+        if (i < childCount) {
+            const BVHNode& child = binaryNodes[children[i]];
+            mSourceNodes_[wideIdx * Width + i] = children[i];
+            node.boundsMinX[i] = child.boundsMin.x;
+            node.boundsMinY[i] = child.boundsMin.y;
+            node.boundsMinZ[i] = child.boundsMin.z;
+            node.boundsMaxX[i] = child.boundsMax.x;
+            node.boundsMaxY[i] = child.boundsMax.y;
+            node.boundsMaxZ[i] = child.boundsMax.z;
+            node.childIndex[i] = childIndex[i];
+            node.childCount[i] = child.isLeaf() ? child.count : 0;
+        } else {
+            node.boundsMinX[i] = node.boundsMinY[i] = node.boundsMinZ[i] = 0.0f;
+            node.boundsMaxX[i] = node.boundsMaxY[i] = node.boundsMaxZ[i] = 0.0f;
+            node.childIndex[i] = -1;
+            node.childCount[i] = 0;
+        }
+    }
+    return wideIdx;
+}
+
+template<int Width>
+const std::vector<typename WideBVH<Width>::Node>& WideBVH<Width>::getNodes() const {
+    return mNodes_;
+}
+
+template<int Width>
+const std::vector<uint32_t>& WideBVH<Width>::getPrimIndices() const {
+    return mPrimIndices_;
+}
+
+template<int Width>
+bool WideBVH<Width>::empty() const {
+    return mNodes_.empty();
+}
+
+template<int Width>
+uint32_t WideBVH<Width>::intersectChildren(const Node& node, const glm::vec3& rayOrigin, const glm::vec3& invRayDir, float maxT, float* tEntry) const {
+    return mIntersectFn_(node, rayOrigin, invRayDir, maxT, tEntry);
+}
+
+template<int Width>
+PacketIntersector::SimdLevel WideBVH<Width>::getSimdLevel() const {
+    return mSimdLevel_;
+}
+
+// Explicit instantiate template for expected widths
+template class WideBVH<4>;
+template class WideBVH<8>;
@@ -0,0 +1,96 @@
+#pragma once
+// standard lib
+#include <cstdint>
+#include <vector>
+// third party
+#include <glm/glm.hpp>
+// project
+#include "core/raytrace/BVH.h"
+#include "core/raytrace/PacketIntersector.h"
+
+/**
+ * BVH with Width children per node, collapsed from a binary BVH. The child bounds are stored as SoA inside the
+ * node so a single SIMD slab test covers every child, and nodes are cache line aligned.
+ * Explicitly instantiated for 4 (SSE) and 8 (AVX2) children
+ */
+template<int Width>
+class WideBVH {
+public:
+    static_assert(Width == 4 || Width == 8, "Wide BVHs are 4 or 8 children wide");
+
+    struct alignas(64) Node {
+        float boundsMinX[Width];
+        float boundsMinY[Width];
+        float boundsMinZ[Width];
+        float boundsMaxX[Width];
+        float boundsMaxY[Width];
+        float boundsMaxZ[Width];
+        /** Inner child: node index. Leaf child: first entry in the prim indices. -1 for an unused slot */
+        int32_t childIndex[Width];
+        /** Number of spheres of a leaf child, 0 for inner children */
+        int32_t childCount[Width];
+    };
+
+    /**
+     * Constructor
+     * @param level Instruction set of the node test. Clamped to what the CPU supports
+     */
+    explicit WideBVH(PacketIntersector::SimdLevel level = PacketIntersector::detectSimdLevel());
+
+    /**
+     * Collapse a binary BVH. Inner nodes pull up the children of their largest inner children until all
+     * Width slots are used, the binary leaves are kept as they are
+     * @param bvh Binary hierarchy to collapse
+     */
+    void collapse(const BVH& bvh);
+
+    /**
+     * Copy the child bounds again from the binary BVH it was collapsed from, after that was refit. The topology
+     * and the prim indices stay as they are
+     * @param bvh Binary hierarchy passed to collapse, refit since
+     */
+    void refit(const BVH& bvh);
+
+    /** Get the nodes, the root is node 0 */
+    const std::vector<Node>& getNodes() const;
+
+    /** Get the sphere indices referenced by the leaf children */
+    const std::vector<uint32_t>& getPrimIndices() const;
+
+    /** If there are no nodes */
+    bool empty() const;
+
+    /**
+     * Slab test of a ray against every child of a node at once
+     * @param node Node to test the children of
+     * @param rayOrigin Ray origin
+     * @param invRayDir Component wise inverse of the ray direction
+     * @param maxT Children entered beyond this distance are missed
+     * @param tEntry Output entry distance per child, 16 byte aligned
+     * @return Bit mask of the children hit
+     */
+    uint32_t intersectChildren(const Node& node, const glm::vec3& rayOrigin, const glm::vec3& invRayDir, float maxT, float* tEntry) const;
+
+    /** Get the instruction set of the node test */
+    PacketIntersector::SimdLevel getSimdLevel() const;
+
+private:
+    /** Collapse the binary subtree below binaryIdx into a new node, returns its index */
+    int32_t collapseNode(const BVH& bvh, int32_t binaryIdx);
+
+    using IntersectFn = uint32_t(*)(const Node&, const glm::vec3&, const glm::vec3&, float, float*);
+
+    std::vector<Node> mNodes_;
+
+    /** Binary node behind every child slot, Width per node, -1 for an unused slot */
+    std::vector<int32_t> mSourceNodes_;
+
+    std::vector<uint32_t> mPrimIndices_;
+
+    PacketIntersector::SimdLevel mSimdLevel_;
+
+    IntersectFn mIntersectFn_;
+};
+
+static_assert(sizeof(WideBVH<4>::Node) == 128, "4-wide node should be two cache lines");
+static_assert(sizeof(WideBVH<8>::Node) == 256, "8-wide node should be four cache lines");
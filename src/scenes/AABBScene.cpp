@@ -127,9 +127,8 @@ void AABBScene::render() {
     glClearColor(.1f, 0.1f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
+    mParentApp_.getFrameUniforms().setCamera(mCamera_.getViewMatrix(), mCamera_.getProjectionMatrix());
     mAABBShader_->bind();
-    mAABBShader_->setMat4("view", mCamera_.getViewMatrix());
-    mAABBShader_->setMat4("projection", mCamera_.getProjectionMatrix());
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mAABBSSBO_);
 
     if (mRenderMode_ == RenderMode::LINES) {
@@ -1,22 +1,46 @@
 // standard lib
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
 // third party
 #define GLEW_STATIC
 #include <GL/glew.h>
 #include <GL/gl.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
+#include <glm/gtc/matrix_transform.hpp>
 // project
 #include "scenes/RayTraceScene.h"
 #include "core/application/App.h"
-
+#include "core/graphics/Mesh.h"
+
+namespace {
+    /** Mesh with only the vertex positions set, all the ray tracer copies out of it */
+    Mesh makePositionMesh(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices) {
+        std::vector<Vertex> vertices(positions.size(), Vertex{});
+        for (std::size_t i = 0; i < positions.size(); ++i) {
+            vertices[i].Position = positions[i];
+        }
+        return Mesh(vertices, indices, {});
+    }
+}
 
 RayTraceScene::RayTraceScene(App& parentApp) 
-    : Scene(parentApp), mScreenSize_(mParentApp_.getWindow()->getDimensions()) {
+    : Scene(parentApp), mScreenSize_(mParentApp_.getWindow()->getDimensions()), mRenderSize_(mScreenSize_) {
 
     mpBasicCompute_ = mParentApp_.getResources().getResource<ShaderProgram>("BasicCompute");
     mpRayTraceCompute_ = mParentApp_.getResources().getResource<ShaderProgram>("RayTraceMulti");
+    mpTileCompactCompute_ = mParentApp_.getResources().getResource<ShaderProgram>("RayTraceTileCompact");
+    mpReprojectCompute_ = mParentApp_.getResources().getResource<ShaderProgram>("RayTraceReproject");
+    mpCheckerboardCompute_ = mParentApp_.getResources().getResource<ShaderProgram>("RayTraceCheckerboard");
     mpQuadShader_ = mParentApp_.getResources().getResource<ShaderProgram>("Quad");
+    mQuadTextureUniform_ = mpQuadShader_->getUniform<int>("screenTexture");
+    mQuadUVScaleUniform_ = mpQuadShader_->getUniform<glm::vec2>("uvScale");
+    resolvePassUniforms();
 
     // quad (ccw)
     float quadVertices[] = {
@@ -71,35 +95,54 @@ RayTraceScene::RayTraceScene(App& parentApp)
     }
 
     {
-        struct Sphere {
-            glm::vec3 center;
-            float radius;
-            glm::vec3 color;
-            float reflectivity;
-        };
-
         //rayTraceMultiProgram.bind();
         mpRayTraceCompute_->bind();
 
         // Define a list of spheres
-        std::vector<Sphere> spheres = {
+        const std::vector<Sphere> spheres = {
             {{ 0.0f,  0.0f,  -5.0f}, 1.0f, {1.0f, 0.2f, 0.2f}, 0.5f},  // Red, 50% reflective
             {{5.5f,  1.5f,  8.0f}, 0.7f, {0.2f, 1.0f, 0.2f}, 0.2f},  // Green, 20% reflective
             {{ 1.5f,  1.5f,  7.5f}, 1.2f, {0.2f, 0.2f, 1.0f}, 0.7f}   // Blue, 70% reflective
         };
+        for (const Sphere& sphere : spheres) {
+            mSpheres_.add(sphere);
+        }
 
-        GLuint ssbo;
-        glGenBuffers(1, &ssbo);
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, spheres.size() * sizeof(Sphere), spheres.data(), GL_STATIC_DRAW);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, ssbo); // Bind to binding=1
-        mpRayTraceCompute_->setInt("numSpheres", spheres.size());
+        // Center/radius and materials go in separate SSBOs so the intersection loop only reads the geometry
+        std::vector<glm::vec4> geometry;
+        std::vector<glm::vec4> materials;
+        mSpheres_.packGeometry(geometry);
+        mSpheres_.packMaterials(materials);
+
+        glGenBuffers(1, &mSphereGeometrySSBO_);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, mSphereGeometrySSBO_);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, geometry.size() * sizeof(glm::vec4), geometry.data(), GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mSphereGeometrySSBO_); // Bind to binding=1
+
+        glGenBuffers(1, &mSphereMaterialSSBO_);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, mSphereMaterialSSBO_);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, materials.size() * sizeof(glm::vec4), materials.data(), GL_STATIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mSphereMaterialSSBO_); // Bind to binding=2
+
+        for (std::size_t i = 0; i < mSpheres_.size(); ++i) {
+            mSphereRestCenters_.push_back(mSpheres_.getCenter(i));
+        }
+
+        // BVH nodes and the sphere indices referenced by its leaves
+        mBVH_.build(mSpheres_, &mThreadPool_);
+
+        glGenBuffers(1, &mBVHNodeSSBO_);
+        glGenBuffers(1, &mBVHPrimSSBO_);
+        uploadBVH();
+
+        createMeshes();
     }
 
     glGenFramebuffers(1, &framebuffer);
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
 
-    // Create the texture (2D texture for color attachment)
+    // Create the texture (2D texture for color attachment). It and the other per pixel images keep the window size,
+    // a scaled down resolution only uses their top left corner
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, mScreenSize_.x, mScreenSize_.y, 0, GL_RGBA, GL_FLOAT, nullptr);
@@ -111,25 +154,114 @@ RayTraceScene::RayTraceScene(App& parentApp)
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
         std::cerr << "Framebuffer is not complete!" << std::endl;
     }
+
+    // Progressive accumulation, overwritten by the first sample after every reset so it needs no clear
+    glGenTextures(1, &mAccumulationTexture_);
+    glBindTexture(GL_TEXTURE_2D, mAccumulationTexture_);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, mScreenSize_.x, mScreenSize_.y);
+
+    const GLuint counters[2] = {0, 0};
+    glGenBuffers(1, &mConvergenceSSBO_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mConvergenceSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(counters), counters, GL_DYNAMIC_READ);
+
+    // Temporal reprojection
+    glGenTextures(1, &mHitDistanceTexture_);
+    glBindTexture(GL_TEXTURE_2D, mHitDistanceTexture_);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, mScreenSize_.x, mScreenSize_.y);
+
+    glGenTextures(1, &mReprojectedTexture_);
+    glBindTexture(GL_TEXTURE_2D, mReprojectedTexture_);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, mScreenSize_.x, mScreenSize_.y);
+
+    glGenBuffers(1, &mReprojectionDepthSSBO_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mReprojectionDepthSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<size_t>(mScreenSize_.x) * static_cast<size_t>(mScreenSize_.y) * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+
+    // Adaptive sampling state, cleared on the first sample after a reset
+    const glm::ivec2 numTiles = (glm::ivec2(mScreenSize_) + kTileSize - 1) / kTileSize;
+    const size_t tileCount = static_cast<size_t>(numTiles.x) * numTiles.y;
+    glGenBuffers(1, &mTileStateSSBO_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mTileStateSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, tileCount * 2 * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+
+    glGenBuffers(1, &mActiveTileSSBO_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mActiveTileSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, tileCount * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+
+    const GLuint dispatchArgs[3] = {0, 1, 1};
+    glGenBuffers(1, &mDispatchArgsBuffer_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mDispatchArgsBuffer_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(dispatchArgs), dispatchArgs, GL_DYNAMIC_COPY);
+
+    const GLuint persistentWork[4] = {0, 1, 1, 0};
+    glGenBuffers(1, &mPersistentWorkBuffer_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mPersistentWorkBuffer_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(persistentWork), persistentWork, GL_DYNAMIC_COPY);
+    // Only llvmpipe caps the loop iterations of an invocation, other drivers let the groups drain the whole counter
+    const GLubyte* renderer = glGetString(GL_RENDERER);
+    const std::string rendererName = (renderer != nullptr) ? reinterpret_cast<const char*>(renderer) : "";
+    mCapPersistentPixels_ = (rendererName.find("llvmpipe") != std::string::npos);
+    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &mMaxPersistentGroups_);
+
+    // Start with the workgroup size tuned on this GPU before, or tune it on the first frame
+    mpWorkgroupSizeTuner_ = std::make_unique<WorkgroupSizeTuner>(kWorkgroupSizeCacheFile);
+    const std::optional<glm::ivec2> tunedSize = mpWorkgroupSizeTuner_->getTunedSize("RayTraceMulti");
+    mTuneWorkgroupSize_ = !tunedSize.has_value();
+    for (int i = 0; tunedSize.has_value() && i < IM_ARRAYSIZE(kWorkgroupSizes); ++i) {
+        if (kWorkgroupSizes[i][0] == tunedSize->x && kWorkgroupSizes[i][1] == tunedSize->y) {
+            mWorkgroupSizeIdx_ = i;
+        }
+    }
 }
 
 void RayTraceScene::render() {
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
     glm::mat4 view = mCamera_.getViewMatrix();
     glm::mat4 projection = mCamera_.getProjectionMatrix();
+    // Every trace and reprojection pass reads the camera from the frame uniform buffer
+    FrameUniformBuffer& frameUniforms = mParentApp_.getFrameUniforms();
+    frameUniforms.setCamera(view, projection);
+
+    // The texture is not cleared, every pixel is written by the trace and a converged image is kept as it is
+    if (mBackend_ == Backend::CPU) {
+        mRenderSize_ = glm::ivec2(mScreenSize_);
+        renderCpu(frameUniforms.getData().invViewMatrix, frameUniforms.getData().invProjMatrix);
+    } else {
+        updateResolutionScale();
+        if (mpWavefront_ != nullptr) {
+            mpWavefront_->updateTimers();
+        }
+        const bool cameraMoved = (view != mAccumulatedView_ || projection != mAccumulatedProjection_);
+        const bool progressive = (mSamplingMode_ == SamplingMode::PROGRESSIVE);
+        if (!progressive || cameraMoved) {
+            // Reprojection needs the last frame's matrices, so it runs before they are replaced
+            const bool lastFrameValid = mReprojectionValid_;
+            const bool reproject = progressive && cameraMoved && mTemporalReprojection_ && lastFrameValid;
+            if (reproject) {
+                reprojectLastFrame();
+            }
+            mAccumulatedView_ = view;
+            mAccumulatedProjection_ = projection;
+            resetAccumulation();
+            mReuseReprojection_ = reproject;
+            mCheckerboardHistory_ = lastFrameValid;
+        }
 
-    glClearColor(.1f, 0.1f, 0.1f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        // Frames traced anew are scaled down to hold the budget, a still progressive image is refined at full resolution
+        const glm::ivec2 renderSize = (mSampleCount_ == 0) ? getScaledRenderSize() : glm::ivec2(mScreenSize_);
+        if (renderSize != mRenderSize_) {
+            mRenderSize_ = renderSize;
+            mTracesSinceResize_ = 0;
+            resetAccumulation();
+            mCheckerboardHistory_ = false;
+        }
+        updateConvergence();
 
-    //glUseProgram(computeRay);
-    mpRayTraceCompute_->bind();
-    mpRayTraceCompute_->setMat4("viewMatrix", view); // TOD REMOVE since we only need inverse
-    mpRayTraceCompute_->setMat4("projMatrix", projection);
-    mpRayTraceCompute_->setMat4("invProjMatrix", glm::inverse(projection));
-    mpRayTraceCompute_->setMat4("invViewMatrix", glm::inverse(view));
-    glBindImageTexture(0, texture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
-    glDispatchCompute((mScreenSize_.x + 15) / 16, (mScreenSize_.y + 15) / 16, 1);
-    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);  // Ensure updates are visible
+        // A converged image stays in the texture, the GPU is left idle until something changes
+        if (!mConverged_) {
+            dispatchRayTrace();
+        }
+    }
 
     glBindTexture(GL_TEXTURE_2D, texture);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -140,10 +272,511 @@ void RayTraceScene::render() {
     glBindVertexArray(quadVAO);
     glBindTexture(GL_TEXTURE_2D, texture);
     //quad.setMat4("projection", projection);
-    mpQuadShader_->setInt("screenTexture", 0);
+    mpQuadShader_->set(mQuadTextureUniform_, 0);
+    mpQuadShader_->set(mQuadUVScaleUniform_, glm::vec2(mRenderSize_) / mScreenSize_);
     glDrawArrays(GL_TRIANGLES, 0, 6);
 }
 
+void RayTraceScene::dispatchRayTrace() {
+    const glm::ivec2 numTiles = (mRenderSize_ + kTileSize - 1) / kTileSize;
+    const GLuint tileCount = static_cast<GLuint>(numTiles.x * numTiles.y);
+    const bool adaptive = (mSamplingMode_ == SamplingMode::PROGRESSIVE) && mAdaptiveSampling_;
+    const bool checkerboard = (mSamplingMode_ == SamplingMode::CHECKERBOARD);
+
+    bindSceneBuffers();
+    mTraceTimer_.begin();
+
+    // Only the counts of the newest frame are read back, unread older counts are dropped
+    const GLuint zero = 0;
+    const GLuint counters[2] = {0, 0};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mConvergenceSSBO_);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counters), counters);
+
+    if (adaptive) {
+        if (mSampleCount_ == 0) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, mTileStateSSBO_);
+            glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        }
+        const GLuint dispatchArgs[3] = {0, 1, 1};
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, mDispatchArgsBuffer_);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(dispatchArgs), dispatchArgs);
+
+        // List the tiles still above the threshold, their count becomes the workgroup count of the trace
+        mpTileCompactCompute_->bind();
+        mpTileCompactCompute_->set(mCompactNumTilesUniform_, tileCount);
+        mpTileCompactCompute_->set(mCompactNoiseThresholdUniform_, mConvergenceThreshold_);
+        mpTileCompactCompute_->set(mCompactMinSamplesUniform_, kMinSamples);
+        mpTileCompactCompute_->set(mCompactMaxSamplesUniform_, mMaxSamples_);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 15, mDispatchArgsBuffer_); // Bind to binding=15
+        glDispatchCompute((tileCount + 63) / 64, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+    }
+
+    // Sampling and scene uniforms read through ray_sample.glsl, by the megakernel and the wavefront stages. The camera
+    // is in the frame uniform buffer
+    const ShaderDefines traceDefines = getTraceDefines();
+    const auto setTraceUniforms = [&](const ShaderProgram& program) {
+        const TraceUniforms& uniforms = getTraceUniforms(program);
+        program.set(uniforms.numSpheres, static_cast<int>(mSpheres_.size()));
+        program.set(uniforms.numInstances, static_cast<int>(mMeshes_.getInstanceCount()));
+        program.set(uniforms.sampleIndex, static_cast<int>(mSampleCount_));
+        program.set(uniforms.renderSize, mRenderSize_);
+        program.set(uniforms.convergenceThreshold, mConvergenceThreshold_);
+        program.set(uniforms.adaptiveSampling, adaptive);
+        program.set(uniforms.numTilesX, numTiles.x);
+        program.set(uniforms.reuseReprojection, mReuseReprojection_);
+        program.set(uniforms.refreshInterval, mRefreshInterval_);
+        program.set(uniforms.refreshPhase, mRefreshPhase_);
+        program.set(uniforms.checkerboard, checkerboard);
+        program.set(uniforms.checkerboardPhase, mCheckerboardPhase_);
+    };
+    glBindImageTexture(0, texture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+    glBindImageTexture(1, mAccumulationTexture_, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+    glBindImageTexture(2, mHitDistanceTexture_, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+    glBindImageTexture(3, mReprojectedTexture_, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+
+    // Checkerboard frames only cover half the columns of every row
+    const int halfTilesX = ((mRenderSize_.x + 1) / 2 + kTileSize - 1) / kTileSize;
+    const glm::ivec2 pixelGroups(checkerboard ? halfTilesX : numTiles.x, numTiles.y);
+    if (mIntegrator_ == Integrator::WAVEFRONT) {
+        if (mpWavefront_ == nullptr) {
+            mpWavefront_ = std::make_unique<WavefrontPathTracer>(mParentApp_.getResources(), glm::ivec2(mScreenSize_));
+        }
+        // Reflection rays start on the spheres and the meshes, their bounds are the roots of the two hierarchies
+        BoundingBox sceneBounds;
+        if (!mBVH_.empty()) {
+            sceneBounds.grow(mBVH_.getNodes()[0].boundsMin);
+            sceneBounds.grow(mBVH_.getNodes()[0].boundsMax);
+        }
+        if (!mMeshes_.empty()) {
+            sceneBounds.grow(mMeshes_.getTopLevel().getNodes()[0].boundsMin);
+            sceneBounds.grow(mMeshes_.getTopLevel().getNodes()[0].boundsMax);
+        }
+        mpWavefront_->setRayReordering(mReorderRays_, sceneBounds);
+        mpWavefront_->trace(mRenderSize_, pixelGroups, adaptive ? mDispatchArgsBuffer_ : 0, setTraceUniforms);
+    } else if (mIntegrator_ == Integrator::PERSISTENT) {
+        // The kernel walks the workgroups the pixel dispatch would have launched, the counter starts over every trace
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, mPersistentWorkBuffer_);
+        GLuint pixelCount;
+        if (adaptive) {
+            // The noisy tile count is only known on the GPU, every tile could be noisy
+            glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+            glBindBuffer(GL_COPY_READ_BUFFER, mDispatchArgsBuffer_);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_SHADER_STORAGE_BUFFER, 0, 0, 3 * sizeof(GLuint));
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 3 * sizeof(GLuint), sizeof(zero), &zero);
+            pixelCount = tileCount * kTileSize * kTileSize;
+        } else {
+            const GLuint persistentWork[4] = {static_cast<GLuint>(pixelGroups.x), static_cast<GLuint>(pixelGroups.y), 1, 0};
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(persistentWork), persistentWork);
+            pixelCount = persistentWork[0] * persistentWork[1] * kTileSize * kTileSize;
+        }
+        // The groups that fill the device, but no more than one invocation per pixel batch. Under llvmpipe's loop
+        // cap there have to be enough groups to cover the frame at kPersistentPixelsPerInvocation each
+        const GLuint batchCount = (pixelCount + kPersistentPixelBatch - 1) / kPersistentPixelBatch;
+        const GLuint maxGroups = std::min((batchCount + 63) / 64, static_cast<GLuint>(mMaxPersistentGroups_));
+        GLuint minGroups = 1;
+        GLuint pixelsPerInvocation = std::numeric_limits<GLuint>::max();
+        if (mCapPersistentPixels_) {
+            pixelsPerInvocation = kPersistentPixelsPerInvocation;
+            minGroups = (pixelCount + 64 * pixelsPerInvocation - 1) / (64 * pixelsPerInvocation);
+        }
+        const GLuint persistentGroups = std::clamp(static_cast<GLuint>(mPersistentGroups_), std::min(minGroups, maxGroups), maxGroups);
+
+        ShaderProgram* pPersistentCompute = mParentApp_.getResources().getShaderVariant("RayTracePersistent", traceDefines);
+        pPersistentCompute->bind();
+        setTraceUniforms(*pPersistentCompute);
+        pPersistentCompute->set(getTraceUniforms(*pPersistentCompute).maxPixelsPerInvocation, pixelsPerInvocation);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 20, mPersistentWorkBuffer_); // Bind to binding=20
+        glDispatchCompute(persistentGroups, 1, 1);
+    } else {
+        // Every workgroup shape covers a whole tile, the dispatch is the same for all of them
+        const auto dispatchMegakernel = [&](const glm::ivec2& workgroupSize) {
+            ShaderDefines megakernelDefines = traceDefines;
+            megakernelDefines["WORKGROUP_SIZE_X"] = std::to_string(workgroupSize.x);
+            megakernelDefines["WORKGROUP_SIZE_Y"] = std::to_string(workgroupSize.y);
+            ShaderProgram* pRayTraceCompute = mParentApp_.getResources().getShaderVariant("RayTraceMulti", megakernelDefines);
+            pRayTraceCompute->bind();
+            setTraceUniforms(*pRayTraceCompute);
+            if (adaptive) {
+                glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, mDispatchArgsBuffer_);
+                glDispatchComputeIndirect(0);
+            } else {
+                glDispatchCompute(pixelGroups.x, pixelGroups.y, 1);
+            }
+        };
+
+        if (mTuneWorkgroupSize_) {
+            // Timed on this frame's work. The sample is traced over and over, which only repeats its first sample
+            // since tuning starts the accumulation over, the counters are cleared again afterwards
+            std::vector<glm::ivec2> candidates;
+            for (const auto& size : kWorkgroupSizes) {
+                candidates.emplace_back(size[0], size[1]);
+            }
+            const glm::ivec2 tunedSize = mpWorkgroupSizeTuner_->tune("RayTraceMulti", candidates, dispatchMegakernel);
+            mWorkgroupSizeIdx_ = static_cast<int>(std::find(candidates.begin(), candidates.end(), tunedSize) - candidates.begin());
+            mTuneWorkgroupSize_ = false;
+            glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, mConvergenceSSBO_);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counters), counters);
+        }
+        dispatchMegakernel({kWorkgroupSizes[mWorkgroupSizeIdx_][0], kWorkgroupSizes[mWorkgroupSizeIdx_][1]});
+    }
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);  // Ensure updates are visible
+
+    if (checkerboard) {
+        // Fill the other half from the neighbors just traced and the last frame
+        mpCheckerboardCompute_->bind();
+        mpCheckerboardCompute_->set(mCheckerboardPhaseUniform_, mCheckerboardPhase_);
+        mpCheckerboardCompute_->set(mCheckerboardHistoryUniform_, mCheckerboardHistory_);
+        mpCheckerboardCompute_->set(mCheckerboardRenderSizeUniform_, mRenderSize_);
+        glDispatchCompute(halfTilesX, numTiles.y, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        mCheckerboardPhase_ ^= 1;
+    }
+    mTraceTimer_.end();
+    ++mTracesSinceResize_;
+    ++mSampleCount_;
+    if (mReuseReprojection_) {
+        mRefreshPhase_ = (mRefreshPhase_ + 1) % mRefreshInterval_;
+        mReuseReprojection_ = false;
+    }
+    mReprojectionValid_ = true;
+
+    if (mConvergenceFence_ != nullptr) {
+        glDeleteSync(mConvergenceFence_);
+    }
+    mConvergenceFence_ = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void RayTraceScene::reprojectLastFrame() {
+    const GLuint farthest = 0xFFFFFFFFu;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mReprojectionDepthSSBO_);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &farthest);
+
+    mpReprojectCompute_->bind();
+    mpReprojectCompute_->set(mReprojectPrevInvViewUniform_, glm::inverse(mAccumulatedView_));
+    mpReprojectCompute_->set(mReprojectPrevInvProjUniform_, glm::inverse(mAccumulatedProjection_));
+    mpReprojectCompute_->set(mReprojectRenderSizeUniform_, mRenderSize_);
+    glBindImageTexture(0, texture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+    glBindImageTexture(2, mHitDistanceTexture_, 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+    glBindImageTexture(3, mReprojectedTexture_, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 15, mReprojectionDepthSSBO_); // Bind to binding=15
+
+    // Pass 0 resolves which surface is nearest on every pixel, pass 1 writes its color
+    for (int pass = 0; pass < 2; ++pass) {
+        mpReprojectCompute_->set(mReprojectPassUniform_, pass);
+        glDispatchCompute((mRenderSize_.x + 15) / 16, (mRenderSize_.y + 15) / 16, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+}
+
+void RayTraceScene::resolvePassUniforms() {
+    mCompactNumTilesUniform_ = mpTileCompactCompute_->getUniform<unsigned int>("numTiles");
+    mCompactNoiseThresholdUniform_ = mpTileCompactCompute_->getUniform<float>("noiseThreshold");
+    mCompactMinSamplesUniform_ = mpTileCompactCompute_->getUniform<unsigned int>("minSamples");
+    mCompactMaxSamplesUniform_ = mpTileCompactCompute_->getUniform<unsigned int>("maxSamples");
+    mReprojectPrevInvViewUniform_ = mpReprojectCompute_->getUniform<glm::mat4>("prevInvViewMatrix");
+    mReprojectPrevInvProjUniform_ = mpReprojectCompute_->getUniform<glm::mat4>("prevInvProjMatrix");
+    mReprojectRenderSizeUniform_ = mpReprojectCompute_->getUniform<glm::ivec2>("renderSize");
+    mReprojectPassUniform_ = mpReprojectCompute_->getUniform<int>("reprojectPass");
+    mCheckerboardPhaseUniform_ = mpCheckerboardCompute_->getUniform<int>("checkerboardPhase");
+    mCheckerboardHistoryUniform_ = mpCheckerboardCompute_->getUniform<bool>("hasHistory");
+    mCheckerboardRenderSizeUniform_ = mpCheckerboardCompute_->getUniform<glm::ivec2>("renderSize");
+}
+
+const RayTraceScene::TraceUniforms& RayTraceScene::getTraceUniforms(const ShaderProgram& program) {
+    auto it = mTraceUniforms_.find(&program);
+    if (it != mTraceUniforms_.end()) {
+        return it->second;
+    }
+    TraceUniforms uniforms;
+    uniforms.numSpheres = program.getUniform<int>("numSpheres");
+    uniforms.numInstances = program.getUniform<int>("numInstances");
+    uniforms.sampleIndex = program.getUniform<int>("sampleIndex");
+    uniforms.renderSize = program.getUniform<glm::ivec2>("renderSize");
+    uniforms.convergenceThreshold = program.getUniform<float>("convergenceThreshold");
+    uniforms.adaptiveSampling = program.getUniform<bool>("adaptiveSampling");
+    uniforms.numTilesX = program.getUniform<int>("numTilesX");
+    uniforms.reuseReprojection = program.getUniform<bool>("reuseReprojection");
+    uniforms.refreshInterval = program.getUniform<int>("refreshInterval");
+    uniforms.refreshPhase = program.getUniform<int>("refreshPhase");
+    uniforms.checkerboard = program.getUniform<bool>("checkerboard");
+    uniforms.checkerboardPhase = program.getUniform<int>("checkerboardPhase");
+    uniforms.maxPixelsPerInvocation = program.getUniform<unsigned int>("maxPixelsPerInvocation");
+    return mTraceUniforms_.emplace(&program, uniforms).first->second;
+}
+
+void RayTraceScene::resetAccumulation() {
+    mSampleCount_ = 0;
+    mConverged_ = false;
+    mReprojectionValid_ = false;
+    mReuseReprojection_ = false;
+}
+
+void RayTraceScene::updateConvergence() {
+    if (mConvergenceFence_ == nullptr) {
+        return;
+    }
+    // Polled with a zero timeout, a frame still in flight is checked again next frame
+    const GLenum status = glClientWaitSync(mConvergenceFence_, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+        return;
+    }
+    glDeleteSync(mConvergenceFence_);
+    mConvergenceFence_ = nullptr;
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mConvergenceSSBO_);
+    GLuint counters[2];
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counters), counters);
+    mUnconvergedPixels_ = counters[0];
+    // Only frames that reused reprojected shading count traced pixels
+    if (counters[1] != 0) {
+        mTracedPixels_ = counters[1];
+    }
+    if (mSamplingMode_ == SamplingMode::PROGRESSIVE && mAdaptiveSampling_) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, mDispatchArgsBuffer_);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &mActiveTiles_);
+    }
+
+    // A count read after a reset belongs to the old image, the sample count guards against trusting it
+    if (mSamplingMode_ == SamplingMode::PROGRESSIVE && mSampleCount_ >= kMinSamples) {
+        mConverged_ = (mUnconvergedPixels_ == 0) || (mSampleCount_ >= mMaxSamples_);
+    }
+}
+
+void RayTraceScene::updateResolutionScale() {
+    if (!mTraceTimer_.update() || !mDynamicResolution_) {
+        return;
+    }
+    // Only trust times of traces at the scaled size, full resolution refinement and older sizes would mislead
+    if (mRenderSize_ != getScaledRenderSize() || mTracesSinceResize_ <= GpuTimer::kQueryCount) {
+        return;
+    }
+
+    // Leave the scale alone within a band below the budget, so timing noise doesn't keep restarting the image
+    const float traceMs = std::max(mTraceTimer_.getMilliseconds(), 0.01f);
+    const float lowerMs = 0.75f * mTraceBudgetMs_;
+    if (traceMs >= lowerMs && traceMs <= mTraceBudgetMs_) {
+        return;
+    }
+    // The cost follows the pixel count, the square of the scale. Half the step is taken so it settles without overshoot
+    const float targetScale = mResolutionScale_ * std::sqrt(0.5f * (lowerMs + mTraceBudgetMs_) / traceMs);
+    mResolutionScale_ = glm::clamp(mResolutionScale_ + 0.5f * (targetScale - mResolutionScale_), kMinResolutionScale, 1.0f);
+}
+
+ShaderDefines RayTraceScene::getTraceDefines() const {
+    ShaderDefines defines = {{"MAX_BOUNCES", std::to_string(mMaxBounces_)}};
+    if (mSpecializeSphereCount_) {
+        defines["NUM_SPHERES"] = std::to_string(mSpheres_.size());
+    }
+    return defines;
+}
+
+glm::ivec2 RayTraceScene::getScaledRenderSize() const {
+    if (!mDynamicResolution_) {
+        return glm::ivec2(mScreenSize_);
+    }
+    return glm::max(glm::ivec2(mScreenSize_ * mResolutionScale_ + 0.5f), glm::ivec2(1));
+}
+
+void RayTraceScene::renderCpu(const glm::mat4& invView, const glm::mat4& invProjection) {
+    // Worker threads are only spun up once the CPU backend is first used
+    if (mpCpuRayTracer_ == nullptr) {
+        mpCpuRayTracer_ = std::make_unique<CpuRayTracer>(mThreadPool_);
+        if (mBVHBuilder_ == BVHBuilder::GPU_LBVH) {
+            // Only refit while the CPU tracer exists, so the CPU BVH can be behind the animation
+            BVH::computeSphereBounds(mSpheres_, mSphereBounds_);
+            mBVH_.build(mSphereBounds_, &mThreadPool_);
+        }
+        mpCpuRayTracer_->setSpheres(&mSpheres_, &mBVH_);
+        mpCpuRayTracer_->setMeshes(&mMeshes_);
+    }
+
+    const glm::ivec2 imageSize(mScreenSize_);
+    mpCpuRayTracer_->render(invView, invProjection, imageSize);
+
+    // Upload into the same texture the compute shader writes to
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, imageSize.x, imageSize.y, GL_RGBA, GL_FLOAT, mpCpuRayTracer_->getPixels().data());
+}
+
+void RayTraceScene::createMeshes() {
+    // Floor below the spheres, converted from a Mesh like the meshes of a Model would be
+    const Mesh floorGeometry = makePositionMesh(
+        {{-20.0f, 0.0f, -20.0f}, {20.0f, 0.0f, -20.0f}, {20.0f, 0.0f, 20.0f}, {-20.0f, 0.0f, 20.0f}},
+        {0, 2, 1, 0, 3, 2});
+    TriangleMesh floor;
+    floor.addMesh(floorGeometry, {{0.6f, 0.6f, 0.6f}, 0.3f});
+    const uint32_t floorMesh = mMeshes_.addMesh(floor);
+    mMeshes_.addInstance(floorMesh, glm::translate(glm::mat4(1.0f), {0.0f, -3.0f, 0.0f}));
+
+    // Unit cube, rotated so its edges catch the light
+    const Mesh cubeGeometry = makePositionMesh(
+        {
+            {-0.5f, -0.5f, -0.5f}, {0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, -0.5f}, {-0.5f, 0.5f, -0.5f},
+            {-0.5f, -0.5f, 0.5f}, {0.5f, -0.5f, 0.5f}, {0.5f, 0.5f, 0.5f}, {-0.5f, 0.5f, 0.5f}
+        },
+        {
+            0, 2, 1, 0, 3, 2,  4, 5, 6, 4, 6, 7,  0, 1, 5, 0, 5, 4,
+            3, 6, 2, 3, 7, 6,  0, 4, 7, 0, 7, 3,  1, 2, 6, 1, 6, 5
+        });
+    TriangleMesh cube;
+    cube.addMesh(cubeGeometry, {{1.0f, 0.8f, 0.2f}, 0.1f});
+    const uint32_t cubeMesh = mMeshes_.addMesh(cube);
+
+    glm::mat4 cubeTransform = glm::translate(glm::mat4(1.0f), {-3.0f, -1.5f, -6.0f});
+    cubeTransform = glm::rotate(cubeTransform, glm::radians(30.0f), {0.0f, 1.0f, 0.0f});
+    cubeTransform = glm::scale(cubeTransform, glm::vec3(2.0f));
+    mMeshes_.addInstance(cubeMesh, cubeTransform);
+
+    // A ring of the same cube, placed by animateInstances
+    constexpr int kCubeRingCount = 24;
+    for (int i = 0; i < kCubeRingCount; ++i) {
+        mCubeRingInstances_.push_back(mMeshes_.addInstance(cubeMesh, glm::mat4(1.0f)));
+    }
+    animateInstances(0.0f);
+
+    // The meshes never change, only the instances and the top level over them are uploaded again
+    std::vector<glm::vec4> triangles;
+    std::vector<glm::vec4> materials;
+    std::vector<BVHNode> nodes;
+    std::vector<uint32_t> primIndices;
+    mMeshes_.packMeshes(triangles, materials, nodes, primIndices);
+
+    glGenBuffers(1, &mTriangleSSBO_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mTriangleSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, triangles.size() * sizeof(glm::vec4), triangles.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &mTriangleMaterialSSBO_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mTriangleMaterialSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, materials.size() * sizeof(glm::vec4), materials.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &mMeshBVHNodeSSBO_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mMeshBVHNodeSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, nodes.size() * sizeof(BVHNode), nodes.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &mMeshBVHPrimSSBO_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mMeshBVHPrimSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, primIndices.size() * sizeof(uint32_t), primIndices.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &mMeshInstanceSSBO_);
+    glGenBuffers(1, &mTopLevelNodeSSBO_);
+    glGenBuffers(1, &mTopLevelPrimSSBO_);
+    uploadTopLevel();
+}
+
+void RayTraceScene::animateInstances(float time) {
+    // Cubes circle the spheres while spinning about their own axis
+    for (std::size_t i = 0; i < mCubeRingInstances_.size(); ++i) {
+        const float angle = glm::radians(360.0f) * static_cast<float>(i) / static_cast<float>(mCubeRingInstances_.size());
+        glm::mat4 transform = glm::rotate(glm::mat4(1.0f), angle + time * 0.2f, {0.0f, 1.0f, 0.0f});
+        transform = glm::translate(transform, {12.0f, -2.4f, 0.0f});
+        transform = glm::rotate(transform, time * 1.5f + angle * 3.0f, {1.0f, 1.0f, 0.0f});
+        transform = glm::scale(transform, glm::vec3(1.0f + 0.5f * static_cast<float>(i % 3)));
+        mMeshes_.setInstanceTransform(mCubeRingInstances_[i], transform);
+    }
+    mMeshes_.buildTopLevel(&mThreadPool_);
+}
+
+void RayTraceScene::uploadTopLevel() {
+    std::vector<GpuMeshInstance> instances;
+    mMeshes_.packInstances(instances);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mMeshInstanceSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instances.size() * sizeof(GpuMeshInstance), instances.data(), GL_DYNAMIC_DRAW);
+
+    const BVH& topLevel = mMeshes_.getTopLevel();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mTopLevelNodeSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, topLevel.getNodes().size() * sizeof(BVHNode), topLevel.getNodes().data(), GL_DYNAMIC_DRAW);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mTopLevelPrimSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, topLevel.getPrimIndices().size() * sizeof(uint32_t), topLevel.getPrimIndices().data(), GL_DYNAMIC_DRAW);
+}
+
+void RayTraceScene::animateSpheres(float time) {
+    // Bob every sphere up and down out of phase with the others
+    for (std::size_t i = 0; i < mSpheres_.size(); ++i) {
+        const float phase = static_cast<float>(i) * 2.1f;
+        const glm::vec3 offset(0.0f, std::sin(time * 1.5f + phase) * 1.5f, std::cos(time * 0.7f + phase) * 0.5f);
+        mSpheres_.setCenter(i, mSphereRestCenters_[i] + offset);
+    }
+
+    // Only the geometry moved, the materials stay as they are
+    std::vector<glm::vec4> geometry;
+    mSpheres_.packGeometry(geometry);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mSphereGeometrySSBO_);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, geometry.size() * sizeof(glm::vec4), geometry.data());
+
+    // The LBVH is rebuilt from the uploaded geometry without leaving the GPU
+    if (mBVHBuilder_ == BVHBuilder::GPU_LBVH) {
+        mpLBVHBuilder_->build(mSphereGeometrySSBO_, mSpheres_.size());
+    }
+
+    // The CPU tracer always traces the CPU BVH
+    const bool uploadCpuBVH = (mBVHBuilder_ == BVHBuilder::CPU_SAH);
+    if (!uploadCpuBVH && mpCpuRayTracer_ == nullptr) {
+        return;
+    }
+
+    BVH::computeSphereBounds(mSpheres_, mSphereBounds_);
+    mBVH_.refit(mSphereBounds_, &mThreadPool_, &mChangedNodeRanges_);
+    if (mBVH_.getQualityRatio() > mRebuildThreshold_) {
+        // Refitting keeps the old topology, once the spheres moved far enough apart a new tree is cheaper to trace
+        mBVH_.build(mSphereBounds_, &mThreadPool_);
+        if (uploadCpuBVH) {
+            uploadBVH();
+        }
+        if (mpCpuRayTracer_ != nullptr) {
+            // The new topology has to be collapsed again
+            mpCpuRayTracer_->setSpheres(&mSpheres_, &mBVH_);
+        }
+        ++mRebuildCount_;
+    } else {
+        if (uploadCpuBVH) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBVHNodeSSBO_);
+            for (const BVH::NodeRange& range : mChangedNodeRanges_) {
+                glBufferSubData(GL_SHADER_STORAGE_BUFFER, range.first * sizeof(BVHNode), range.count * sizeof(BVHNode),
+                    mBVH_.getNodes().data() + range.first);
+            }
+        }
+        if (mpCpuRayTracer_ != nullptr) {
+            mpCpuRayTracer_->refitBVH();
+        }
+        ++mRefitCount_;
+    }
+}
+
+void RayTraceScene::uploadBVH() {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBVHNodeSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, mBVH_.getNodes().size() * sizeof(BVHNode), mBVH_.getNodes().data(), GL_DYNAMIC_DRAW);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBVHPrimSSBO_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, mBVH_.getPrimIndices().size() * sizeof(uint32_t), mBVH_.getPrimIndices().data(), GL_DYNAMIC_DRAW);
+}
+
+void RayTraceScene::bindSceneBuffers() {
+    // Other compute passes reuse the binding points, so they are set again before every trace
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mSphereGeometrySSBO_); // Bind to binding=1
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mSphereMaterialSSBO_); // Bind to binding=2
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, mTriangleSSBO_); // Bind to binding=5
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, mTriangleMaterialSSBO_); // Bind to binding=6
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, mMeshBVHNodeSSBO_); // Bind to binding=7
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, mMeshBVHPrimSSBO_); // Bind to binding=8
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, mMeshInstanceSSBO_); // Bind to binding=9
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, mTopLevelNodeSSBO_); // Bind to binding=10
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, mTopLevelPrimSSBO_); // Bind to binding=11
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, mConvergenceSSBO_); // Bind to binding=12
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, mTileStateSSBO_); // Bind to binding=13
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, mActiveTileSSBO_); // Bind to binding=14
+
+    if (mBVHBuilder_ == BVHBuilder::GPU_LBVH) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, mpLBVHBuilder_->getNodeBuffer()); // Bind to binding=3
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, mpLBVHBuilder_->getPrimIndexBuffer()); // Bind to binding=4
+    } else {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, mBVHNodeSSBO_); // Bind to binding=3
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, mBVHPrimSSBO_); // Bind to binding=4
+    }
+}
+
 void RayTraceScene::renderUI() {
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
@@ -156,6 +789,126 @@ void RayTraceScene::renderUI() {
         ImGui::Text("RayTrace Scene");
         ImGui::Text("FPS: %.1f", double(ImGui::GetIO().Framerate));
 
+        ImGui::Separator();
+        const char* backendNames[] = {"GPU Compute", "CPU"};
+        int backendIdx = static_cast<int>(mBackend_);
+        if (ImGui::Combo("Backend", &backendIdx, backendNames, IM_ARRAYSIZE(backendNames))) {
+            mBackend_ = static_cast<Backend>(backendIdx);
+            // The CPU frames overwrite the texture the accumulated image is shown from
+            resetAccumulation();
+        }
+        if (mBackend_ == Backend::GPU_COMPUTE) {
+            const char* integratorNames[] = {"Megakernel", "Wavefront", "Persistent threads"};
+            int integratorIdx = static_cast<int>(mIntegrator_);
+            if (ImGui::Combo("Integrator", &integratorIdx, integratorNames, IM_ARRAYSIZE(integratorNames))) {
+                mIntegrator_ = static_cast<Integrator>(integratorIdx);
+                resetAccumulation();
+            }
+            if (mIntegrator_ == Integrator::WAVEFRONT) {
+                ImGui::Checkbox("Reorder rays", &mReorderRays_);
+            }
+            if (mIntegrator_ == Integrator::WAVEFRONT && mpWavefront_ != nullptr) {
+                using Stage = WavefrontPathTracer::Stage;
+                ImGui::Text("Generate %.2f ms, extend %.2f ms", mpWavefront_->getStageMilliseconds(Stage::GENERATE),
+                            mpWavefront_->getStageMilliseconds(Stage::EXTEND));
+                ImGui::Text("Shade %.2f ms, compact %.2f ms", mpWavefront_->getStageMilliseconds(Stage::SHADE),
+                            mpWavefront_->getStageMilliseconds(Stage::COMPACT));
+                if (mpWavefront_->getRayReordering()) {
+                    ImGui::Text("Reorder %.2f ms", mpWavefront_->getStageMilliseconds(Stage::REORDER));
+                }
+            }
+            if (mIntegrator_ == Integrator::PERSISTENT) {
+                ImGui::SliderInt("Persistent groups", &mPersistentGroups_, 1, 1024);
+            }
+            if (mIntegrator_ != Integrator::WAVEFRONT) {
+                // Every setting is its own shader variant, compiled the first time it is picked
+                if (ImGui::SliderInt("Max bounces", &mMaxBounces_, 0, WavefrontPathTracer::kMaxBounces)) {
+                    resetAccumulation();
+                }
+                ImGui::Checkbox("Specialize sphere count", &mSpecializeSphereCount_);
+            }
+            if (mIntegrator_ == Integrator::MEGAKERNEL) {
+                const char* workgroupSizeNames[] = {"16x16", "16x8", "8x16", "8x8", "16x4", "8x4", "32x4", "32x8", "8x32"};
+                ImGui::Combo("Workgroup size", &mWorkgroupSizeIdx_, workgroupSizeNames, IM_ARRAYSIZE(workgroupSizeNames));
+                if (ImGui::Button("Autotune workgroup size")) {
+                    // Every tuning dispatch traces the first sample again
+                    mTuneWorkgroupSize_ = true;
+                    resetAccumulation();
+                }
+            }
+            const char* samplingNames[] = {"Full frame", "Progressive", "Checkerboard"};
+            int samplingIdx = static_cast<int>(mSamplingMode_);
+            if (ImGui::Combo("Sampling", &samplingIdx, samplingNames, IM_ARRAYSIZE(samplingNames))) {
+                mSamplingMode_ = static_cast<SamplingMode>(samplingIdx);
+                resetAccumulation();
+            }
+            if (mSamplingMode_ == SamplingMode::PROGRESSIVE) {
+                if (ImGui::SliderFloat("Convergence", &mConvergenceThreshold_, 0.0005f, 0.02f, "%.4f")) {
+                    mConverged_ = false;
+                }
+                if (ImGui::Checkbox("Adaptive sampling", &mAdaptiveSampling_)) {
+                    resetAccumulation();
+                }
+                ImGui::Text("Samples: %u, noisy pixels: %u%s", mSampleCount_, mUnconvergedPixels_, mConverged_ ? " (converged)" : "");
+                if (mAdaptiveSampling_) {
+                    ImGui::Text("Traced tiles: %u", mActiveTiles_);
+                }
+                ImGui::Checkbox("Temporal reprojection", &mTemporalReprojection_);
+                if (mTemporalReprojection_) {
+                    ImGui::SliderInt("Refresh interval", &mRefreshInterval_, 1, 32);
+                    ImGui::Text("Traced while moving: %.1f%% of pixels", 100.0 * mTracedPixels_ / (mRenderSize_.x * mRenderSize_.y));
+                }
+            }
+            ImGui::Checkbox("Dynamic resolution", &mDynamicResolution_);
+            if (mDynamicResolution_) {
+                ImGui::SliderFloat("Trace budget (ms)", &mTraceBudgetMs_, 2.0f, 50.0f, "%.1f");
+            }
+            ImGui::Text("Resolution: %dx%d, trace %.2f ms", mRenderSize_.x, mRenderSize_.y, mTraceTimer_.getMilliseconds());
+        }
+        if (mBackend_ == Backend::CPU && mpCpuRayTracer_ != nullptr) {
+            ImGui::Text("CPU threads: %u", mpCpuRayTracer_->getThreadCount());
+            bool packetTracing = mpCpuRayTracer_->isPacketTracing();
+            if (ImGui::Checkbox("SIMD ray packets", &packetTracing)) {
+                mpCpuRayTracer_->setPacketTracing(packetTracing);
+            }
+            ImGui::SameLine();
+            ImGui::Text("(%s)", PacketIntersector::getSimdLevelName(mpCpuRayTracer_->getSimdLevel()));
+
+            const char* widthNames[] = {"Binary", "4-wide", "8-wide"};
+            const int widths[] = {2, 4, 8};
+            int widthIdx = (mpCpuRayTracer_->getBVHWidth() == 2) ? 0 : (mpCpuRayTracer_->getBVHWidth() == 4) ? 1 : 2;
+            if (ImGui::Combo("BVH width", &widthIdx, widthNames, IM_ARRAYSIZE(widthNames))) {
+                mpCpuRayTracer_->setBVHWidth(widths[widthIdx]);
+            }
+        }
+
+        ImGui::Separator();
+        const char* builderNames[] = {"CPU SAH (refit)", "GPU LBVH"};
+        int builderIdx = static_cast<int>(mBVHBuilder_);
+        if (ImGui::Combo("BVH builder", &builderIdx, builderNames, IM_ARRAYSIZE(builderNames))) {
+            mBVHBuilder_ = static_cast<BVHBuilder>(builderIdx);
+            if (mBVHBuilder_ == BVHBuilder::GPU_LBVH) {
+                if (mpLBVHBuilder_ == nullptr) {
+                    mpLBVHBuilder_ = std::make_unique<GpuLBVHBuilder>(mParentApp_.getResources());
+                }
+                mpLBVHBuilder_->build(mSphereGeometrySSBO_, mSpheres_.size());
+            } else {
+                // The CPU BVH is not kept up to date while the LBVH is used without the CPU backend
+                BVH::computeSphereBounds(mSpheres_, mSphereBounds_);
+                mBVH_.build(mSphereBounds_, &mThreadPool_);
+                uploadBVH();
+                if (mpCpuRayTracer_ != nullptr) {
+                    mpCpuRayTracer_->setSpheres(&mSpheres_, &mBVH_);
+                }
+            }
+        }
+        ImGui::Checkbox("Animate spheres", &mAnimateSpheres_);
+        ImGui::SliderFloat("Rebuild threshold", &mRebuildThreshold_, 1.0f, 4.0f, "%.2fx SAH");
+        ImGui::Text("BVH quality: %.2f, refits: %u, rebuilds: %u", mBVH_.getQualityRatio(), mRefitCount_, mRebuildCount_);
+        ImGui::Checkbox("Animate instances", &mAnimateInstances_);
+        ImGui::Text("Meshes: %zu, instances: %zu, triangles: %zu", mMeshes_.getMeshCount(), mMeshes_.getInstanceCount(),
+            mMeshes_.getTriangleCount());
+
         ImGui::Separator();
         ImGui::Text("Move camera with WASD, arrow, space, shift keys");
         ImGui::Text("Switch scenes with Tab key");
@@ -179,6 +932,18 @@ void RayTraceScene::renderUI() {
 }
 
 void RayTraceScene::update(const float dt) {
+    if (mAnimateSpheres_) {
+        mAnimationTime_ += dt;
+        animateSpheres(mAnimationTime_);
+        resetAccumulation();
+    }
+    if (mAnimateInstances_) {
+        mInstanceAnimationTime_ += dt;
+        animateInstances(mInstanceAnimationTime_);
+        uploadTopLevel();
+        resetAccumulation();
+    }
+
     const InputHandler& inputHandler = *(mParentApp_.getWindow()->getInputHandler());
 
    if (inputHandler.isKeyPressed(GLFW_KEY_W)) {
@@ -234,4 +999,19 @@ void RayTraceScene::onMousePress(const MouseEvent& mouseEvent) {}
 
 void RayTraceScene::onMouseRelease(const MouseEvent& mouseEvent) {}
 
-void RayTraceScene::onMouseWheel(const MouseEvent& mouseEvent) {}
\ No newline at end of file
+void RayTraceScene::onMouseWheel(const MouseEvent& mouseEvent) {}
+
+void RayTraceScene::onShadersReloaded(const std::vector<std::string>& programNames) {
+    for (const std::string& programName : programNames) {
+        if (programName == "Quad") {
+            mQuadTextureUniform_ = mpQuadShader_->getUniform<int>("screenTexture");
+            mQuadUVScaleUniform_ = mpQuadShader_->getUniform<glm::vec2>("uvScale");
+        } else if (programName.starts_with("RayTrace") || programName.starts_with("RayWavefront")) {
+            // Samples of the old trace kernels would be averaged with the new ones, variants are named after
+            // their program as well
+            resolvePassUniforms();
+            mTraceUniforms_.clear();
+            resetAccumulation();
+        }
+    }
+}
\ No newline at end of file
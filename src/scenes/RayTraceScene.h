@@ -1,13 +1,44 @@
 #pragma once
+// standard lib
+#include <memory>
+#include <unordered_map>
+#include <vector>
 // project
 #include "core/application/Scene.h"
 #include "core/application/Resources.h"
 #include "core/graphics/Camera.h"
+#include "core/graphics/GpuTimer.h"
+#include "core/graphics/WorkgroupSizeTuner.h"
+#include "core/raytrace/AccelerationStructure.h"
+#include "core/raytrace/CpuRayTracer.h"
+#include "core/raytrace/GpuLBVHBuilder.h"
+#include "core/raytrace/SphereSet.h"
+#include "core/raytrace/WavefrontPathTracer.h"
 
 // TODO see if you can use the depth buffer to only draw if nearer than other renders
 
 class RayTraceScene : public Scene {
 public:
+    /** Where the ray traced frame is produced */
+    enum class Backend {
+        GPU_COMPUTE=0, CPU
+    };
+
+    /** How the compute shader spreads samples over the frames */
+    enum class SamplingMode {
+        FULL_FRAME=0, PROGRESSIVE, CHECKERBOARD
+    };
+
+    /** How the GPU follows the paths through their bounces */
+    enum class Integrator {
+        MEGAKERNEL=0, WAVEFRONT, PERSISTENT
+    };
+
+    /** How the BVH traced by the compute shader is built */
+    enum class BVHBuilder {
+        CPU_SAH=0, GPU_LBVH
+    };
+
     RayTraceScene(App& parentAppa);
 
     void render() override;
@@ -26,17 +57,198 @@ public:
 
     void onMouseWheel(const MouseEvent& mouseEvent) override;
 
+    void onShadersReloaded(const std::vector<std::string>& programNames) override;
+
 private:
+    /**
+     * Trace the frame on the CPU and upload it to the ray trace texture
+     * @param invView Inverse camera view matrix
+     * @param invProjection Inverse camera projection matrix
+     */
+    void renderCpu(const glm::mat4& invView, const glm::mat4& invProjection);
+
+    /**
+     * Move the spheres along their animation paths and bring the BVH and the GPU buffers up to date. The
+     * BVH is refit while its quality holds up and rebuilt once it degrades past mRebuildThreshold_
+     * @param time Animation time in seconds
+     */
+    void animateSpheres(float time);
+
+    /** Upload the whole BVH, used after a full rebuild */
+    void uploadBVH();
+
+    /** Bind the scene buffers read by the ray trace shader, the BVH nodes and prim indices of the selected builder */
+    void bindSceneBuffers();
+
+    /** Add the triangle meshes of the scene and their instances, and upload them with their BVHs */
+    void createMeshes();
+
+    /**
+     * Spin the ring of cube instances. Only the top level BVH is rebuilt, the meshes stay as they are
+     * @param time Animation time in seconds
+     */
+    void animateInstances(float time);
+
+    /** Upload the instances and the top level BVH over them */
+    void uploadTopLevel();
+
+    /**
+     * Trace the next sample of the progressive image on the GPU. With adaptive sampling only the tiles the
+     * compaction pass finds noisy are traced, through an indirect dispatch. The camera is read from the frame
+     * uniform buffer
+     */
+    void dispatchRayTrace();
+
+    /**
+     * Move the shading of the last frame into the new camera view with ray_trace_reproject.glsl. The next trace
+     * only traces the pixels that nothing landed on plus a rotating subset. The new camera is read from the frame
+     * uniform buffer
+     */
+    void reprojectLastFrame();
+
+    /** Start the progressive image over, after the camera or the scene changed. The last frame can no longer be reprojected */
+    void resetAccumulation();
+
+    /**
+     * Read the unconverged pixel count of the last traced frame once the GPU has finished it, without waiting.
+     * Dispatching stops once no pixel is left above the convergence threshold
+     */
+    void updateConvergence();
+
+    /**
+     * Feed the GPU time of the last finished trace back into the resolution scale. The traced pixel count is
+     * moved towards the count that fits mTraceBudgetMs_, assuming the cost grows linearly with it
+     */
+    void updateResolutionScale();
+
+    /** Defines the ray trace kernels are specialized with this frame, see Resources::getShaderVariant */
+    ShaderDefines getTraceDefines() const;
+
+    /** Window size scaled by mResolutionScale_, the size frames traced anew are rendered at */
+    glm::ivec2 getScaledRenderSize() const;
+
+    /** Resolve the uniform handles of the tile compaction, checkerboard and reprojection passes */
+    void resolvePassUniforms();
+
+    /** Handles of the sampling and scene uniforms of ray_sample.glsl and ray_traverse.glsl on one trace program */
+    struct TraceUniforms {
+        UniformHandle<int> numSpheres;
+        UniformHandle<int> numInstances;
+        UniformHandle<int> sampleIndex;
+        UniformHandle<glm::ivec2> renderSize;
+        UniformHandle<float> convergenceThreshold;
+        UniformHandle<bool> adaptiveSampling;
+        UniformHandle<int> numTilesX;
+        UniformHandle<bool> reuseReprojection;
+        UniformHandle<int> refreshInterval;
+        UniformHandle<int> refreshPhase;
+        UniformHandle<bool> checkerboard;
+        UniformHandle<int> checkerboardPhase;
+        /** Only used by the persistent kernel */
+        UniformHandle<unsigned int> maxPixelsPerInvocation;
+    };
+
+    /** Handles of a trace program or variant, resolved the first time it traces */
+    const TraceUniforms& getTraceUniforms(const ShaderProgram& program);
 
     ShaderProgram* mpBasicCompute_ = nullptr;
     ShaderProgram* mpRayTraceCompute_ = nullptr;
+    ShaderProgram* mpTileCompactCompute_ = nullptr;
+    ShaderProgram* mpReprojectCompute_ = nullptr;
     ShaderProgram* mpQuadShader_ = nullptr;
+    UniformHandle<int> mQuadTextureUniform_;
+    UniformHandle<glm::vec2> mQuadUVScaleUniform_;
+    UniformHandle<unsigned int> mCompactNumTilesUniform_;
+    UniformHandle<float> mCompactNoiseThresholdUniform_;
+    UniformHandle<unsigned int> mCompactMinSamplesUniform_;
+    UniformHandle<unsigned int> mCompactMaxSamplesUniform_;
+    UniformHandle<glm::mat4> mReprojectPrevInvViewUniform_;
+    UniformHandle<glm::mat4> mReprojectPrevInvProjUniform_;
+    UniformHandle<glm::ivec2> mReprojectRenderSizeUniform_;
+    UniformHandle<int> mReprojectPassUniform_;
+    /** Trace uniform handles per program and variant, dropped when the trace programs are reloaded */
+    std::unordered_map<const ShaderProgram*, TraceUniforms> mTraceUniforms_;
 
 
     GLuint quadVAO, quadVBO;
 
     GLuint framebuffer, texture;
 
+    /** Running mean and luminance deviations of the progressive samples (image unit 1) */
+    GLuint mAccumulationTexture_;
+    /** Unconverged pixel counter written by the trace (binding 12) */
+    GLuint mConvergenceSSBO_;
+    /** Signaled once the trace that last wrote the counter has finished */
+    GLsync mConvergenceFence_ = nullptr;
+
+    /** Progressive accumulates jittered samples while the view stays still, the other modes trace every frame anew */
+    SamplingMode mSamplingMode_ = SamplingMode::PROGRESSIVE;
+    /** Samples in the accumulation image */
+    unsigned int mSampleCount_ = 0;
+    /** Minimum samples before the variance estimate is trusted */
+    static constexpr unsigned int kMinSamples = 8;
+    /** Stop adding samples after this many even if pixels are still noisy */
+    unsigned int mMaxSamples_ = 1024;
+    /** Luminance standard error below which a pixel counts as converged */
+    float mConvergenceThreshold_ = 0.005f;
+    /** Unconverged pixels of the last frame read back */
+    unsigned int mUnconvergedPixels_ = 0;
+    /** No more dispatches until the accumulation is reset */
+    bool mConverged_ = false;
+    /** Only trace the tiles whose noise is above the convergence threshold */
+    bool mAdaptiveSampling_ = true;
+    /** Pixel size of the tiles sampled together, the workgroup size of the ray trace shader */
+    static constexpr int kTileSize = 16;
+    /** Noise and sample count per tile (binding 13) */
+    GLuint mTileStateSSBO_;
+    /** Tiles to trace, one workgroup each (binding 14) */
+    GLuint mActiveTileSSBO_;
+    /** Indirect dispatch arguments filled by the compaction pass (binding 15) */
+    GLuint mDispatchArgsBuffer_;
+    /** Tiles traced by the last frame read back */
+    unsigned int mActiveTiles_ = 0;
+    ShaderProgram* mpCheckerboardCompute_ = nullptr;
+    UniformHandle<int> mCheckerboardPhaseUniform_;
+    UniformHandle<bool> mCheckerboardHistoryUniform_;
+    UniformHandle<glm::ivec2> mCheckerboardRenderSizeUniform_;
+    /** Alternates every checkerboard frame */
+    int mCheckerboardPhase_ = 0;
+    /** The untraced checkerboard pixels hold the last frame of the current scene */
+    bool mCheckerboardHistory_ = false;
+
+    /** Reuse the last frame's shading while the camera moves */
+    bool mTemporalReprojection_ = true;
+    /** Primary hit distance of every pixel (image unit 2) */
+    GLuint mHitDistanceTexture_;
+    /** Last frame's shading in the current view (image unit 3) */
+    GLuint mReprojectedTexture_;
+    /** Nearest reprojected surface per pixel (binding 15 of the reproject shader) */
+    GLuint mReprojectionDepthSSBO_;
+    /** The texture and hit distances hold a frame of the current scene traced with mAccumulatedView_ */
+    bool mReprojectionValid_ = false;
+    /** The next trace reuses the reprojected shading */
+    bool mReuseReprojection_ = false;
+    /** One in this many pixels is traced again even when its reprojection is accepted */
+    int mRefreshInterval_ = 8;
+    int mRefreshPhase_ = 0;
+    /** Pixels traced by the last reprojected frame read back */
+    unsigned int mTracedPixels_ = 0;
+    /** GPU time of the ray trace passes of a frame */
+    GpuTimer mTraceTimer_;
+    /** Trace frames that start over at a lower resolution when they don't fit mTraceBudgetMs_ */
+    bool mDynamicResolution_ = true;
+    /** GPU time a frame traced anew may take */
+    float mTraceBudgetMs_ = 12.0f;
+    /** Fraction of the window width and height traced */
+    float mResolutionScale_ = 1.0f;
+    static constexpr float kMinResolutionScale = 0.25f;
+    /** Traces since mRenderSize_ last changed, measurements lag up to GpuTimer::kQueryCount traces behind */
+    int mTracesSinceResize_ = 0;
+
+    /** Camera matrices the accumulated samples were traced with */
+    glm::mat4 mAccumulatedView_ = glm::mat4(1.0f);
+    glm::mat4 mAccumulatedProjection_ = glm::mat4(1.0f);
+
 
     const int dataSize = 1024; // Array of 1024 integers
     std::vector<int> data;
@@ -45,4 +257,107 @@ private:
 
     const glm::vec2 mScreenSize_;
 
+    /** Pixels traced into the top left corner of the window sized images */
+    glm::ivec2 mRenderSize_;
+
+    /** Spheres in the scene, uploaded to the compute shader SSBOs */
+    SphereSet mSpheres_;
+
+    /** Sphere centers and radii (binding 1) */
+    GLuint mSphereGeometrySSBO_;
+    /** Sphere colors and reflectivity (binding 2) */
+    GLuint mSphereMaterialSSBO_;
+
+    /** Workers of the CPU hierarchy builds and refits and of the CPU tracer */
+    ThreadPool mThreadPool_;
+    /** Hierarchy over the spheres, shared by the GPU and CPU tracers */
+    BVH mBVH_;
+    /** Flattened BVH nodes (binding 3) */
+    GLuint mBVHNodeSSBO_;
+    /** Sphere indices referenced by the BVH leaves (binding 4) */
+    GLuint mBVHPrimSSBO_;
+
+    /** Instanced triangle meshes in the scene, shared by the GPU and CPU tracers */
+    AccelerationStructure mMeshes_;
+    /** Object space triangle corners of all meshes (binding 5) */
+    GLuint mTriangleSSBO_;
+    /** Triangle materials (binding 6) */
+    GLuint mTriangleMaterialSSBO_;
+    /** Bottom level BVH nodes of all meshes (binding 7) */
+    GLuint mMeshBVHNodeSSBO_;
+    /** Triangle indices referenced by the bottom level leaves (binding 8) */
+    GLuint mMeshBVHPrimSSBO_;
+    /** Instance transforms and mesh roots (binding 9) */
+    GLuint mMeshInstanceSSBO_;
+    /** Top level BVH nodes (binding 10) */
+    GLuint mTopLevelNodeSSBO_;
+    /** Instance indices referenced by the top level leaves (binding 11) */
+    GLuint mTopLevelPrimSSBO_;
+
+    /** Instances of the cube ring, moved by animateInstances */
+    std::vector<uint32_t> mCubeRingInstances_;
+    /** Spin the cube ring every frame */
+    bool mAnimateInstances_ = false;
+    float mInstanceAnimationTime_ = 0.0f;
+
+    /** Move the spheres every frame */
+    bool mAnimateSpheres_ = false;
+    float mAnimationTime_ = 0.0f;
+    /** Centers the animation offsets the spheres from */
+    std::vector<glm::vec3> mSphereRestCenters_;
+    /** Sphere bounds reused between refits */
+    std::vector<BoundingBox> mSphereBounds_;
+    /** Node ranges changed by the last refit */
+    std::vector<BVH::NodeRange> mChangedNodeRanges_;
+    /** Rebuild the BVH once its SAH cost grows past this factor of the cost right after the build */
+    float mRebuildThreshold_ = 1.5f;
+    unsigned int mRefitCount_ = 0;
+    unsigned int mRebuildCount_ = 0;
+
+    BVHBuilder mBVHBuilder_ = BVHBuilder::CPU_SAH;
+    /** GPU builder, created the first time the LBVH is selected */
+    std::unique_ptr<GpuLBVHBuilder> mpLBVHBuilder_;
+
+    Backend mBackend_ = Backend::GPU_COMPUTE;
+
+    Integrator mIntegrator_ = Integrator::MEGAKERNEL;
+    /** Wavefront stages and their path buffers, created the first time the wavefront integrator is selected */
+    std::unique_ptr<WavefrontPathTracer> mpWavefront_;
+    /** Sort the secondary rays of the wavefront tracer by origin and direction before every bounce */
+    bool mReorderRays_ = false;
+    /** Workgroup counts of the pixel dispatch and the next pixel to pull (binding 20) */
+    GLuint mPersistentWorkBuffer_;
+    /** Workgroups of 64 invocations launched by the persistent kernel, enough to keep every core of the device busy */
+    int mPersistentGroups_ = 256;
+    /** GL_MAX_COMPUTE_WORK_GROUP_COUNT in x, the most groups the persistent kernel can launch */
+    GLint mMaxPersistentGroups_ = 65535;
+    /**
+     * Pixels one persistent invocation traces at most on llvmpipe. Large frames launch more groups than
+     * mPersistentGroups_ there so no invocation runs into its loop iteration cap
+     */
+    static constexpr unsigned int kPersistentPixelsPerInvocation = 32;
+    /** Consecutive pixels a persistent invocation pulls with one atomic, same as PIXEL_BATCH in ray_trace_persistent.glsl */
+    static constexpr unsigned int kPersistentPixelBatch = 4;
+    /** If the renderer is llvmpipe, other drivers launch mPersistentGroups_ and drain the whole frame with them */
+    bool mCapPersistentPixels_ = false;
+
+    /** Reflections the megakernel and the persistent kernel follow, compiled in as MAX_BOUNCES */
+    int mMaxBounces_ = WavefrontPathTracer::kMaxBounces;
+    /** Compile the sphere count into the ray trace kernels as NUM_SPHERES instead of reading the uniform */
+    bool mSpecializeSphereCount_ = true;
+    /** Megakernel workgroup shapes the tuner tries, each one covers a whole tile */
+    static constexpr int kWorkgroupSizes[][2] = {
+        {16, 16}, {16, 8}, {8, 16}, {8, 8}, {16, 4}, {8, 4}, {32, 4}, {32, 8}, {8, 32}
+    };
+    /** Index into kWorkgroupSizes */
+    int mWorkgroupSizeIdx_ = 0;
+    /** Fastest megakernel workgroup size per GPU, kept in kWorkgroupSizeCacheFile */
+    std::unique_ptr<WorkgroupSizeTuner> mpWorkgroupSizeTuner_;
+    static constexpr const char* kWorkgroupSizeCacheFile = "workgroup_sizes.txt";
+    /** Time every workgroup size on the next megakernel frame, at startup if this GPU was never tuned */
+    bool mTuneWorkgroupSize_ = false;
+
+    /** CPU tracer, created the first time the CPU backend is selected */
+    std::unique_ptr<CpuRayTracer> mpCpuRayTracer_;
+
 };
\ No newline at end of file
@@ -13,6 +13,8 @@ StencilScene::StencilScene(App& parentApp)
 : Scene(parentApp) {
     mpStencilShader_ = mParentApp_.getResources().getResource<ShaderProgram>("StencilShader");
     mpStencilShaderSingleColor_ = mParentApp_.getResources().getResource<ShaderProgram>("StencilShaderSingleColor");
+    mStencilModelUniform_ = mpStencilShader_->getUniform<glm::mat4>("model");
+    mSingleColorModelUniform_ = mpStencilShaderSingleColor_->getUniform<glm::mat4>("model");
 
     mpCubeTexture = mParentApp_.getResources().getResource<Texture>("Cube");
     mpFloorTexture = mParentApp_.getResources().getResource<Texture>("Floor");
@@ -117,24 +119,18 @@ void StencilScene::render() {
     glClearColor(.1f, 0.1f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-    // set uniforms
-    mpStencilShaderSingleColor_->bind();
+    // both shaders read the camera from the frame uniform buffer
+    mParentApp_.getFrameUniforms().setCamera(mCamera_.getViewMatrix(), mCamera_.getProjectionMatrix());
     glm::mat4 model = glm::mat4(1.0f);
-    glm::mat4 view = mCamera_.getViewMatrix();
-    glm::mat4 projection = mCamera_.getProjectionMatrix();
-    mpStencilShaderSingleColor_->setMat4("view", view);
-    mpStencilShaderSingleColor_->setMat4("projection", projection);
 
     mpStencilShader_->bind();
-    mpStencilShader_->setMat4("view", view);
-    mpStencilShader_->setMat4("projection", projection);
 
     // draw floor as normal, but don't write the floor to the stencil buffer, we only care about the containers. We set its mask to 0x00 to not write to the stencil buffer.
     glStencilMask(0x00);
     // floor
     glBindVertexArray(planeVAO);
     glBindTexture(GL_TEXTURE_2D, mpFloorTexture->getId());
-    mpStencilShader_->setMat4("model", glm::mat4(1.0f));
+    mpStencilShader_->set(mStencilModelUniform_, glm::mat4(1.0f));
     glDrawArrays(GL_TRIANGLES, 0, 6);
     glBindVertexArray(0);
 
@@ -147,11 +143,11 @@ void StencilScene::render() {
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, mpCubeTexture->getId());
     model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
-    mpStencilShader_->setMat4("model", model);
+    mpStencilShader_->set(mStencilModelUniform_, model);
     glDrawArrays(GL_TRIANGLES, 0, 36);
     model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
-    mpStencilShader_->setMat4("model", model);
+    mpStencilShader_->set(mStencilModelUniform_, model);
     glDrawArrays(GL_TRIANGLES, 0, 36);
 
     // 2nd. render pass: now draw slightly scaled versions of the objects, this time disabling stencil writing.
@@ -169,12 +165,12 @@ void StencilScene::render() {
     model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
     model = glm::scale(model, glm::vec3(scale, scale, scale));
-    mpStencilShaderSingleColor_->setMat4("model", model);
+    mpStencilShaderSingleColor_->set(mSingleColorModelUniform_, model);
     glDrawArrays(GL_TRIANGLES, 0, 36);
     model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
     model = glm::scale(model, glm::vec3(scale, scale, scale));
-    mpStencilShaderSingleColor_->setMat4("model", model);
+    mpStencilShaderSingleColor_->set(mSingleColorModelUniform_, model);
     glDrawArrays(GL_TRIANGLES, 0, 36);
     glBindVertexArray(0);
     glStencilMask(0xFF);
@@ -274,4 +270,14 @@ void StencilScene::onMousePress(const MouseEvent& mouseEvent) {}
 
 void StencilScene::onMouseRelease(const MouseEvent& mouseEvent) {}
 
-void StencilScene::onMouseWheel(const MouseEvent& mouseEvent) {}
\ No newline at end of file
+void StencilScene::onMouseWheel(const MouseEvent& mouseEvent) {}
+
+void StencilScene::onShadersReloaded(const std::vector<std::string>& programNames) {
+    for (const std::string& programName : programNames) {
+        if (programName == "StencilShader") {
+            mStencilModelUniform_ = mpStencilShader_->getUniform<glm::mat4>("model");
+        } else if (programName == "StencilShaderSingleColor") {
+            mSingleColorModelUniform_ = mpStencilShaderSingleColor_->getUniform<glm::mat4>("model");
+        }
+    }
+}
\ No newline at end of file
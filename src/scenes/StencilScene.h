@@ -27,11 +27,17 @@ public:
 
     void onMouseWheel(const MouseEvent& mouseEvent) override;
 
+    void onShadersReloaded(const std::vector<std::string>& programNames) override;
+
 private:
     ShaderProgram* mpStencilShader_ = nullptr;
     
     ShaderProgram* mpStencilShaderSingleColor_ = nullptr;
 
+    /** Model matrix of each stencil shader, the camera comes from the frame uniform buffer */
+    UniformHandle<glm::mat4> mStencilModelUniform_;
+    UniformHandle<glm::mat4> mSingleColorModelUniform_;
+
     Texture* mpFloorTexture = nullptr;
 
     Texture* mpCubeTexture = nullptr;